@@ -0,0 +1,948 @@
+// Micro benchmarks of the buffer manager.
+// Usage: ./bench_buffer_mgr [maxFrames] [maxThreads]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "dberror.h"
+#include "storage_mgr.h"
+#include "buffer_mgr.h"
+#include "crc32c.h"
+#include "lz.h"
+
+#define BENCH_FILE "benchbuffer.bin"
+
+// benchmark methods
+static void benchPinLatency (int maxFrames);
+static void benchScanResistance (void);
+static void benchFlusher (void);
+static void benchPinScaling (int maxThreads);
+static void benchAppendPages (void);
+static void benchCheckpoint (void);
+static void benchMappedReads (void);
+static void benchQueueDepth (void);
+static void benchCommits (void);
+static void benchChecksums (void);
+static void benchPageSizes (void);
+static void benchCompression (void);
+static void benchFreePages (void);
+static void benchPurge (void);
+
+// helper methods
+static double elapsedNs (struct timespec *start, struct timespec *end);
+static void fillRecordPage (char *page, int seed);
+
+// main method
+int
+main (int argc, char **argv)
+{
+	int maxFrames = 1 << 16;
+	int maxThreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	if (argc > 1)
+		maxFrames = atoi(argv[1]);
+	if (argc > 2)
+		maxThreads = atoi(argv[2]);
+
+	benchPinLatency(maxFrames);
+	benchScanResistance();
+	benchFlusher();
+	benchPinScaling(maxThreads);
+	benchAppendPages();
+	benchCheckpoint();
+	benchMappedReads();
+	benchQueueDepth();
+	benchCommits();
+	benchChecksums();
+	benchPageSizes();
+	benchCompression();
+	benchFreePages();
+	benchPurge();
+
+	return 0;
+}
+
+// ************************************************************
+// measure the latency of a pin/unpin pair that hits the pool, while the
+// number of frames grows from 16 to maxFrames. With the page table the
+// latency must not depend on the pool size.
+void
+benchPinLatency (int maxFrames)
+{
+	const int hotPages = 16;
+	const int numOps = 1000000;
+	int numFrames, i;
+
+	CHECK(createPageFile(BENCH_FILE));
+	printf("%-12s %-12s\n", "frames", "ns/pin");
+
+	for (numFrames = 16; numFrames <= maxFrames; numFrames *= 4)
+	{
+		BM_BufferPool *bm = MAKE_POOL();
+		BM_PageHandle *h = MAKE_PAGE_HANDLE();
+		struct timespec start, end;
+
+		CHECK(initBufferPool(bm, BENCH_FILE, numFrames, RS_FIFO, NULL));
+
+		// load the hot pages once
+		for (i = 0; i < hotPages; i++)
+		{
+			CHECK(pinPage(bm, h, i));
+			CHECK(unpinPage(bm, h));
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (i = 0; i < numOps; i++)
+		{
+			pinPage(bm, h, i % hotPages);
+			unpinPage(bm, h);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		printf("%-12i %-12.1f\n", numFrames, elapsedNs(&start, &end) / numOps);
+
+		CHECK(shutdownBufferPool(bm));
+		free(h);
+	}
+
+	CHECK(destroyPageFile(BENCH_FILE));
+}
+
+// ************************************************************
+// measure the hit ratio of point lookups that are interleaved with full scans
+// of the file, as done by the record manager. Lookups go to a hot set that
+// fits in the pool, the scans read every page once. Every replacement policy
+// is measured.
+void
+benchScanResistance (void)
+{
+	const int numFrames = 128, hotPages = 64, numPages = 4096;
+	const int numRounds = 50, lookupsPerRound = 1000;
+	int s, r, i;
+
+	CHECK(createPageFile(BENCH_FILE));
+	printf("\n%-8s %-16s %-16s\n", "policy", "lookup hits", "overall hits");
+
+	for (s = 0; getReplacementPolicy(s) != NULL; s++)
+	{
+		BM_BufferPool *bm = MAKE_POOL();
+		BM_PageHandle *h = MAKE_PAGE_HANDLE();
+		unsigned int seed = 42;
+		int lookupReads = 0, reads;
+
+		CHECK(initBufferPool(bm, BENCH_FILE, numFrames, s, NULL));
+
+		for (r = 0; r < numRounds; r++)
+		{
+			// point lookups, 90% of them to the hot set
+			reads = getNumReadIO(bm);
+			for (i = 0; i < lookupsPerRound; i++)
+			{
+				int pageNum;
+				seed = seed * 1103515245 + 12345;
+				if ((seed >> 16) % 10 < 9)
+					pageNum = (seed >> 8) % hotPages;
+				else
+					pageNum = (seed >> 4) % numPages;
+				CHECK(pinPage(bm, h, pageNum));
+				CHECK(unpinPage(bm, h));
+			}
+			lookupReads += getNumReadIO(bm) - reads;
+
+			// full scan
+			for (i = 0; i < numPages; i++)
+			{
+				CHECK(pinPage(bm, h, i));
+				CHECK(unpinPage(bm, h));
+			}
+		}
+
+		printf("%-8s %-16.3f %-16.3f\n", getReplacementPolicy(s)->name,
+				1.0 - (double) lookupReads / (numRounds * lookupsPerRound),
+				1.0 - (double) getNumReadIO(bm) / (numRounds * (lookupsPerRound + numPages)));
+
+		CHECK(shutdownBufferPool(bm));
+		free(h);
+	}
+
+	CHECK(destroyPageFile(BENCH_FILE));
+}
+
+// ************************************************************
+// measure a workload that dirties most of the pages it pins, without and with
+// the background flusher. With the flusher most evictions find a clean victim
+// and the pins that miss do not wait for a write.
+void
+benchFlusher (void)
+{
+	const int numFrames = 256, numPages = 4096, numOps = 200000;
+	int withFlusher, i;
+
+	CHECK(createPageFile(BENCH_FILE));
+	printf("\n%-8s %-16s %-16s\n", "flusher", "clean evictions", "pins/s");
+
+	for (withFlusher = 0; withFlusher <= 1; withFlusher++)
+	{
+		BM_BufferPool *bm = MAKE_POOL();
+		BM_PageHandle *h = MAKE_PAGE_HANDLE();
+		struct timespec start, end;
+		unsigned int seed = 42;
+
+		CHECK(initBufferPool(bm, BENCH_FILE, numFrames, RS_LRU, NULL));
+		if (withFlusher)
+			CHECK(startFlusher(bm, 0.25, 1));
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (i = 0; i < numOps; i++)
+		{
+			seed = seed * 1103515245 + 12345;
+			CHECK(pinPage(bm, h, (seed >> 8) % numPages));
+			if ((seed >> 16) % 10 < 8)
+				CHECK(markDirty(bm, h));
+			CHECK(unpinPage(bm, h));
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		printf("%-8s %-16.3f %-16.0f\n", withFlusher ? "on" : "off",
+				(double) getNumCleanEvictions(bm) / getNumEvictions(bm),
+				numOps / (elapsedNs(&start, &end) / 1e9));
+
+		CHECK(shutdownBufferPool(bm));
+		free(h);
+	}
+
+	CHECK(destroyPageFile(BENCH_FILE));
+}
+
+// ************************************************************
+// worker of benchPinScaling: pin and unpin random pages of the working set
+typedef struct ScalingWorker {
+	BM_BufferPool *bm;
+	unsigned int seed;
+	int numPages;
+	int numOps;
+} ScalingWorker;
+
+static void *
+runScalingWorker (void *arg)
+{
+	ScalingWorker *w = (ScalingWorker *) arg;
+	BM_PageHandle h;
+	int i;
+
+	for (i = 0; i < w->numOps; i++)
+	{
+		w->seed = w->seed * 1103515245 + 12345;
+		CHECK(pinPage(w->bm, &h, (w->seed >> 8) % w->numPages));
+		CHECK(unpinPage(w->bm, &h));
+	}
+	return NULL;
+}
+
+// measure the pin throughput of 1 to maxThreads threads sharing a pool. The 
+// working set fits in the pool, so hits only latch their page table stripe,
+// and the latch of the pool for the policies that track hits.
+void
+benchPinScaling (int maxThreads)
+{
+	const ReplacementStrategy strategies[] = { RS_CLOCK, RS_LRU };
+	const int numFrames = 1024, numPages = 1024, numOps = 1000000;
+	int s, numThreads, t;
+
+	CHECK(createPageFile(BENCH_FILE));
+	printf("\n%-8s %-8s %-16s\n", "policy", "threads", "pins/s");
+
+	for (s = 0; s < 2; s++)
+	{
+		for (numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+		{
+			BM_BufferPool *bm = MAKE_POOL();
+			BM_PageHandle *h = MAKE_PAGE_HANDLE();
+			ScalingWorker *workers = malloc(numThreads * sizeof(ScalingWorker));
+			pthread_t *threads = malloc(numThreads * sizeof(pthread_t));
+			struct timespec start, end;
+			int i;
+
+			CHECK(initBufferPool(bm, BENCH_FILE, numFrames, strategies[s], NULL));
+
+			// load the working set once
+			for (i = 0; i < numPages; i++)
+			{
+				CHECK(pinPage(bm, h, i));
+				CHECK(unpinPage(bm, h));
+			}
+
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			for (t = 0; t < numThreads; t++)
+			{
+				workers[t].bm = bm;
+				workers[t].seed = t + 1;
+				workers[t].numPages = numPages;
+				workers[t].numOps = numOps / numThreads;
+				pthread_create(&threads[t], NULL, runScalingWorker, &workers[t]);
+			}
+			for (t = 0; t < numThreads; t++)
+				pthread_join(threads[t], NULL);
+			clock_gettime(CLOCK_MONOTONIC, &end);
+
+			printf("%-8s %-8i %-16.0f\n", getReplacementPolicy(strategies[s])->name, numThreads,
+					numOps / (elapsedNs(&start, &end) / 1e9));
+
+			CHECK(shutdownBufferPool(bm));
+			free(workers);
+			free(threads);
+			free(h);
+		}
+	}
+
+	CHECK(destroyPageFile(BENCH_FILE));
+}
+
+// ************************************************************
+// measure appending 1M pages to a page file: one page at a time with and 
+// without space reserved ahead, and in a single ensureCapacity call
+void
+benchAppendPages (void)
+{
+	const int numPages = 1 << 20;
+	const char *modes[] = { "append, 1 MiB/10% reserved", "append, nothing reserved", "ensureCapacity" };
+	int m, i;
+
+	printf("\n%-28s %-12s %-16s\n", "extension", "ms", "pages/s");
+
+	for (m = 0; m < 3; m++)
+	{
+		SM_FileHandle fh;
+		struct timespec start, end;
+		double ns;
+
+		CHECK(setGrowthChunk(m == 1 ? 0 : 256, m == 1 ? 0 : 10));
+		CHECK(createPageFile(BENCH_FILE));
+		CHECK(openPageFile(BENCH_FILE, &fh));
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		if (m < 2)
+		{
+			for (i = 1; i < numPages; i++)
+				CHECK(appendEmptyBlock(&fh));
+		}
+		else
+			CHECK(ensureCapacity(numPages, &fh));
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		ns = elapsedNs(&start, &end);
+		printf("%-28s %-12.1f %-16.0f\n", modes[m], ns / 1e6, (numPages - 1) / (ns / 1e9));
+
+		CHECK(closePageFile(&fh));
+		CHECK(destroyPageFile(BENCH_FILE));
+	}
+	CHECK(setGrowthChunk(256, 10));
+}
+
+// ************************************************************
+// measure checkpoints of a pool where a random half of the pages is dirty:
+// forceFlushPool writes them in page order, runs of adjacent pages together
+void
+benchCheckpoint (void)
+{
+	const int numFrames = 4096, numRounds = 20;
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	struct timespec start, end;
+	unsigned int seed = 42;
+	double ns = 0;
+	int r, i;
+
+	CHECK(createPageFile(BENCH_FILE));
+	CHECK(initBufferPool(bm, BENCH_FILE, numFrames, RS_LRU, NULL));
+	for (i = 0; i < numFrames; i++)
+	{
+		CHECK(pinPage(bm, h, i));
+		CHECK(unpinPage(bm, h));
+	}
+
+	for (r = 0; r < numRounds; r++)
+	{
+		for (i = 0; i < numFrames; i++)
+		{
+			seed = seed * 1103515245 + 12345;
+			if ((seed >> 16) % 2 == 0)
+				continue;
+			CHECK(pinPage(bm, h, i));
+			CHECK(markDirty(bm, h));
+			CHECK(unpinPage(bm, h));
+		}
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		CHECK(forceFlushPool(bm));
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		ns += elapsedNs(&start, &end);
+	}
+
+	printf("\n%-16s %-16s %-16s\n", "pages written", "write calls", "ms/checkpoint");
+	printf("%-16i %-16i %-16.2f\n", getNumWriteIO(bm), getNumWriteIO(bm) - getNumCoalescedWrites(bm),
+			ns / 1e6 / numRounds);
+
+	CHECK(shutdownBufferPool(bm));
+	CHECK(destroyPageFile(BENCH_FILE));
+	free(h);
+}
+
+// ************************************************************
+// measure random page reads of a file in the page cache: with pread, copied
+// from the mapping, and in place through getBlockPointer
+void
+benchMappedReads (void)
+{
+	const int numPages = 16384, numReads = 1 << 20;
+	const char *modes[] = { "readBlock", "mapped readBlock", "getBlockPointer" };
+	SM_PageHandle page = (SM_PageHandle) malloc(PAGE_SIZE);
+	long sum = 0;
+	int m, i;
+
+	CHECK(createPageFile(BENCH_FILE));
+	printf("\n%-28s %-12s\n", "read", "ns/page");
+
+	for (m = 0; m < 3; m++)
+	{
+		SM_FileHandle fh;
+		struct timespec start, end;
+		unsigned int seed = 42;
+
+		CHECK(m == 0 ? openPageFile(BENCH_FILE, &fh) : openMappedPageFile(BENCH_FILE, &fh));
+		CHECK(ensureCapacity(numPages, &fh));
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (i = 0; i < numReads; i++)
+		{
+			seed = seed * 1103515245 + 12345;
+			if (m < 2)
+			{
+				CHECK(readBlock((seed >> 8) % numPages, &fh, page));
+			}
+			else
+			{
+				SM_PageHandle mapped;
+				CHECK(getBlockPointer((seed >> 8) % numPages, &fh, &mapped));
+				sum += mapped[0];
+			}
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		printf("%-28s %-12.1f\n", modes[m], elapsedNs(&start, &end) / numReads);
+
+		CHECK(closePageFile(&fh));
+	}
+
+	CHECK(destroyPageFile(BENCH_FILE));
+	free(page);
+	if (sum != 0)
+		printf("unexpected page content\n");
+}
+
+// ************************************************************
+// measure random reads that bypass the page cache with 1 to 64 of them in
+// flight, with io_uring and with the worker threads
+void
+benchQueueDepth (void)
+{
+	const int numPages = 16384, numReads = 20000, maxDepth = 64;
+	const char *engines[] = { "io_uring", "threads" };
+	SM_PageHandle pages[64];
+	SM_AsyncToken tokens[64];
+	SM_FileHandle fh;
+	int e, depth, i;
+
+	// the pages are written, reads of space that was only allocated would
+	// not reach the disk
+	for (i = 0; i < maxDepth; i++)
+	{
+		if (posix_memalign((void **) &pages[i], PAGE_SIZE, PAGE_SIZE) != 0)
+			exit(1);
+		memset(pages[i], i, PAGE_SIZE);
+	}
+	CHECK(createPageFile(BENCH_FILE));
+	CHECK(openPageFile(BENCH_FILE, &fh));
+	CHECK(ensureCapacity(numPages, &fh));
+	for (i = 0; i < numPages; i += maxDepth)
+		CHECK(writeBlocks(i, maxDepth, &fh, pages));
+	CHECK(closePageFile(&fh));
+
+	CHECK(setDirectIO(1));
+	printf("\n%-12s %-12s %-12s\n", "engine", "depth", "reads/s");
+	for (e = SM_ASYNC_IO_URING; e <= SM_ASYNC_THREADS; e++)
+	{
+		for (depth = 1; depth <= maxDepth; depth *= 2)
+		{
+			SM_AsyncEngine engine;
+			struct timespec start, end;
+			unsigned int seed = 42;
+
+			CHECK(setAsyncEngine(e, depth));
+			CHECK(openPageFile(BENCH_FILE, &fh));
+			CHECK(getAsyncEngine(&fh, &engine));
+
+			// keep depth reads in flight, replacing each one that is done
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			for (i = 0; i < numReads + depth; i++)
+			{
+				if (i >= depth)
+					CHECK(waitBlock(tokens[i % depth], &fh));
+				if (i < numReads)
+				{
+					seed = seed * 1103515245 + 12345;
+					CHECK(submitReadBlock((seed >> 8) % numPages, &fh, pages[i % depth], &tokens[i % depth]));
+				}
+			}
+			clock_gettime(CLOCK_MONOTONIC, &end);
+			printf("%-12s %-12i %-12.0f\n", engines[engine], depth, numReads / (elapsedNs(&start, &end) / 1e9));
+
+			CHECK(closePageFile(&fh));
+		}
+	}
+	CHECK(setDirectIO(0));
+	CHECK(setAsyncEngine(SM_ASYNC_IO_URING, 32));
+
+	CHECK(destroyPageFile(BENCH_FILE));
+	for (i = 0; i < maxDepth; i++)
+		free(pages[i]);
+}
+
+// ************************************************************
+// worker of benchCommits: update its own page and force it
+typedef struct CommitWorker {
+	BM_BufferPool *bm;
+	int pageNum;
+	int numCommits;
+} CommitWorker;
+
+static void *
+runCommitWorker (void *arg)
+{
+	CommitWorker *w = (CommitWorker *) arg;
+	BM_PageHandle h;
+	int i;
+
+	for (i = 0; i < w->numCommits; i++)
+	{
+		CHECK(pinPage(w->bm, &h, w->pageNum));
+		CHECK(latchPage(w->bm, &h, true));
+		sprintf(h.data, "Commit-%i", i);
+		CHECK(markDirty(w->bm, &h));
+		CHECK(unlatchPage(w->bm, &h));
+		CHECK(forcePage(w->bm, &h));
+		CHECK(unpinPage(w->bm, &h));
+	}
+	return NULL;
+}
+
+// measure the commit throughput of threads that each force their own page,
+// with every durability policy
+void
+benchCommits (void)
+{
+	const int numThreads = 8, numCommits = 100;
+	const SM_Durability durabilities[] = { SM_DURABILITY_NONE, SM_DURABILITY_SYNC,
+			SM_DURABILITY_GROUP_COMMIT, SM_DURABILITY_GROUP_COMMIT };
+	const int windows[] = { 0, 0, 0, 200 };
+	const char *names[] = { "none", "sync", "group commit", "group commit 200us" };
+	CommitWorker workers[8];
+	pthread_t threads[8];
+	int d, t;
+
+	CHECK(createPageFile(BENCH_FILE));
+	printf("\n%-20s %-12s %-12s %-12s\n", "durability", "commits/s", "forces", "syncs");
+
+	for (d = 0; d < 4; d++)
+	{
+		BM_BufferPool *bm = MAKE_POOL();
+		struct timespec start, end;
+		SM_FileHandle *fh;
+
+		CHECK(initBufferPool(bm, BENCH_FILE, numThreads, RS_LRU, NULL));
+		CHECK(setPoolDurability(bm, durabilities[d], windows[d]));
+		fh = ((PageCache *) bm->mgmtData)->fHandle;
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (t = 0; t < numThreads; t++)
+		{
+			workers[t].bm = bm;
+			workers[t].pageNum = t;
+			workers[t].numCommits = numCommits;
+			pthread_create(&threads[t], NULL, runCommitWorker, &workers[t]);
+		}
+		for (t = 0; t < numThreads; t++)
+			pthread_join(threads[t], NULL);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		printf("%-20s %-12.0f %-12i %-12i\n", names[d], numThreads * numCommits / (elapsedNs(&start, &end) / 1e9),
+				getNumForceRequests(fh), getNumSyncs(fh));
+		CHECK(shutdownBufferPool(bm));
+	}
+
+	CHECK(destroyPageFile(BENCH_FILE));
+}
+
+// get the nanoseconds between two time points
+double
+elapsedNs (struct timespec *start, struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) * 1e9 + (end->tv_nsec - start->tv_nsec);
+}
+
+// ************************************************************
+// measure the checksum of a page with the crc32 instruction and with the
+// tables, and random page reads and writes of a file in the page cache and
+// reads that bypass it, with and without checksums
+void
+benchChecksums (void)
+{
+	const int numPages = 16384, numOps = 1 << 18, numDirectReads = 20000;
+	const char *modes[] = { "readBlock", "writeBlock", "direct readBlock" };
+	SM_PageHandle page;
+	struct timespec start, end;
+	uint32_t crc = 0;
+	int c, m, i;
+
+	if (posix_memalign((void **) &page, PAGE_SIZE, PAGE_SIZE) != 0)
+		exit(1);
+	for (i = 0; i < PAGE_SIZE; i++)
+		page[i] = (char) (i * 31);
+
+	printf("\n%-28s %-12s\n", "checksum", "ns/page");
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < numOps; i++)
+		crc += crc32c(crc, page, PAGE_SIZE - PAGE_CHECKSUM_SIZE);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("%-28s %-12.1f\n", crc32cHardwareAvailable() ? "crc32 instruction" : "crc32c", elapsedNs(&start, &end) / numOps);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < numOps; i++)
+		crc += crc32cSlicingBy8(crc, page, PAGE_SIZE - PAGE_CHECKSUM_SIZE);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("%-28s %-12.1f\n", "slicing-by-8", elapsedNs(&start, &end) / numOps);
+
+	printf("\n%-28s %-12s %-12s %-10s\n", "transfer", "ns/page", "checksums", "overhead");
+	for (m = 0; m < 3; m++)
+	{
+		double ns[2];
+		for (c = 0; c < 2; c++)
+		{
+			SM_FileHandle fh;
+			unsigned int seed = 42;
+			int ops = (m == 2) ? numDirectReads : numOps;
+
+			CHECK(setPageChecksums(c));
+			CHECK(createPageFile(BENCH_FILE));
+			CHECK(openPageFile(BENCH_FILE, &fh));
+			CHECK(ensureCapacity(numPages, &fh));
+			for (i = 0; i < numPages; i++)
+				CHECK(writeBlock(i, &fh, page));
+			CHECK(closePageFile(&fh));
+
+			CHECK(setDirectIO(m == 2));
+			CHECK(openPageFile(BENCH_FILE, &fh));
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			for (i = 0; i < ops; i++)
+			{
+				seed = seed * 1103515245 + 12345;
+				if (m == 1)
+				{
+					CHECK(writeBlock((seed >> 8) % numPages, &fh, page));
+				}
+				else
+				{
+					CHECK(readBlock((seed >> 8) % numPages, &fh, page));
+				}
+			}
+			clock_gettime(CLOCK_MONOTONIC, &end);
+			ns[c] = elapsedNs(&start, &end) / ops;
+			CHECK(closePageFile(&fh));
+			CHECK(setDirectIO(0));
+			CHECK(destroyPageFile(BENCH_FILE));
+		}
+		printf("%-28s %-12.1f %-12.1f %+.1f%%\n", modes[m], ns[0], ns[1], 100.0 * (ns[1] - ns[0]) / ns[0]);
+	}
+
+	CHECK(setPageChecksums(0));
+	free(page);
+	if (crc == 1)
+		printf("unexpected checksum\n");
+}
+
+// ************************************************************
+// measure a scan of a 64 MiB file and random point lookups in it through a
+// pool of 1 MiB, for pages of 4, 16 and 64 KiB, from the page cache and with
+// direct I/O
+void
+benchPageSizes (void)
+{
+	const int fileBytes = 64 << 20, poolBytes = 1 << 20, numLookups = 20000;
+	const int sizes[] = { PAGE_SIZE, 16384, MAX_PAGE_SIZE };
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	struct timespec start, end;
+	int direct, s, i;
+
+	printf("\n%-10s %-10s %-12s %-12s %-14s\n", "page", "direct", "scan MB/s", "scan reads", "lookups/s");
+	for (direct = 0; direct < 2; direct++)
+	{
+		for (s = 0; s < 3; s++)
+		{
+			BM_BufferPool *bm = MAKE_POOL();
+			SM_FileHandle fh;
+			int numPages = fileBytes / sizes[s];
+			unsigned int seed = 42;
+			SM_PageHandle page;
+			double scanNs, lookupNs;
+			int reads;
+
+			// the pages are written, reads of space that was only allocated
+			// would not reach the disk
+			if (posix_memalign((void **) &page, PAGE_SIZE, sizes[s]) != 0)
+				exit(1);
+			memset(page, 'p', sizes[s]);
+			CHECK(setPageSize(sizes[s]));
+			CHECK(createPageFile(BENCH_FILE));
+			CHECK(setPageSize(PAGE_SIZE));
+			CHECK(openPageFile(BENCH_FILE, &fh));
+			CHECK(ensureCapacity(numPages, &fh));
+			for (i = 0; i < numPages; i++)
+				CHECK(writeBlock(i, &fh, page));
+			CHECK(closePageFile(&fh));
+			free(page);
+
+			CHECK(setDirectIO(direct));
+			CHECK(initBufferPool(bm, BENCH_FILE, poolBytes / sizes[s], RS_LRU, NULL));
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			for (i = 0; i < numPages; i++)
+			{
+				CHECK(pinPage(bm, h, i));
+				CHECK(unpinPage(bm, h));
+			}
+			clock_gettime(CLOCK_MONOTONIC, &end);
+			scanNs = elapsedNs(&start, &end);
+			reads = getNumReadIO(bm);
+
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			for (i = 0; i < numLookups; i++)
+			{
+				seed = seed * 1103515245 + 12345;
+				CHECK(pinPage(bm, h, (seed >> 8) % numPages));
+				CHECK(unpinPage(bm, h));
+			}
+			clock_gettime(CLOCK_MONOTONIC, &end);
+			lookupNs = elapsedNs(&start, &end);
+
+			printf("%-10i %-10s %-12.0f %-12i %-14.0f\n", sizes[s], direct ? "yes" : "no",
+					fileBytes / (scanNs / 1e9) / (1 << 20), reads, numLookups / (lookupNs / 1e9));
+
+			CHECK(shutdownBufferPool(bm));
+			CHECK(setDirectIO(0));
+			CHECK(destroyPageFile(BENCH_FILE));
+		}
+	}
+	free(h);
+}
+
+// ************************************************************ 
+// compression ratio of pages that look like records, and what compressing
+// and decompressing them adds to writeBlock and readBlock of cached pages
+void
+benchCompression (void)
+{
+	const int numPages = 16384, numOps = 1 << 17;
+	const char *modes[] = { "readBlock", "writeBlock" };
+	SM_PageHandle page = (SM_PageHandle) malloc(PAGE_SIZE);
+	char *packed = (char *) malloc(PAGE_SIZE);
+	struct timespec start, end;
+	double ns[2][2];
+	long bytes[2];
+	int c, m, i, n = 0;
+
+	fillRecordPage(page, 1);
+	printf("\n%-28s %-12s %-12s\n", "codec", "ns/page", "MB/s");
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < numOps; i++)
+		n = lzCompress(page, PAGE_SIZE, packed, PAGE_SIZE - 1);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("%-28s %-12.1f %-12.0f\n", "lzCompress", elapsedNs(&start, &end) / numOps,
+			(double) numOps * PAGE_SIZE / (elapsedNs(&start, &end) / 1e9) / (1 << 20));
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < numOps; i++)
+		lzDecompress(packed, n, page, PAGE_SIZE);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("%-28s %-12.1f %-12.0f\n", "lzDecompress", elapsedNs(&start, &end) / numOps,
+			(double) numOps * PAGE_SIZE / (elapsedNs(&start, &end) / 1e9) / (1 << 20));
+
+	for (c = 0; c < 2; c++)
+	{
+		SM_FileHandle fh;
+		struct stat st;
+
+		CHECK(setPageCompression(c));
+		CHECK(createPageFile(BENCH_FILE));
+		CHECK(openPageFile(BENCH_FILE, &fh));
+		CHECK(ensureCapacity(numPages, &fh));
+		for (i = 0; i < numPages; i++)
+		{
+			fillRecordPage(page, i);
+			CHECK(writeBlock(i, &fh, page));
+		}
+		CHECK(closePageFile(&fh));
+		stat(BENCH_FILE, &st);
+		bytes[c] = st.st_size;
+		if (c == 1 && stat(BENCH_FILE ".map", &st) == 0)
+			bytes[c] += st.st_size;
+
+		CHECK(openPageFile(BENCH_FILE, &fh));
+		for (m = 0; m < 2; m++)
+		{
+			unsigned int seed = 42;
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			for (i = 0; i < numOps; i++)
+			{
+				seed = seed * 1103515245 + 12345;
+				if (m == 1)
+				{
+					CHECK(writeBlock((seed >> 8) % numPages, &fh, page));
+				}
+				else
+				{
+					CHECK(readBlock((seed >> 8) % numPages, &fh, page));
+				}
+			}
+			clock_gettime(CLOCK_MONOTONIC, &end);
+			ns[m][c] = elapsedNs(&start, &end) / numOps;
+		}
+		CHECK(closePageFile(&fh));
+		CHECK(destroyPageFile(BENCH_FILE));
+	}
+	CHECK(setPageCompression(0));
+
+	printf("\n%-28s %-12s %-12s %-10s\n", "file", "bytes", "compressed", "ratio");
+	printf("%-28s %-12ld %-12ld %.2f\n", "record pages", bytes[0], bytes[1], (double) bytes[0] / bytes[1]);
+	printf("\n%-28s %-12s %-12s %-10s\n", "transfer", "ns/page", "compressed", "overhead");
+	for (m = 0; m < 2; m++)
+		printf("%-28s %-12.1f %-12.1f %+.1f%%\n", modes[m], ns[m][0], ns[m][1], 100.0 * (ns[m][1] - ns[m][0]) / ns[m][0]);
+
+	free(packed);
+	free(page);
+}
+
+// ************************************************************ 
+// a table under churn: a working set of pages whose pages are freed and 
+// allocated again at random, with and without reusing the freed pages
+void
+benchFreePages (void)
+{
+	const int numLive = 4096, numOps = 1 << 16;
+	SM_PageHandle page = (SM_PageHandle) calloc(PAGE_SIZE, sizeof(char));
+	int *live = (int *) malloc(numLive * sizeof(int));
+	struct timespec start, end;
+	int reuse, i;
+
+	printf("\n%-28s %-12s %-12s\n", "churn", "ns/op", "file pages");
+	for (reuse = 0; reuse < 2; reuse++)
+	{
+		SM_FileHandle fh;
+		unsigned int seed = 42;
+
+		CHECK(createPageFile(BENCH_FILE));
+		CHECK(openPageFile(BENCH_FILE, &fh));
+		CHECK(ensureCapacity(numLive, &fh));
+		for (i = 0; i < numLive; i++)
+			live[i] = i;
+
+		// each op drops a page of the working set and writes a new one
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (i = 0; i < numOps; i++)
+		{
+			int pageNum, victim;
+			seed = seed * 1103515245 + 12345;
+			victim = (seed >> 8) % numLive;
+			if (reuse)
+			{
+				CHECK(freePage(live[victim], &fh));
+				CHECK(allocatePage(&fh, &pageNum));
+			}
+			else
+			{
+				pageNum = fh.totalNumPages;
+				CHECK(appendEmptyBlock(&fh));
+			}
+			CHECK(writeBlock(pageNum, &fh, page));
+			live[victim] = pageNum;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		printf("%-28s %-12.1f %-12i\n", reuse ? "freePage + allocatePage" : "appendEmptyBlock",
+				elapsedNs(&start, &end) / numOps, fh.totalNumPages);
+		CHECK(closePageFile(&fh));
+		CHECK(destroyPageFile(BENCH_FILE));
+	}
+	free(live);
+	free(page);
+}
+
+// ************************************************************ 
+// a purge of a table: half of its pages in the middle are punched, then the
+// last quarter is freed and cut off, and the space the file takes on disk
+// is measured after each step
+void
+benchPurge (void)
+{
+	const int numPages = 16384;
+	SM_PageHandle page = (SM_PageHandle) malloc(PAGE_SIZE);
+	SM_FileHandle fh;
+	struct timespec start, end;
+	struct stat st;
+	int i;
+
+	memset(page, 'p', PAGE_SIZE);
+	CHECK(createPageFile(BENCH_FILE));
+	CHECK(openPageFile(BENCH_FILE, &fh));
+	CHECK(ensureCapacity(numPages, &fh));
+	for (i = 0; i < numPages; i++)
+		CHECK(writeBlock(i, &fh, page));
+	CHECK(syncPageFile(&fh));
+
+	printf("\n%-28s %-12s %-12s %-12s\n", "purge", "ms", "pages", "disk KiB");
+	stat(BENCH_FILE, &st);
+	printf("%-28s %-12s %-12i %-12ld\n", "written", "", fh.totalNumPages, (long) st.st_blocks / 2);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	CHECK(punchPages(numPages / 4, numPages / 2, &fh));
+	CHECK(syncPageFile(&fh));
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	stat(BENCH_FILE, &st);
+	printf("%-28s %-12.2f %-12i %-12ld\n", "punchPages, half", elapsedNs(&start, &end) / 1e6, fh.totalNumPages,
+			(long) st.st_blocks / 2);
+
+	for (i = numPages * 3 / 4; i < numPages; i++)
+		CHECK(freePage(i, &fh));
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	CHECK(truncateFreePages(&fh));
+	CHECK(syncPageFile(&fh));
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	stat(BENCH_FILE, &st);
+	printf("%-28s %-12.2f %-12i %-12ld\n", "truncateFreePages, quarter", elapsedNs(&start, &end) / 1e6,
+			fh.totalNumPages, (long) st.st_blocks / 2);
+
+	CHECK(closePageFile(&fh));
+	CHECK(destroyPageFile(BENCH_FILE));
+	free(page);
+}
+
+// fill a page with lines that look like records, up to about 85% of it
+void
+fillRecordPage (char *page, int seed)
+{
+	int used = 0, i = 0;
+	memset(page, 0, PAGE_SIZE);
+	while (used < PAGE_SIZE * 85 / 100)
+	{
+		used += sprintf(page + used, "[%04d-%04d](a:%d,b:%s,c:%d)\n", i, seed, i * 7 % 100,
+				(i % 3 == 0) ? "aaaa" : (i % 3 == 1) ? "bbbb" : "cccc", seed + i);
+		i++;
+	}
+}
@@ -4,6 +4,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <pthread.h>
 
 #include "buffer_mgr.h"
 #include "storage_mgr.h"
@@ -26,6 +29,12 @@ RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName,
     if (numPages <= 0) {
         return RC_ERROR;
     }
+
+    // the hooks implementing the replacement strategy
+    const ReplacementPolicy* policy = getReplacementPolicy(strategy);
+    if(policy == NULL) {
+        return RC_ERROR;
+    }
     
     // check if the file specified by the filename exisits
     FILE *fp = fopen(pageFileName, "r+");
@@ -41,6 +50,12 @@ RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName,
     // initialize page cache
     PageCache* pageCache = createPageCache(bm, numPages);
 
+    // the policy sets up its own state, stratData is passed to it unchanged
+    pageCache->policy = policy;
+    if(policy->init != NULL) {
+        policy->init(pageCache, stratData);
+    }
+
     bm->mgmtData = pageCache;
 
     fclose(fp);
@@ -69,6 +84,9 @@ RC shutdownBufferPool(BM_BufferPool *const bm)
         return RC_OK;
     }
 
+    // the flusher must not touch the pool while it is released
+    stopFlusher(bm);
+
     // force to flush all pages in buffer pool
     if(forceFlushPool(bm) != RC_OK) {
         return RC_ERROR;
@@ -102,30 +120,139 @@ RC forceFlushPool(BM_BufferPool *const bm)
     if(pageCache == NULL) {
         return RC_OK;
     }
-    // iterate to check all frames 
-    int i;
-    for(i = 0; i < pageCache->capacity; i++) {
-        Frame* frame = pageCache->arr[i];
-        // this frame has no page file
-        if(frame->pageNum == NO_PAGE) {
-            continue;
+
+    // pin the dirty pages under the latch and write them after releasing it
+    Frame** frames = (Frame**) malloc(pageCache->capacity * sizeof(Frame*));
+    pthread_mutex_lock(&pageCache->latch);
+    int num = pinDirtyFrames(pageCache, pageCache->arr, pageCache->capacity, frames);
+    pthread_mutex_unlock(&pageCache->latch);
+
+    RC rc = writePinnedFrames(pageCache, frames, num);
+    free(frames);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    return syncPageCache(pageCache);
+}
+
+// setPoolDurability selects when the pages written by the pool become durable,
+// see setDurability. forcePage and forceFlushPool make a force request once 
+// their pages are written, so with SM_DURABILITY_GROUP_COMMIT concurrent 
+// forces share a sync.
+RC setPoolDurability(BM_BufferPool *const bm, SM_Durability durability, int windowMicros)
+{
+    // check validation of bm
+    if(bm == NULL || bm->mgmtData == NULL) {
+        return RC_ERROR;
+    }
+
+    PageCache* pageCache = bm->mgmtData;
+    return setDurability(pageCache->fHandle, durability, windowMicros);
+}
+
+// setWriteThrough selects when dirty pages are written. A write-through pool 
+// writes a dirty page as soon as its last pin is released. By default the pool
+// is write-back: dirty pages are written when they are evicted, forced or 
+// flushed, so repeated updates of a page cost a single write.
+RC setWriteThrough(BM_BufferPool *const bm, bool writeThrough)
+{
+    // check validation of bm
+    if(bm == NULL || bm->mgmtData == NULL) {
+        return RC_ERROR;
+    }
+
+    PageCache* pageCache = bm->mgmtData;
+    pageCache->writeThrough = writeThrough;
+
+    return RC_OK;
+}
+
+// Body of the background flusher. Every flushInterval milliseconds it writes
+// the dirty pages among the next cleanFraction of the frames the replacement
+// policy would evict, so that a pinPage that misses mostly finds a clean 
+// victim. The pages are pinned while they are written, so the latch is only
+// held to pick them.
+static void* runFlusher(void* arg)
+{
+    PageCache* pageCache = (PageCache*) arg;
+
+    pthread_mutex_lock(&pageCache->latch);
+    while(!pageCache->flusherStop) {
+        int max = (int) (pageCache->cleanFraction * pageCache->capacity + 0.5);
+        if(max < 1) {
+            max = 1;
+        }
+        int num = collectNextVictims(pageCache, pageCache->candidates, max);
+        num = pinDirtyFrames(pageCache, pageCache->candidates, num, pageCache->candidates);
+        pthread_mutex_unlock(&pageCache->latch);
+        writePinnedFrames(pageCache, pageCache->candidates, num);
+        pthread_mutex_lock(&pageCache->latch);
+
+        // sleep until the next pass, stopFlusher wakes the flusher up early
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += pageCache->flushInterval / 1000;
+        deadline.tv_nsec += (long) (pageCache->flushInterval % 1000) * 1000000;
+        if(deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
         }
-        // force all drity pages from the buffer pool to be written to disk
-        if (frame->dirtyBit == 1 && frame->pinCount == 0) {
-            // get the disk page handle pointer
-            SM_FileHandle *fHandle = pageCache->fHandle;
+        if(!pageCache->flusherStop) {
+            pthread_cond_timedwait(&pageCache->flusherCond, &pageCache->latch, &deadline);
+        }
+    }
+    pthread_mutex_unlock(&pageCache->latch);
+    return NULL;
+}
 
-            // write this dirty page to the disk
-            if(writeBlock(frame->pageNum, fHandle, frame->data) != RC_OK) {
-                return RC_WRITE_FAILED;
-            }
-            pageCache->numWrite++;
-            
-            // after flush all dirth pages in buffer pool
-            frame->dirtyBit = 0;
-        } 
+// startFlusher starts the background flusher of a buffer pool. It keeps the 
+// next cleanFraction (0 to 1] of the frames to be evicted clean, checking them
+// every flushInterval milliseconds. shutdownBufferPool stops it.
+RC startFlusher(BM_BufferPool *const bm, double cleanFraction, int flushInterval)
+{
+    // check validation of parameters
+    if(bm == NULL || bm->mgmtData == NULL || cleanFraction <= 0 || cleanFraction > 1 || flushInterval <= 0) {
+        return RC_ERROR;
+    }
+
+    PageCache* pageCache = bm->mgmtData;
+    if(pageCache->flusherRunning) {
+        return RC_ERROR;
+    }
+
+    pageCache->cleanFraction = cleanFraction;
+    pageCache->flushInterval = flushInterval;
+    pageCache->flusherStop = FALSE;
+    if(pthread_create(&pageCache->flusher, NULL, runFlusher, pageCache) != 0) {
+        return RC_ERROR;
+    }
+    pageCache->flusherRunning = TRUE;
+
+    return RC_OK;
+}
+
+// stopFlusher stops the background flusher and waits for it to finish its 
+// current write. It does nothing if no flusher runs.
+RC stopFlusher(BM_BufferPool *const bm)
+{
+    // check validation of bm
+    if(bm == NULL || bm->mgmtData == NULL) {
+        return RC_ERROR;
+    }
+
+    PageCache* pageCache = bm->mgmtData;
+    if(!pageCache->flusherRunning) {
+        return RC_OK;
     }
 
+    pthread_mutex_lock(&pageCache->latch);
+    pageCache->flusherStop = TRUE;
+    pthread_cond_signal(&pageCache->flusherCond);
+    pthread_mutex_unlock(&pageCache->latch);
+
+    pthread_join(pageCache->flusher, NULL);
+    pageCache->flusherRunning = FALSE;
+
     return RC_OK;
 }
 
@@ -150,29 +277,13 @@ RC pinPage (BM_BufferPool *const bm, BM_PageHandle *const page,
         return RC_ERROR;
     }
 
-    // check whether this pageNum hit the pageCache
-    Frame* frame = isHitPageCache(pageCache, pageNum);
-
-    // if yes, hit page cache
-    if(frame != NULL) {
-        // printf("hit page cache===\n");
-        // printf("frame data = %s\n", frame->data);
-        page->pageNum = pageNum;
-        page->data = frame->data;
-        frame->pinCount++;
-        if(bm->strategy == RS_LRU) {
-            updateLRUOrder(pageCache, pageNum);
-        }
+    // if the page hits the page cache, only its stripe of the page table is latched
+    if(pinCachedPage(pageCache, page, pageNum)) {
         return RC_OK;
     }
     
-    // if no execute different pin page processes based on replacement strategy
-    if(bm->strategy == RS_FIFO) {
-        return addPageToPageCacheWithFIFO(bm, page, pageNum);
-    } else if(bm->strategy == RS_LRU) {
-        return addPageToPageCacheWithLRU(bm, page, pageNum);
-    }
-    return RC_OK;
+    // if no read the page into a free frame or the frame of a victim
+    return addPageToPageCache(bm, page, pageNum);
 }
 
 
@@ -191,16 +302,21 @@ RC markDirty (BM_BufferPool *const bm, BM_PageHandle *const page)
         return RC_OK;
     }
 
+    PageTable* stripe = getPageTableStripe(pageCache, page->pageNum);
+    pthread_mutex_lock(&stripe->latch);
+
     // search a frame from page cache
-    Frame* frame = searchPageFromCache(pageCache, page->pageNum);
+    Frame* frame = lookupPageTable(pageCache, page->pageNum);
 
     // if this frame doesn't exist
     if(frame == NULL) {
+        pthread_mutex_unlock(&stripe->latch);
         return RC_ERROR;
     }
 
     frame->dirtyBit = 1;
 
+    pthread_mutex_unlock(&stripe->latch);
     return RC_OK;
 }
 
@@ -219,21 +335,31 @@ RC unpinPage (BM_BufferPool *const bm, BM_PageHandle *const page)
         return RC_OK;
     }
 
+    PageTable* stripe = getPageTableStripe(pageCache, page->pageNum);
+    pthread_mutex_lock(&stripe->latch);
+
     // search a frame from page cache
-    Frame* frame = searchPageFromCache(pageCache, page->pageNum);
+    Frame* frame = lookupPageTable(pageCache, page->pageNum);
 
     // if this frame doesn't exist
     if(frame == NULL) {
+        pthread_mutex_unlock(&stripe->latch);
         return RC_ERROR;
     }
 
-    frame->pinCount--;
-
-    if(frame->pinCount == 0 && frame->dirtyBit == 1) {
-        // printf("hit force page");
-        forcePage(bm, page);
+    // a write-through pool writes the page once nobody uses it, our pin keeps
+    // the page in its frame until it is written
+    RC rc = RC_OK;
+    if(pageCache->writeThrough && frame->pinCount == 1 && frame->dirtyBit == 1) {
+        pthread_mutex_unlock(&stripe->latch);
+        rc = writeFrame(pageCache, frame);
+        frame->pinCount--;
+        return rc;
     }
-    return RC_OK;
+
+    frame->pinCount--;
+    pthread_mutex_unlock(&stripe->latch);
+    return rc;
 
 }
 
@@ -252,42 +378,393 @@ RC forcePage (BM_BufferPool *const bm, BM_PageHandle *const page)
         return RC_OK;
     }
 
+    PageTable* stripe = getPageTableStripe(pageCache, page->pageNum);
+    pthread_mutex_lock(&stripe->latch);
+
     // search a frame from page cache
-    Frame* frame = searchPageFromCache(pageCache, page->pageNum);
+    Frame* frame = lookupPageTable(pageCache, page->pageNum);
 
     // if this frame doesn't exist
     if(frame == NULL) {
+        pthread_mutex_unlock(&stripe->latch);
+        return RC_ERROR;
+    }
+
+    // pin the page so that it stays in its frame while it is written
+    frame->pinCount++;
+    pthread_mutex_unlock(&stripe->latch);
+
+    RC rc = writeFrame(pageCache, frame);
+    frame->pinCount--;
+    if (rc != RC_OK) {
+        return rc;
+    }
+
+    // the page may have been written before, by an eviction or the flusher
+    return syncPageCache(pageCache);
+}
+
+// latchPage latches the content of a pinned page. Any number of threads may
+// hold the latch shared to read the page, a single thread may hold it 
+// exclusive to update it. Pages are written back under a shared latch, so an
+// update done under the exclusive latch is never written half done. The latch
+// must be released with unlatchPage before the page is unpinned.
+RC latchPage (BM_BufferPool *const bm, BM_PageHandle *const page, bool exclusive)
+{
+    // check the validation of parameters
+    if(bm == NULL || bm->mgmtData == NULL || page == NULL) {
+        return RC_ERROR;
+    }
+
+    PageCache* pageCache = bm->mgmtData;
+    PageTable* stripe = getPageTableStripe(pageCache, page->pageNum);
+    pthread_mutex_lock(&stripe->latch);
+    Frame* frame = lookupPageTable(pageCache, page->pageNum);
+    pthread_mutex_unlock(&stripe->latch);
+
+    // the page must be pinned, so it stays in its frame while we wait
+    if(frame == NULL || frame->pinCount == 0) {
+        return RC_ERROR;
+    }
+
+    if(exclusive) {
+        pthread_rwlock_wrlock(&frame->latch);
+    } else {
+        pthread_rwlock_rdlock(&frame->latch);
+    }
+    return RC_OK;
+}
+
+// unlatchPage releases the latch taken by latchPage
+RC unlatchPage (BM_BufferPool *const bm, BM_PageHandle *const page)
+{
+    // check the validation of parameters
+    if(bm == NULL || bm->mgmtData == NULL || page == NULL) {
+        return RC_ERROR;
+    }
+
+    PageCache* pageCache = bm->mgmtData;
+    PageTable* stripe = getPageTableStripe(pageCache, page->pageNum);
+    pthread_mutex_lock(&stripe->latch);
+    Frame* frame = lookupPageTable(pageCache, page->pageNum);
+    pthread_mutex_unlock(&stripe->latch);
+
+    if(frame == NULL) {
+        return RC_ERROR;
+    }
+
+    pthread_rwlock_unlock(&frame->latch);
+    return RC_OK;
+}
+
+// allocatePoolPage gives a page of the page file to the caller, a page freed
+// with freePoolPage first, see allocatePage of the storage manager. The page
+// is not pinned, what it holds is left to the caller to write.
+RC allocatePoolPage (BM_BufferPool *const bm, PageNumber *pageNum)
+{
+    // check the validation of parameters
+    if(bm == NULL || bm->mgmtData == NULL || pageNum == NULL) {
         return RC_ERROR;
     }
 
-    // get the disk page handle pointer
-    SM_FileHandle* fHandle = pageCache->fHandle;
+    // the file may grow, like in addPageToPageCache
+    PageCache* pageCache = bm->mgmtData;
+    pthread_rwlock_wrlock(&pageCache->ioLatch);
+    RC rc = allocatePage(pageCache->fHandle, pageNum);
+    pthread_rwlock_unlock(&pageCache->ioLatch);
+    return rc;
+}
 
-    // printf("frame->data = %s\n", frame->data);
+// freePoolPage gives a page of the page file back, see freePage of the 
+// storage manager. The page must not be pinned. A copy of it that is cached
+// is dropped without being written back, the page may hold the free page map
+// from now on and a later pin reads it from the page file.
+RC freePoolPage (BM_BufferPool *const bm, const PageNumber pageNum)
+{
+    // check the validation of parameters
+    if(bm == NULL || bm->mgmtData == NULL || pageNum < 0) {
+        return RC_ERROR;
+    }
 
-    // write this dirty page to the disk
-    if(writeBlock(frame->pageNum, fHandle, frame->data) != RC_OK) {
-        return RC_WRITE_FAILED;
+    // a write of the page started before is pinning it and waits for the 
+    // exclusive ioLatch, a pin that misses waits for it as well
+    PageCache* pageCache = bm->mgmtData;
+    pthread_rwlock_wrlock(&pageCache->ioLatch);
+    pthread_mutex_lock(&pageCache->latch);
+    PageTable* stripe = getPageTableStripe(pageCache, pageNum);
+    pthread_mutex_lock(&stripe->latch);
+    Frame* frame = lookupPageTable(pageCache, pageNum);
+    bool pinned = frame != NULL && frame->pinCount > 0;
+    if(frame != NULL && !pinned) {
+        frame->dirtyBit = 0;
+        evictPage(pageCache, frame);
+        putFreeFrame(pageCache, frame);
     }
+    pthread_mutex_unlock(&stripe->latch);
+    pthread_mutex_unlock(&pageCache->latch);
+
+    RC rc = pinned ? RC_ERROR : freePage(pageNum, pageCache->fHandle);
+    pthread_rwlock_unlock(&pageCache->ioLatch);
+    return rc;
+}
 
+// Drop the cached copies of the pages from startPage on up to endPage,
+// exclusive, without writing them back. The caller holds ioLatch exclusive,
+// so no page is read or written, and the latch of the page cache and of 
+// every stripe, so no page gets pinned. If one of the pages is pinned none is
+// dropped and RC_ERROR is returned.
+static RC dropCachedPages(PageCache* pageCache, PageNumber startPage, PageNumber endPage)
+{
+    for(int i = 0; i < pageCache->capacity; i++) {
+        Frame* frame = pageCache->arr[i];
+        if(frame->pageNum >= startPage && frame->pageNum < endPage && frame->pinCount > 0) {
+            return RC_ERROR;
+        }
+    }
+    for(int i = 0; i < pageCache->capacity; i++) {
+        Frame* frame = pageCache->arr[i];
+        if(frame->pageNum != NO_PAGE && frame->pageNum >= startPage && frame->pageNum < endPage) {
+            frame->dirtyBit = 0;
+            evictPage(pageCache, frame);
+            putFreeFrame(pageCache, frame);
+        }
+    }
     return RC_OK;
 }
 
+// latch the page cache and every stripe of the page table, the stripes in 
+// the order of lockPageTableStripes
+static void lockPageCache(PageCache* pageCache)
+{
+    pthread_mutex_lock(&pageCache->latch);
+    for(int i = 0; i < PAGE_TABLE_STRIPES; i++) {
+        pthread_mutex_lock(&pageCache->pageTable[i].latch);
+    }
+}
+
+static void unlockPageCache(PageCache* pageCache)
+{
+    for(int i = PAGE_TABLE_STRIPES - 1; i >= 0; i--) {
+        pthread_mutex_unlock(&pageCache->pageTable[i].latch);
+    }
+    pthread_mutex_unlock(&pageCache->latch);
+}
+
+// punchPoolPages punches count pages from startPage on, see punchPages of the
+// storage manager. None of the pages may be pinned. Their cached copies are
+// dropped without being written back, so a later pin reads '\0' bytes.
+RC punchPoolPages (BM_BufferPool *const bm, const PageNumber startPage, int count)
+{
+    // check the validation of parameters
+    if(bm == NULL || bm->mgmtData == NULL || startPage < 0 || count < 0) {
+        return RC_ERROR;
+    }
+
+    // like in freePoolPage, writes and pins that miss wait for the ioLatch. 
+    // A range past the end is refused before any dirty copy is dropped.
+    PageCache* pageCache = bm->mgmtData;
+    pthread_rwlock_wrlock(&pageCache->ioLatch);
+    if(startPage + count > pageCache->fHandle->totalNumPages) {
+        pthread_rwlock_unlock(&pageCache->ioLatch);
+        return RC_READ_NON_EXISTING_PAGE;
+    }
+    lockPageCache(pageCache);
+    RC rc = dropCachedPages(pageCache, startPage, startPage + count);
+    unlockPageCache(pageCache);
+
+    if(rc == RC_OK) {
+        rc = punchPages(startPage, count, pageCache->fHandle);
+    }
+    pthread_rwlock_unlock(&pageCache->ioLatch);
+    return rc;
+}
+
+// truncatePoolFreePages shortens the page file by the free pages at its end, 
+// see truncateFreePages of the storage manager. Which pages go is known only
+// once the file is cut, so no page of the pool may be pinned. The cached 
+// copies of the pages past the new end are dropped, the file does not grow
+// again when they would be written back.
+RC truncatePoolFreePages (BM_BufferPool *const bm)
+{
+    // check the validation of parameters
+    if(bm == NULL || bm->mgmtData == NULL) {
+        return RC_ERROR;
+    }
+
+    PageCache* pageCache = bm->mgmtData;
+    pthread_rwlock_wrlock(&pageCache->ioLatch);
+    lockPageCache(pageCache);
+    bool pinned = FALSE;
+    for(int i = 0; i < pageCache->capacity; i++) {
+        if(pageCache->arr[i]->pageNum != NO_PAGE && pageCache->arr[i]->pinCount > 0) {
+            pinned = TRUE;
+        }
+    }
+
+    RC rc = pinned ? RC_ERROR : truncateFreePages(pageCache->fHandle);
+    if(rc == RC_OK) {
+        rc = dropCachedPages(pageCache, pageCache->fHandle->totalNumPages, INT_MAX);
+    }
+    unlockPageCache(pageCache);
+    pthread_rwlock_unlock(&pageCache->ioLatch);
+    return rc;
+}
+
+// Write a run of frames storing adjacent pages, from frames[0] on, with one
+// call to the storage manager, the pages become clean. Only the latch of the
+// first frame is waited for, the run stops before a frame whose latch is 
+// held exclusive. written gets the number of frames in the run. The caller 
+// must keep the pages in their frames, usually by pinning them.
+static RC writeFrameRun(PageCache* pageCache, Frame** frames, int cnt, int* written)
+{
+    pthread_rwlock_rdlock(&frames[0]->latch);
+    int n = 1;
+    while(n < cnt && pthread_rwlock_tryrdlock(&frames[n]->latch) == 0) {
+        n++;
+    }
+
+    // clear the dirty bits first, so that a markDirty during the write is kept
+    SM_PageHandle* pages = (SM_PageHandle*) malloc(n * sizeof(SM_PageHandle));
+    for(int i = 0; i < n; i++) {
+        frames[i]->dirtyBit = 0;
+        pages[i] = frames[i]->data;
+    }
+
+    pthread_rwlock_rdlock(&pageCache->ioLatch);
+    RC rc = writeBlocks(frames[0]->pageNum, n, pageCache->fHandle, pages);
+    if(rc == RC_OK) {
+        pageCache->numWrite += n;
+        pageCache->numCoalescedWrites += n - 1;
+    }
+    pthread_rwlock_unlock(&pageCache->ioLatch);
+
+    for(int i = 0; i < n; i++) {
+        if(rc != RC_OK) {
+            frames[i]->dirtyBit = 1;
+        }
+        pthread_rwlock_unlock(&frames[i]->latch);
+    }
+    free(pages);
+
+    *written = n;
+    return (rc == RC_OK) ? RC_OK : RC_WRITE_FAILED;
+}
+
+// write the page stored in a frame to the page file, the page becomes clean.
+// The caller must keep the page in its frame, usually by pinning it.
+RC writeFrame(PageCache* pageCache, Frame* frame)
+{
+    int written;
+    return writeFrameRun(pageCache, &frame, 1, &written);
+}
+
+// make the pages written so far durable as selected by setPoolDurability. The
+// file does not grow meanwhile.
+RC syncPageCache(PageCache* pageCache)
+{
+    pthread_rwlock_rdlock(&pageCache->ioLatch);
+    RC rc = syncPageFile(pageCache->fHandle);
+    pthread_rwlock_unlock(&pageCache->ioLatch);
+    return rc;
+}
+
+// order frames by the page number they store
+static int comparePageNumbers(const void* a, const void* b)
+{
+    PageNumber x = (*(Frame* const*) a)->pageNum;
+    PageNumber y = (*(Frame* const*) b)->pageNum;
+    return (x > y) - (x < y);
+}
+
+// pin the dirty and unpinned frames among num frames and store them in pinned,
+// which may be frames itself, return the number of pinned frames. The caller
+// holds the latch of the page cache, so that no frame changes its page.
+int pinDirtyFrames(PageCache* pageCache, Frame** frames, int num, Frame** pinned)
+{
+    int cnt = 0;
+    for(int i = 0; i < num; i++) {
+        Frame* frame = frames[i];
+        if(frame->pageNum == NO_PAGE || frame->dirtyBit == 0) {
+            continue;
+        }
+        // a pin taken under the stripe latch in the meantime keeps the page
+        // as well, but the page is only written once it is unpinned
+        PageTable* stripe = getPageTableStripe(pageCache, frame->pageNum);
+        pthread_mutex_lock(&stripe->latch);
+        if(frame->pinCount == 0) {
+            frame->pinCount++;
+            pinned[cnt++] = frame;
+        }
+        pthread_mutex_unlock(&stripe->latch);
+    }
+    return cnt;
+}
+
+// Write and unpin the frames pinned by pinDirtyFrames. The pages that are 
+// still dirty are written in page order, and each run of adjacent pages is 
+// written with one call, so the disk sees long sequential writes. The order
+// of frames is changed.
+RC writePinnedFrames(PageCache* pageCache, Frame** frames, int num)
+{
+    int cnt = 0;
+    for(int i = 0; i < num; i++) {
+        if(frames[i]->dirtyBit == 1) {
+            frames[cnt++] = frames[i];
+        } else {
+            frames[i]->pinCount--;
+        }
+    }
+    qsort(frames, cnt, sizeof(Frame*), comparePageNumbers);
+
+    RC rc = RC_OK;
+    int i = 0;
+    while(i < cnt) {
+        int end = i + 1;
+        while(end < cnt && frames[end]->pageNum == frames[end - 1]->pageNum + 1) {
+            end++;
+        }
+        int written;
+        if(writeFrameRun(pageCache, frames + i, end - i, &written) != RC_OK) {
+            rc = RC_WRITE_FAILED;
+        }
+        for(int j = i; j < i + written; j++) {
+            frames[j]->pinCount--;
+        }
+        i += written;
+    }
+    return rc;
+}
 
-// initialize a new frame node in buffer pool
-Frame* createFrameNode() 
+// initialize a new frame node in buffer pool, for pages of pageSize bytes
+Frame* createFrameNode(int pageSize) 
 {
     // allocate memory for this frame
     Frame* frame = (Frame*)calloc(1, sizeof(Frame));
 
-    // allocate memory for storing the content of the page
-    char* data = (char *) calloc(PAGE_SIZE, sizeof(char));
+    // allocate memory for storing the content of the page, aligned to the
+    // page size so that direct I/O can transfer it without a copy
+    char* data = NULL;
+    if (posix_memalign((void **) &data, PAGE_SIZE, pageSize) != 0) {
+        free(frame);
+        return NULL;
+    }
+    memset(data, 0, pageSize);
 
     // initialize values for every attributes
     frame->pageNum = NO_PAGE; 
     frame->pinCount = 0; 
     frame->dirtyBit = 0;
     frame->data = data;
+    frame->frameIndex = -1;
+    frame->prev = -1;
+    frame->next = -1;
+    frame->refBit = 0;
+    frame->bucket = -1;
+    frame->history = -1;
+    frame->heapPos = -1;
+    frame->hot = 0;
+    frame->loading = 0;
+    pthread_rwlock_init(&frame->latch, NULL);
     return frame;
 }
 
@@ -296,39 +773,49 @@ RC resetFrameNode(Frame* frame) {
     frame->pageNum = NO_PAGE; 
     frame->pinCount = 0; 
     frame->dirtyBit = 0;
+    frame->refBit = 0;
     return RC_OK;
 }
 
-// create a map to record the utility of every frames, used for LRU
-int* createHash(int capacity )
-{
-    int* hash =(int*)malloc(capacity * sizeof(int));
-    for(int i = 0; i < capacity; i++) {
-        hash[i] = -1;
-    }
-    return hash;
-}
-
 // create a cache area for pages 
 PageCache* createPageCache(BM_BufferPool *const bm, int numPages) {
     // allocate memory for this page cache
     PageCache* pageCache = (PageCache* ) malloc(sizeof(PageCache));
 
     // initialize values for every attribute
-    pageCache->front = 0;
-    pageCache->rear = -1;
     pageCache->frameCnt = 0;
     pageCache->capacity = numPages;
     pageCache->numRead=0;
     pageCache->numWrite=0;
-
-    // store a page data
-    pageCache->arr = (Frame**) malloc(numPages * sizeof(Frame*));
-    int i;
-    for(i = 0; i < pageCache->capacity; ++i ) {
-        Frame* frame = createFrameNode();
-        pageCache->arr[i] = frame;
-    }
+    pageCache->numCoalescedWrites = 0;
+    pageCache->writeThrough = FALSE;
+    pageCache->numEvictions = 0;
+    pageCache->numCleanEvictions = 0;
+    pthread_mutex_init(&pageCache->latch, NULL);
+    pthread_rwlock_init(&pageCache->ioLatch, NULL);
+    pthread_cond_init(&pageCache->flusherCond, NULL);
+    pageCache->flusherRunning = FALSE;
+    pageCache->flusherStop = FALSE;
+    pageCache->cleanFraction = 0;
+    pageCache->flushInterval = 0;
+    pageCache->candidates = (Frame**) malloc(numPages * sizeof(Frame*));
+
+    pageCache->lruHead = -1;
+    pageCache->lruTail = -1;
+    pageCache->freeHead = -1;
+    pageCache->clockHand = 0;
+    pageCache->buckets = NULL;
+    pageCache->minBucket = -1;
+    pageCache->freeBucket = -1;
+    pageCache->agingPeriod = 0;
+    pageCache->refCnt = 0;
+    pageCache->histories = NULL;
+    pageCache->historyMap = NULL;
+    pageCache->heap = NULL;
+    pageCache->heapSearch = NULL;
+    pageCache->a1out = NULL;
+    pageCache->a1outMap = NULL;
+    pageCache->policy = NULL;
 
     // store file handle data
     SM_FileHandle* fHandle = (SM_FileHandle*)calloc(1, sizeof(SM_FileHandle));
@@ -337,12 +824,22 @@ PageCache* createPageCache(BM_BufferPool *const bm, int numPages) {
 
     pageCache->fHandle = fHandle;
 
-    // initialize hash map
-    if(bm->strategy == RS_LRU) {
-        pageCache->hash = createHash(numPages);
-    } else if(bm->strategy == RS_FIFO) {
-        pageCache->hash = NULL;
+    // the frames hold pages of the size of the file
+    bm->pageSize = (fHandle->pageSize > 0) ? fHandle->pageSize : PAGE_SIZE;
+
+    // store a page data, every frame starts in the free list
+    pageCache->arr = (Frame**) malloc(numPages * sizeof(Frame*));
+    int i;
+    for(i = pageCache->capacity - 1; i >= 0; --i ) {
+        Frame* frame = createFrameNode(bm->pageSize);
+        frame->frameIndex = i;
+        pageCache->arr[i] = frame;
+        putFreeFrame(pageCache, frame);
     }
+
+    // initialize the page table used to locate frames by page number
+    pageCache->pageTable = createPageTable(numPages);
+
     return pageCache;
 }
 
@@ -357,7 +854,8 @@ void freeFrame(PageCache* pageCache) {
                 continue;
             }
             // release the resources assigned to store the content of the page
-        
+            pthread_rwlock_destroy(&frame->latch);
+            free(frame->data);
             free(frame);
 
             pageCache->arr[i] = NULL;
@@ -375,17 +873,18 @@ void freeFileHandle(PageCache* pageCache) {
     }
 }
 
-// release map resources assigned to frames created by LRU strategy
-void freeHash(PageCache* pageCache) {
-    if(pageCache->hash) {
-        free(pageCache->hash);
-    }
-}
 void freePageCache(PageCache* pageCache) {
     if(pageCache != NULL) {
         freeFileHandle(pageCache);
         freeFrame(pageCache);
-        freeHash(pageCache);
+        freePageTable(pageCache);
+        if(pageCache->policy != NULL && pageCache->policy->destroy != NULL) {
+            pageCache->policy->destroy(pageCache);
+        }
+        free(pageCache->candidates);
+        pthread_cond_destroy(&pageCache->flusherCond);
+        pthread_mutex_destroy(&pageCache->latch);
+        pthread_rwlock_destroy(&pageCache->ioLatch);
         free(pageCache);
     }
 }
@@ -403,276 +902,1410 @@ int isEmpty(PageCache* pageCache)
     return (pageCache->frameCnt == 0);
 }
 
-// check whether the required pageNum hits the cache
-Frame* isHitPageCache(PageCache* pageCache, const PageNumber pageNum) {
-    // iterate all frames stored in this page cache
-    int i;
-    for(int i = 0; i < pageCache->capacity; i++) {
-        Frame* frame = pageCache->arr[i];
-        if(frame->pageNum == pageNum) {
-            return frame;
-        }
+// move a frame to the most recently used end of the LRU list
+RC updateLRUOrder(PageCache* pageCache, Frame* frame) 
+{
+    removeFrameFromLRUList(pageCache, frame);
+    addFrameToLRUList(pageCache, frame);
+    return RC_OK;
+} 
+
+// append a frame to the frame list between head and tail
+static void appendFrameToList(PageCache* pageCache, int* head, int* tail, Frame* frame)
+{
+    frame->prev = *tail;
+    frame->next = -1;
+    if(*tail == -1) {
+        *head = frame->frameIndex;
+    } else {
+        pageCache->arr[*tail]->next = frame->frameIndex;
     }
-    // the page cache didn't contain the current page number data, return NULL
-    return NULL; 
+    *tail = frame->frameIndex;
 }
 
-RC updateLRUOrder(PageCache* pageCache, int pageNum) 
+// unlink a frame from the frame list between head and tail
+static void unlinkFrameFromList(PageCache* pageCache, int* head, int* tail, Frame* frame)
 {
-    int* hash = pageCache->hash;
-    // update hash
-    int index = -1;
-    int i;
-    for(i = 0; i < pageCache->capacity; i++) {
-        if(hash[i] == pageNum) {
-            index = i;
-            break;
-        }
-    }
-    if(index == -1) {
-        return RC_ERROR;
+    if(frame->prev == -1) {
+        *head = frame->next;
+    } else {
+        pageCache->arr[frame->prev]->next = frame->next;
     }
-    int updatePageNum = hash[index];
-    for(i = index; i < pageCache->capacity - 1; i++) {
-        hash[i] = hash[i + 1];
+    if(frame->next == -1) {
+        *tail = frame->prev;
+    } else {
+        pageCache->arr[frame->next]->prev = frame->prev;
     }
-    hash[pageCache->capacity - 1] = updatePageNum;
-    return RC_OK;
-} 
+    frame->prev = -1;
+    frame->next = -1;
+}
 
-// add a new frame to pageCache
-RC addPageToPageCacheWithFIFO(BM_BufferPool *const bm, BM_PageHandle *const page, int pageNum) 
-{    
-    // get current page cache
-    PageCache* pageCache = bm->mgmtData;
+// append a frame as the most recently used one
+void addFrameToLRUList(PageCache* pageCache, Frame* frame)
+{
+    appendFrameToList(pageCache, &pageCache->lruHead, &pageCache->lruTail, frame);
+}
 
-    // The following process is to add this new page to page cache
+// unlink a frame from the LRU list
+void removeFrameFromLRUList(PageCache* pageCache, Frame* frame)
+{
+    unlinkFrameFromList(pageCache, &pageCache->lruHead, &pageCache->lruTail, frame);
+}
 
-    // if current page cache is full
-    if (isFull(pageCache)) {
-        removePageWithFIFO(bm, page);
-    } 
-    // get the frame to store this page content
-    pageCache->rear = (pageCache->rear + 1) % pageCache->capacity;
+// take a frame that stores no page, return NULL if every frame is used
+Frame* getFreeFrame(PageCache* pageCache)
+{
+    if(pageCache->freeHead == -1) {
+        return NULL;
+    }
+    Frame* frame = pageCache->arr[pageCache->freeHead];
+    pageCache->freeHead = frame->next;
+    frame->next = -1;
+    return frame;
+}
 
-    Frame* frame = pageCache->arr[pageCache->rear];
+// give back a frame that stores no page
+void putFreeFrame(PageCache* pageCache, Frame* frame)
+{
+    frame->prev = -1;
+    frame->next = pageCache->freeHead;
+    pageCache->freeHead = frame->frameIndex;
+}
+
+// find the first unpinned frame of a frame list, NULL if there is none
+static Frame* findUnpinnedFrame(PageCache* pageCache, int index)
+{
+    while(index != -1 && pageCache->arr[index]->pinCount > 0) {
+        index = pageCache->arr[index]->next;
+    }
+    return (index == -1) ? NULL : pageCache->arr[index];
+}
+
+// append the unpinned frames of a frame list to victims until it holds max
+// frames, return the new number of frames in victims
+static int collectUnpinnedFrames(PageCache* pageCache, int index, Frame** victims, int num, int max)
+{
+    while(index != -1 && num < max) {
+        if(pageCache->arr[index]->pinCount == 0) {
+            victims[num++] = pageCache->arr[index];
+        }
+        index = pageCache->arr[index]->next;
+    }
+    return num;
+}
+
+// get up to max frames in the order the replacement policy would evict them.
+// A policy without nextVictims gives the unpinned frames in frame order.
+int collectNextVictims(PageCache* pageCache, Frame** victims, int max)
+{
+    if(pageCache->policy->nextVictims != NULL) {
+        return pageCache->policy->nextVictims(pageCache, victims, max);
+    }
+    int num = 0;
+    for(int i = 0; i < pageCache->capacity && num < max; i++) {
+        Frame* frame = pageCache->arr[i];
+        if(frame->pageNum != NO_PAGE && frame->pinCount == 0) {
+            victims[num++] = frame;
+        }
+    }
+    return num;
+}
+
+// Pin a page that is in the page cache, return FALSE if it is not. A page that
+// is being read is waited for, and only the stripe of its page table is latched
+// to find it. The latch of the page cache is taken for the policy on a hit,
+// unless the policy does not track hits.
+bool pinCachedPage(PageCache* pageCache, BM_PageHandle *const page, const PageNumber pageNum)
+{
+    PageTable* stripe = getPageTableStripe(pageCache, pageNum);
+
+    while(1) {
+        pthread_mutex_lock(&stripe->latch);
+        Frame* frame = lookupPageTable(pageCache, pageNum);
+        if(frame == NULL) {
+            pthread_mutex_unlock(&stripe->latch);
+            return FALSE;
+        }
+
+        // wait until the page is in the frame, the frame may be given up again
+        // if the read fails, so look the page up once more
+        if(frame->loading) {
+            pthread_cond_wait(&stripe->loaded, &stripe->latch);
+            pthread_mutex_unlock(&stripe->latch);
+            continue;
+        }
+
+        frame->pinCount++;
+        frame->refBit = 1;
+        pthread_mutex_unlock(&stripe->latch);
+
+        page->pageNum = pageNum;
+        page->data = frame->data;
+
+        if(pageCache->policy->onHit != NULL) {
+            pthread_mutex_lock(&pageCache->latch);
+            pageCache->policy->onHit(pageCache, frame);
+            pthread_mutex_unlock(&pageCache->latch);
+        }
+        return TRUE;
+    }
+}
+
+// latch two stripes of the page table, always in the same order
+static void lockPageTableStripes(PageTable* a, PageTable* b)
+{
+    if(a > b) {
+        PageTable* t = a;
+        a = b;
+        b = t;
+    }
+    pthread_mutex_lock(&a->latch);
+    if(a != b) {
+        pthread_mutex_lock(&b->latch);
+    }
+}
+
+static void unlockPageTableStripes(PageTable* a, PageTable* b)
+{
+    pthread_mutex_unlock(&a->latch);
+    if(a != b) {
+        pthread_mutex_unlock(&b->latch);
+    }
+}
+
+// Read a page into the page cache: take a free frame, otherwise evict the page
+// chosen by the replacement policy, then let the policy track the new page.
+// The latch of the page cache is only held while a frame is picked: a dirty
+// victim is pinned and written back after it is released, and the page is 
+// read after the frame has been given to it.
+RC addPageToPageCache(BM_BufferPool *const bm, BM_PageHandle *const page, 
+		const PageNumber pageNum)
+{
+    // get current page cache
+    PageCache* pageCache = bm->mgmtData;
 
-    // copy the file content from disk to memory
     SM_FileHandle *fHandle = pageCache->fHandle;
-    
-    if(ensureCapacity(pageNum + 1, fHandle) != RC_OK) {
-        return RC_READ_NON_EXISTING_PAGE;
+
+    // ensure the file page exists, only growing the file latches it exclusive
+    RC rc = RC_OK;
+    pthread_rwlock_rdlock(&pageCache->ioLatch);
+    bool exists = pageNum < fHandle->totalNumPages;
+    pthread_rwlock_unlock(&pageCache->ioLatch);
+    if(!exists) {
+        pthread_rwlock_wrlock(&pageCache->ioLatch);
+        rc = ensureCapacity(pageNum + 1, fHandle);
+        pthread_rwlock_unlock(&pageCache->ioLatch);
     }
-   
-    if(readBlock(pageNum, fHandle, frame->data) != RC_OK) {
-        return RC_ERROR;
+    if(rc != RC_OK) {
+        return RC_READ_NON_EXISTING_PAGE;
     }
 
-    pageCache->numRead++;
+    PageTable* stripe = getPageTableStripe(pageCache, pageNum);
+
+    // the victim this call has written back, pinned until it is evicted
+    Frame* cleaned = NULL;
+    Frame* frame;
+    while(1) {
+        pthread_mutex_lock(&pageCache->latch);
+
+        // use a free frame first, otherwise evict a page
+        frame = cleaned;
+        if(frame == NULL) {
+            frame = getFreeFrame(pageCache);
+        }
+        if(frame == NULL && !isEmpty(pageCache)) {
+            frame = pageCache->policy->chooseVictim(pageCache);
+        }
+
+        // every page is pinned
+        if(frame == NULL) {
+            pthread_mutex_unlock(&pageCache->latch);
+            return RC_ERROR;
+        }
+
+        // pins and removals of the victim page latch its stripe
+        PageTable* victimStripe = (frame->pageNum == NO_PAGE) ? stripe : getPageTableStripe(pageCache, frame->pageNum);
+        lockPageTableStripes(stripe, victimStripe);
+
+        // another thread has read the page meanwhile, pin it instead
+        if(lookupPageTable(pageCache, pageNum) != NULL) {
+            if(frame->pageNum == NO_PAGE) {
+                putFreeFrame(pageCache, frame);
+            }
+            if(cleaned != NULL) {
+                cleaned->pinCount--;
+                cleaned = NULL;
+            }
+            unlockPageTableStripes(stripe, victimStripe);
+            pthread_mutex_unlock(&pageCache->latch);
+            if(pinCachedPage(pageCache, page, pageNum)) {
+                return RC_OK;
+            }
+            continue;
+        }
+
+        // a free frame, only the stripe of the page stays latched
+        if(frame->pageNum == NO_PAGE) {
+            break;
+        }
+
+        // the victim has been pinned since it was chosen, choose again
+        if(frame->pinCount != ((frame == cleaned) ? 1 : 0)) {
+            if(cleaned != NULL) {
+                cleaned->pinCount--;
+                cleaned = NULL;
+            }
+            unlockPageTableStripes(stripe, victimStripe);
+            pthread_mutex_unlock(&pageCache->latch);
+            continue;
+        }
+
+        // write the dirty victim back before its frame is reused, without
+        // holding the latches, the pin keeps the page in the frame
+        if(frame->dirtyBit == 1) {
+            if(cleaned == NULL) {
+                frame->pinCount++;
+                cleaned = frame;
+            }
+            unlockPageTableStripes(stripe, victimStripe);
+            pthread_mutex_unlock(&pageCache->latch);
+            if(writeFrame(pageCache, frame) != RC_OK) {
+                frame->pinCount--;
+                return RC_WRITE_FAILED;
+            }
+            continue;
+        }
 
-    // update this frame information page
+        if(frame != cleaned) {
+            pageCache->numCleanEvictions++;
+        }
+        pageCache->numEvictions++;
+        evictPage(pageCache, frame);
+        if(victimStripe != stripe) {
+            pthread_mutex_unlock(&victimStripe->latch);
+        }
+        break;
+    }
+
+    // give the frame to the page, other pins of the page wait until it has been read
+    frame->loading = 1;
     frame->pageNum = pageNum;
     frame->pinCount = 1;
     frame->dirtyBit = 0;
+    insertPageTable(pageCache, frame);
+    pageCache->frameCnt = pageCache->frameCnt + 1;
+    pageCache->policy->onInsert(pageCache, frame);
+    pthread_mutex_unlock(&stripe->latch);
+    pthread_mutex_unlock(&pageCache->latch);
+
+    // copy the file content from disk to memory
+    pthread_rwlock_rdlock(&pageCache->ioLatch);
+    rc = readBlock(pageNum, fHandle, frame->data);
+    if(rc == RC_OK) {
+        pageCache->numRead++;
+    }
+    pthread_rwlock_unlock(&pageCache->ioLatch);
+
+    // give the frame back, the waiting pins will try to read the page
+    // themselves. The error of the read is passed on, a page that does not
+    // match its checksum is reported as such.
+    if(rc != RC_OK) {
+        pthread_mutex_lock(&pageCache->latch);
+        pthread_mutex_lock(&stripe->latch);
+        evictPage(pageCache, frame);
+        putFreeFrame(pageCache, frame);
+        frame->loading = 0;
+        pthread_cond_broadcast(&stripe->loaded);
+        pthread_mutex_unlock(&stripe->latch);
+        pthread_mutex_unlock(&pageCache->latch);
+        return rc;
+    }
+
+    pthread_mutex_lock(&stripe->latch);
+    frame->loading = 0;
+    pthread_cond_broadcast(&stripe->loaded);
+    pthread_mutex_unlock(&stripe->latch);
 
     // store page number info to page
     page->pageNum = pageNum;
     page->data = frame->data;
-   
-    // store this page in the cache
-    // pageCache->arr[pageCache->rear] = frame;
-    pageCache->frameCnt = pageCache->frameCnt + 1;
 
     return RC_OK;
 }
 
-// add new page to page cache based on LRU strategy
-RC addPageToPageCacheWithLRU(BM_BufferPool *const bm, BM_PageHandle *const page, 
-		const PageNumber pageNum)
+// Remove the page of an unpinned and clean frame from the page cache, the
+// frame can store a new page afterwards. The caller holds the latch of the 
+// page cache and the latch of the stripe the page is mapped in.
+void evictPage(PageCache* pageCache, Frame* frame)
 {
-    // get current page cache
-    PageCache* pageCache = bm->mgmtData;
+    // remove this page
+    if(pageCache->policy->onEvict != NULL) {
+        pageCache->policy->onEvict(pageCache, frame);
+    }
+    removePageTable(pageCache, frame);
+    resetFrameNode(frame);
 
-    int* hash = pageCache->hash;
-
-    int frameIndex = -1;
- 
-    Frame* frame = NULL;
-    // mark whether the current pageCache is full
-    int fullFlag = 0;
-    if(isFull(pageCache)) {
-        int leastUsedPageNum = hash[0]; 
-        frame = removePageWithLRU(bm, page, leastUsedPageNum);
-        fullFlag = 1;
-        // frame = pageCache->arr[leastUsedPageNum];
-    } else {
-        for(int i = 0; i < bm->numPages; i++) {
-            if(hash[i] == -1) {
-                frameIndex = i;
-                break;
-            }
+    pageCache->frameCnt = pageCache->frameCnt - 1;
+}
+
+// LRU hooks, FIFO uses them as well but keeps the frames in the order their
+// pages were read. A hit makes the page the most recently used one.
+static RC onHitLRU(PageCache* pageCache, Frame* frame)
+{
+    return updateLRUOrder(pageCache, frame);
+}
+
+// a new page is the most recently used one
+static void onInsertLRU(PageCache* pageCache, Frame* frame)
+{
+    addFrameToLRUList(pageCache, frame);
+}
+
+// the least recently used page which is not pinned
+static Frame* chooseVictimLRU(PageCache* pageCache)
+{
+    return findUnpinnedFrame(pageCache, pageCache->lruHead);
+}
+
+static void onEvictLRU(PageCache* pageCache, Frame* frame)
+{
+    removeFrameFromLRUList(pageCache, frame);
+}
+
+static int nextVictimsLRU(PageCache* pageCache, Frame** victims, int max)
+{
+    return collectUnpinnedFrames(pageCache, pageCache->lruHead, victims, 0, max);
+}
+
+// CLOCK hooks. A new page gets its second chance. A hit sets the reference 
+// bit in pinCachedPage, so CLOCK needs no hook and no latch on hits.
+static void onInsertCLOCK(PageCache* pageCache, Frame* frame)
+{
+    (void) pageCache;
+    frame->refBit = 1;
+}
+
+// Sweep the clock hand over the frames: a referenced page loses its reference
+// bit and survives, the first unpinned page without it is the victim.
+static Frame* chooseVictimCLOCK(PageCache* pageCache)
+{
+    // two full rounds clear every reference bit, so after that every frame is pinned
+    int i;
+    for(i = 0; i < 2 * pageCache->capacity; i++) {
+        Frame* candidate = pageCache->arr[pageCache->clockHand];
+        pageCache->clockHand = (pageCache->clockHand + 1) % pageCache->capacity;
+
+        if(candidate->pageNum == NO_PAGE || candidate->pinCount > 0) {
+            continue;
         }
-        if(frameIndex == -1) {
-            return RC_ERROR;
+        if(candidate->refBit == 1) {
+            candidate->refBit = 0;
+            continue;
         }
-        frame = pageCache->arr[frameIndex];
+        return candidate;
     }
+    return NULL;
+}
 
-    if(frame == NULL) {
-        return RC_ERROR;
+// the hand takes the unpinned frames without reference bit in its first
+// round, and the other unpinned frames in its second round
+static int nextVictimsCLOCK(PageCache* pageCache, Frame** victims, int max)
+{
+    int num = 0;
+    for(int refBit = 0; refBit <= 1; refBit++) {
+        for(int i = 0; i < pageCache->capacity && num < max; i++) {
+            Frame* frame = pageCache->arr[(pageCache->clockHand + i) % pageCache->capacity];
+            if(frame->pageNum != NO_PAGE && frame->pinCount == 0 && frame->refBit == refBit) {
+                victims[num++] = frame;
+            }
+        }
     }
-       
-    // copy the page content
-    SM_FileHandle *fHandle = pageCache->fHandle;
-    
-    // ensure the file page exists
-    if(ensureCapacity(pageNum + 1, fHandle) != RC_OK) {
-        return RC_READ_NON_EXISTING_PAGE;
+    return num;
+}
+
+// take an unused bucket with the given frequency and link it after the bucket prev,
+// or make it the lowest bucket if prev is -1
+static int createFreqBucket(PageCache* pageCache, int freq, int prev)
+{
+    FreqBucket* buckets = pageCache->buckets;
+    int b = pageCache->freeBucket;
+    pageCache->freeBucket = buckets[b].next;
+
+    buckets[b].freq = freq;
+    buckets[b].head = -1;
+    buckets[b].tail = -1;
+    buckets[b].prev = prev;
+    if(prev == -1) {
+        buckets[b].next = pageCache->minBucket;
+        pageCache->minBucket = b;
+    } else {
+        buckets[b].next = buckets[prev].next;
+        buckets[prev].next = b;
+    }
+    if(buckets[b].next != -1) {
+        buckets[buckets[b].next].prev = b;
     }
+    return b;
+}
 
-    // copy the file content from disk to memory
-    if(readBlock(pageNum, fHandle, frame->data) != RC_OK) {
+// unlink an empty bucket and give it back to the unused buckets
+static void freeFreqBucket(PageCache* pageCache, int b)
+{
+    FreqBucket* buckets = pageCache->buckets;
+    if(buckets[b].prev == -1) {
+        pageCache->minBucket = buckets[b].next;
+    } else {
+        buckets[buckets[b].prev].next = buckets[b].next;
+    }
+    if(buckets[b].next != -1) {
+        buckets[buckets[b].next].prev = buckets[b].prev;
+    }
+    buckets[b].next = pageCache->freeBucket;
+    pageCache->freeBucket = b;
+}
+
+// append a frame as the newest frame of bucket b
+static void addFrameToFreqBucket(PageCache* pageCache, Frame* frame, int b)
+{
+    FreqBucket* bucket = &pageCache->buckets[b];
+    frame->bucket = b;
+    frame->prev = bucket->tail;
+    frame->next = -1;
+    if(bucket->tail == -1) {
+        bucket->head = frame->frameIndex;
+    } else {
+        pageCache->arr[bucket->tail]->next = frame->frameIndex;
+    }
+    bucket->tail = frame->frameIndex;
+}
+
+// unlink a frame from its bucket, the bucket is released when it becomes empty
+static void removeFrameFromFreqBucket(PageCache* pageCache, Frame* frame)
+{
+    FreqBucket* bucket = &pageCache->buckets[frame->bucket];
+    if(frame->prev == -1) {
+        bucket->head = frame->next;
+    } else {
+        pageCache->arr[frame->prev]->next = frame->next;
+    }
+    if(frame->next == -1) {
+        bucket->tail = frame->prev;
+    } else {
+        pageCache->arr[frame->next]->prev = frame->prev;
+    }
+    if(bucket->head == -1) {
+        freeFreqBucket(pageCache, frame->bucket);
+    }
+    frame->bucket = -1;
+    frame->prev = -1;
+    frame->next = -1;
+}
+
+// count one more reference of the page in this frame by moving the frame to 
+// the bucket of the next frequency
+RC updateLFUFrequency(PageCache* pageCache, Frame* frame)
+{
+    if(frame->bucket == -1) {
         return RC_ERROR;
     }
+    FreqBucket* buckets = pageCache->buckets;
+    int b = frame->bucket;
+    int freq = buckets[b].freq + 1;
+
+    // find or create the bucket of the next frequency before b may be released
+    int nb = buckets[b].next;
+    if(nb == -1 || buckets[nb].freq != freq) {
+        nb = createFreqBucket(pageCache, freq, b);
+    }
+    removeFrameFromFreqBucket(pageCache, frame);
+    addFrameToFreqBucket(pageCache, frame, nb);
 
-    // print frame page
-    // printf("current fram index = %d\n", frameIndex);
+    // periodically decay the frequencies so that old hot pages can leave
+    pageCache->refCnt++;
+    if(pageCache->agingPeriod > 0 && pageCache->refCnt >= pageCache->agingPeriod) {
+        ageLFUFrequencies(pageCache);
+    }
+    return RC_OK;
+}
 
-    pageCache->numRead++;
+// Halve the frequency of every bucket. Halving keeps the order of the buckets,
+// so buckets that end up with the same frequency are neighbours and merged.
+void ageLFUFrequencies(PageCache* pageCache)
+{
+    FreqBucket* buckets = pageCache->buckets;
+    int b = pageCache->minBucket;
+    while(b != -1) {
+        int next = buckets[b].next;
+        int prev = buckets[b].prev;
+        buckets[b].freq = (buckets[b].freq > 1) ? buckets[b].freq / 2 : 1;
+
+        // move the frames to the lower bucket, they become its newest frames
+        if(prev != -1 && buckets[prev].freq == buckets[b].freq) {
+            int index = buckets[b].head;
+            while(index != -1) {
+                pageCache->arr[index]->bucket = prev;
+                index = pageCache->arr[index]->next;
+            }
+            pageCache->arr[buckets[prev].tail]->next = buckets[b].head;
+            pageCache->arr[buckets[b].head]->prev = buckets[prev].tail;
+            buckets[prev].tail = buckets[b].tail;
+            freeFreqBucket(pageCache, b);
+        }
+        b = next;
+    }
+    pageCache->refCnt = 0;
+}
 
-    // update this frame information page
-    frame->pageNum = pageNum;
-    frame->pinCount = 1;
-    frame->dirtyBit = 0;
+// Create the frequency buckets used by LFU, all of them are unused. One bucket
+// more than frames is needed while a frame moves to a new bucket. stratData
+// may point to the aging period.
+void createLFUBuckets(PageCache* pageCache, void *stratData)
+{
+    int numBuckets = pageCache->capacity + 1;
+    pageCache->buckets = (FreqBucket*) malloc(numBuckets * sizeof(FreqBucket));
+    for(int i = 0; i < numBuckets; i++) {
+        pageCache->buckets[i].next = (i + 1 < numBuckets) ? i + 1 : -1;
+    }
+    pageCache->freeBucket = 0;
+    pageCache->minBucket = -1;
 
-    // store page number info to page
-    page->pageNum = pageNum;
-    page->data = frame->data;
+    if(stratData != NULL) {
+        pageCache->agingPeriod = *((int *) stratData);
+    }
+}
 
-    pageCache->frameCnt = pageCache->frameCnt + 1;
+// release the resources assigned to LFU
+void freeLFUBuckets(PageCache* pageCache)
+{
+    if(pageCache->buckets) {
+        free(pageCache->buckets);
+        pageCache->buckets = NULL;
+    }
+}
+
+// LFU hooks. A new page has been referenced once.
+static void onInsertLFU(PageCache* pageCache, Frame* frame)
+{
+    int b = pageCache->minBucket;
+    if(b == -1 || pageCache->buckets[b].freq != 1) {
+        b = createFreqBucket(pageCache, 1, -1);
+    }
+    addFrameToFreqBucket(pageCache, frame, b);
+}
 
-    // store this page in the cache
-    if(fullFlag == 1) {
-        // pageCache->arr[hash[0]] = frame;
-        for(int i = 0; i < pageCache->capacity - 1; i++) {
-            hash[i] = hash[i+1];
+// The least frequently used page which is not pinned. Pages with the same 
+// frequency are chosen in the order they reached it.
+static Frame* chooseVictimLFU(PageCache* pageCache)
+{
+    // walk the buckets from the lowest frequency, skipping the pinned frames
+    int b = pageCache->minBucket;
+    while(b != -1) {
+        Frame* frame = findUnpinnedFrame(pageCache, pageCache->buckets[b].head);
+        if(frame != NULL) {
+            return frame;
         }
-        hash[pageCache->capacity - 1] = pageNum;
-    } else {
-        // pageCache->arr[frameIndex] = frame;
-        hash[frameIndex] = pageNum;
+        b = pageCache->buckets[b].next;
     }
+    return NULL;
+}
 
-    return RC_OK;
+static void onEvictLFU(PageCache* pageCache, Frame* frame)
+{
+    removeFrameFromFreqBucket(pageCache, frame);
 }
 
-// Remove a frame from queue based on FIFO. It changes front and frameCnt
-RC removePageWithFIFO(BM_BufferPool *const bm, BM_PageHandle *const page)
+static int nextVictimsLFU(PageCache* pageCache, Frame** victims, int max)
 {
-    PageCache* pageCache = bm->mgmtData;
-    // check whether this page cache is empty
-    if (isEmpty(pageCache))
-        return RC_ERROR;
+    int num = 0;
+    int b = pageCache->minBucket;
+    while(b != -1 && num < max) {
+        num = collectUnpinnedFrames(pageCache, pageCache->buckets[b].head, victims, num, max);
+        b = pageCache->buckets[b].next;
+    }
+    return num;
+}
 
-    // check whether there exisit frame with pinCount = 0
-    int cnt = 0;
-    Frame** arr = pageCache->arr;
-    for(int i = 0; i < pageCache->capacity; i++) {
-        if(arr[i]->pinCount == 0) {
-            cnt++;
+// create the reference histories, the victim heap and the correlated list 
+// used by LRU-K. The histories of as many evicted pages as there are frames
+// are retained.
+void createLRUKHistories(PageCache* pageCache, void *stratData)
+{
+    LRUKParams* params = (LRUKParams*) stratData;
+    pageCache->k = (params != NULL && params->k > 0) ? params->k : 2;
+    pageCache->correlatedPeriod = (params != NULL && params->correlatedPeriod > 0) ? params->correlatedPeriod : 0;
+    pageCache->timestamp = 0;
+
+    // every history starts in the free list
+    int numHistories = 2 * pageCache->capacity;
+    pageCache->histories = (PageHistory*) malloc(numHistories * sizeof(PageHistory));
+    for(int i = 0; i < numHistories; i++) {
+        pageCache->histories[i].hist = (long*) calloc(pageCache->k, sizeof(long));
+        pageCache->histories[i].next = (i + 1 < numHistories) ? i + 1 : -1;
+    }
+    pageCache->freeHistory = 0;
+    pageCache->historyMap = createPageMap(numHistories);
+
+    pageCache->retainedHead = -1;
+    pageCache->retainedTail = -1;
+    pageCache->retainedCnt = 0;
+    pageCache->maxRetained = pageCache->capacity;
+
+    pageCache->heap = (int*) malloc(pageCache->capacity * sizeof(int));
+    pageCache->heapSize = 0;
+    pageCache->heapSearch = (int*) malloc(pageCache->capacity * sizeof(int));
+    pageCache->correlatedHead = -1;
+    pageCache->correlatedTail = -1;
+}
+
+// release the resources assigned to LRU-K
+void freeLRUKHistories(PageCache* pageCache)
+{
+    if(pageCache->histories) {
+        for(int i = 0; i < 2 * pageCache->capacity; i++) {
+            free(pageCache->histories[i].hist);
         }
+        free(pageCache->histories);
+        pageCache->histories = NULL;
     }
-    if(cnt == 0) {
-        return RC_ERROR;
+    if(pageCache->historyMap) {
+        freePageMap(pageCache->historyMap);
+        pageCache->historyMap = NULL;
     }
-    
-    // get the first frame in the page cache
-    Frame* frame = pageCache->arr[pageCache->front];
+    if(pageCache->heap) {
+        free(pageCache->heap);
+        pageCache->heap = NULL;
+    }
+    if(pageCache->heapSearch) {
+        free(pageCache->heapSearch);
+        pageCache->heapSearch = NULL;
+    }
+}
+
+// Record a reference to the page at the next tick. A reference within the
+// correlated reference period of the previous one only moves its last time.
+// Otherwise the history shifts, discounting the correlated period of the
+// previous reference. Returns 1 if the history changed.
+static int recordLRUKReference(PageCache* pageCache, PageHistory* history)
+{
+    long now = ++pageCache->timestamp;
+    long* hist = history->hist;
+
+    if(history->last != 0 && now - history->last <= pageCache->correlatedPeriod) {
+        history->last = now;
+        return 0;
+    }
+
+    long correlated = (history->last != 0) ? history->last - hist[0] : 0;
+    for(int i = pageCache->k - 1; i > 0; i--) {
+        hist[i] = (hist[i - 1] != 0) ? hist[i - 1] + correlated : 0;
+    }
+    hist[0] = now;
+    history->last = now;
+    return 1;
+}
+
+// check whether frame a comes before frame b in the LRU-K heap: the frame whose
+// K-th most recent reference is older has the larger backward K-distance. Pages
+// with less than K references have an infinite distance, and the most recent
+// reference breaks ties.
+static int lessLRUK(PageCache* pageCache, int a, int b)
+{
+    long* ha = pageCache->histories[pageCache->arr[a]->history].hist;
+    long* hb = pageCache->histories[pageCache->arr[b]->history].hist;
+    int k = pageCache->k;
+    if(ha[k - 1] != hb[k - 1]) {
+        return ha[k - 1] < hb[k - 1];
+    }
+    return ha[0] < hb[0];
+}
 
-    // fix test case :201
-    if(frame->pinCount > 0) {
-        while(pageCache->arr[pageCache->front]->pinCount > 0) {
-            pageCache->front = (pageCache->front + 1) % pageCache->capacity;
+// swap two entries of the LRU-K heap
+static void swapLRUKHeap(PageCache* pageCache, int i, int j)
+{
+    int* heap = pageCache->heap;
+    int tmp = heap[i];
+    heap[i] = heap[j];
+    heap[j] = tmp;
+    pageCache->arr[heap[i]]->heapPos = i;
+    pageCache->arr[heap[j]]->heapPos = j;
+}
+
+// move a heap entry up while it comes before its parent
+static void siftUpLRUK(PageCache* pageCache, int i)
+{
+    while(i > 0 && lessLRUK(pageCache, pageCache->heap[i], pageCache->heap[(i - 1) / 2])) {
+        swapLRUKHeap(pageCache, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+// move a heap entry down while one of its children comes before it
+static void siftDownLRUK(PageCache* pageCache, int i)
+{
+    while(1) {
+        int first = i;
+        int left = 2 * i + 1;
+        int right = 2 * i + 2;
+        if(left < pageCache->heapSize && lessLRUK(pageCache, pageCache->heap[left], pageCache->heap[first])) {
+            first = left;
+        }
+        if(right < pageCache->heapSize && lessLRUK(pageCache, pageCache->heap[right], pageCache->heap[first])) {
+            first = right;
         }
-        frame = pageCache->arr[pageCache->front];
+        if(first == i) {
+            break;
+        }
+        swapLRUKHeap(pageCache, i, first);
+        i = first;
+    }
+}
 
-        // set the tail to the current frame
-        pageCache->rear = pageCache->front - 1;
-    } 
-    if(frame->pinCount == 0 && frame->dirtyBit == 1) {
-        forcePage(bm, page);
-        pageCache->numWrite++;
+// add a frame to the LRU-K heap
+static void pushLRUKHeap(PageCache* pageCache, Frame* frame)
+{
+    int i = pageCache->heapSize++;
+    pageCache->heap[i] = frame->frameIndex;
+    frame->heapPos = i;
+    siftUpLRUK(pageCache, i);
+}
+
+// take a frame out of the LRU-K heap wherever it is
+static void removeLRUKHeap(PageCache* pageCache, Frame* frame)
+{
+    int i = frame->heapPos;
+    swapLRUKHeap(pageCache, i, --pageCache->heapSize);
+    // the frame moved into its place may belong above or below it
+    if(i < pageCache->heapSize) {
+        int moved = pageCache->heap[i];
+        siftUpLRUK(pageCache, i);
+        siftDownLRUK(pageCache, pageCache->arr[moved]->heapPos);
     }
-    // remove the first frame
-    pageCache->front = (pageCache->front + 1) % pageCache->capacity;
+    frame->heapPos = -1;
+}
 
-    // update the number of used frame in page cache
-    pageCache->frameCnt = pageCache->frameCnt - 1;
+// Move the frames whose last reference is older than the correlated period
+// from the correlated list into the heap. The list is in the order of the 
+// last references, so only its head needs to be looked at.
+static void releaseCorrelatedLRUK(PageCache* pageCache, long now)
+{
+    while(pageCache->correlatedHead != -1) {
+        Frame* frame = pageCache->arr[pageCache->correlatedHead];
+        if(now - pageCache->histories[frame->history].last <= pageCache->correlatedPeriod) {
+            break;
+        }
+        unlinkFrameFromList(pageCache, &pageCache->correlatedHead, &pageCache->correlatedTail, frame);
+        pushLRUKHeap(pageCache, frame);
+    }
+}
 
-    // reset this frame node
-    resetFrameNode(frame);
+// Find the unpinned frame of the heap with the largest backward K-distance 
+// without changing the heap. The positions to look at are kept in heapSearch,
+// ordered like the heap, and the children of a pinned frame join them. This
+// costs O(p log p) for p pinned frames before the victim.
+static Frame* searchLRUKHeap(PageCache* pageCache)
+{
+    int* search = pageCache->heapSearch;
+    int* heap = pageCache->heap;
+    int num = 0;
+    if(pageCache->heapSize > 0) {
+        search[num++] = 0;
+    }
+    while(num > 0) {
+        // take the first position and restore the order of the rest
+        int pos = search[0];
+        search[0] = search[--num];
+        for(int i = 0; ; ) {
+            int first = i;
+            int left = 2 * i + 1;
+            int right = 2 * i + 2;
+            if(left < num && lessLRUK(pageCache, heap[search[left]], heap[search[first]])) {
+                first = left;
+            }
+            if(right < num && lessLRUK(pageCache, heap[search[right]], heap[search[first]])) {
+                first = right;
+            }
+            if(first == i) {
+                break;
+            }
+            int tmp = search[i];
+            search[i] = search[first];
+            search[first] = tmp;
+            i = first;
+        }
 
-    return RC_OK;
+        Frame* frame = pageCache->arr[heap[pos]];
+        if(frame->pinCount == 0) {
+            return frame;
+        }
+        for(int child = 2 * pos + 1; child <= 2 * pos + 2 && child < pageCache->heapSize; child++) {
+            int i = num++;
+            search[i] = child;
+            while(i > 0 && lessLRUK(pageCache, heap[search[i]], heap[search[(i - 1) / 2]])) {
+                int tmp = search[i];
+                search[i] = search[(i - 1) / 2];
+                search[(i - 1) / 2] = tmp;
+                i = (i - 1) / 2;
+            }
+        }
+    }
+    return NULL;
 }
 
-Frame* removePageWithLRU(BM_BufferPool *const bm, BM_PageHandle *const page, int leastUsedPage)
+// keep the history of an evicted page, dropping the oldest retained history
+// once more than maxRetained are kept
+static void retainLRUKHistory(PageCache* pageCache, int index)
 {
-    PageCache* pageCache = bm->mgmtData;
-    // check whether this page cache is empty
-    if (isEmpty(pageCache))
-        return NULL;
+    PageHistory* histories = pageCache->histories;
+    histories[index].prev = pageCache->retainedTail;
+    histories[index].next = -1;
+    if(pageCache->retainedTail == -1) {
+        pageCache->retainedHead = index;
+    } else {
+        histories[pageCache->retainedTail].next = index;
+    }
+    pageCache->retainedTail = index;
+    pageCache->retainedCnt++;
+
+    if(pageCache->retainedCnt > pageCache->maxRetained) {
+        int oldest = pageCache->retainedHead;
+        pageCache->retainedHead = histories[oldest].next;
+        histories[pageCache->retainedHead].prev = -1;
+        pageCache->retainedCnt--;
+
+        removePageMap(pageCache->historyMap, histories[oldest].pageNum);
+        histories[oldest].next = pageCache->freeHistory;
+        pageCache->freeHistory = oldest;
+    }
+}
 
-    // check whether there exisit frame with pinCount = 0
-    int cnt = 0;
-    Frame** arr = pageCache->arr;
-    for(int i = 0; i < pageCache->capacity; i++) {
-        if(arr[i]->pinCount == 0) {
-            cnt++;
+// take a retained history back for a page that is read again
+static void unretainLRUKHistory(PageCache* pageCache, int index)
+{
+    PageHistory* histories = pageCache->histories;
+    if(histories[index].prev == -1) {
+        pageCache->retainedHead = histories[index].next;
+    } else {
+        histories[histories[index].prev].next = histories[index].next;
+    }
+    if(histories[index].next == -1) {
+        pageCache->retainedTail = histories[index].prev;
+    } else {
+        histories[histories[index].next].prev = histories[index].prev;
+    }
+    pageCache->retainedCnt--;
+}
+
+// record a reference to a page that hits the pool and reorder the heap. With
+// a correlated period the page goes to the end of the correlated list instead.
+RC updateLRUKHistory(PageCache* pageCache, Frame* frame)
+{
+    if(frame->history == -1) {
+        return RC_ERROR;
+    }
+    int changed = recordLRUKReference(pageCache, &pageCache->histories[frame->history]);
+    if(pageCache->correlatedPeriod > 0) {
+        if(frame->heapPos == -1) {
+            unlinkFrameFromList(pageCache, &pageCache->correlatedHead, &pageCache->correlatedTail, frame);
+        } else {
+            removeLRUKHeap(pageCache, frame);
         }
+        appendFrameToList(pageCache, &pageCache->correlatedHead, &pageCache->correlatedTail, frame);
+    } else if(changed) {
+        // the history only moves forward, so the frame can only move down
+        siftDownLRUK(pageCache, frame->heapPos);
     }
-    if(cnt == 0) {
-        return NULL;
+    return RC_OK;
+}
+
+// LRU-K hooks. A new page continues its retained history or starts a new one.
+static void onInsertLRUK(PageCache* pageCache, Frame* frame)
+{
+    int index = lookupPageMap(pageCache->historyMap, frame->pageNum);
+    if(index != -1) {
+        unretainLRUKHistory(pageCache, index);
+    } else {
+        index = pageCache->freeHistory;
+        pageCache->freeHistory = pageCache->histories[index].next;
+
+        PageHistory* history = &pageCache->histories[index];
+        history->pageNum = frame->pageNum;
+        history->last = 0;
+        memset(history->hist, 0, pageCache->k * sizeof(long));
+        insertPageMap(pageCache->historyMap, frame->pageNum, index);
     }
-    
-    // get the least page in the page cache
-    Frame* frame = searchPageFromCache(pageCache, leastUsedPage);
+    frame->history = index;
+    recordLRUKReference(pageCache, &pageCache->histories[index]);
+    if(pageCache->correlatedPeriod > 0) {
+        appendFrameToList(pageCache, &pageCache->correlatedHead, &pageCache->correlatedTail, frame);
+    } else {
+        pushLRUKHeap(pageCache, frame);
+    }
+}
 
+// The unpinned page with the largest backward K-distance. Pages referenced 
+// within the correlated reference period wait in the correlated list and are
+// only chosen, the oldest reference first, when no other page can be removed.
+static Frame* chooseVictimLRUK(PageCache* pageCache)
+{
+    releaseCorrelatedLRUK(pageCache, pageCache->timestamp + 1);
+    Frame* frame = searchLRUKHeap(pageCache);
     if(frame == NULL) {
-        return NULL;
+        frame = findUnpinnedFrame(pageCache, pageCache->correlatedHead);
     }
- 
-    if(frame->pinCount == 0 && frame->dirtyBit == 1) {
-        forcePage(bm, page);
-        pageCache->numWrite++;
+    return frame;
+}
+
+// the page leaves the heap or the correlated list but its history is kept
+static void onEvictLRUK(PageCache* pageCache, Frame* frame)
+{
+    if(frame->heapPos == -1) {
+        unlinkFrameFromList(pageCache, &pageCache->correlatedHead, &pageCache->correlatedTail, frame);
+    } else {
+        removeLRUKHeap(pageCache, frame);
     }
+    retainLRUKHistory(pageCache, frame->history);
+    frame->history = -1;
+}
 
-    // remove the least page
-    resetFrameNode(frame);
+// the heap in array order, which only approximates the eviction order but
+// starts with the next victim and keeps parents before their children, then
+// the correlated list
+static int nextVictimsLRUK(PageCache* pageCache, Frame** victims, int max)
+{
+    int num = 0;
+    for(int i = 0; i < pageCache->heapSize && num < max; i++) {
+        Frame* frame = pageCache->arr[pageCache->heap[i]];
+        if(frame->pinCount == 0) {
+            victims[num++] = frame;
+        }
+    }
+    return collectUnpinnedFrames(pageCache, pageCache->correlatedHead, victims, num, max);
+}
 
-    pageCache->frameCnt = pageCache->frameCnt - 1;
-    
+// create the queues used by 2Q. By default A1in holds a quarter of the
+// frames and A1out remembers as many pages as half of the frames.
+void create2QQueues(PageCache* pageCache, void *stratData)
+{
+    TwoQParams* params = (TwoQParams*) stratData;
+    pageCache->maxA1in = (params != NULL && params->inSize > 0) ? params->inSize : pageCache->capacity / 4;
+    pageCache->maxA1out = (params != NULL && params->outSize > 0) ? params->outSize : pageCache->capacity / 2;
+    if(pageCache->maxA1in < 1) {
+        pageCache->maxA1in = 1;
+    }
+    if(pageCache->maxA1out < 1) {
+        pageCache->maxA1out = 1;
+    }
+
+    pageCache->a1inHead = -1;
+    pageCache->a1inTail = -1;
+    pageCache->a1inCnt = 0;
+
+    pageCache->a1out = (PageNumber*) malloc(pageCache->maxA1out * sizeof(PageNumber));
+    pageCache->a1outHead = 0;
+    pageCache->a1outCnt = 0;
+    pageCache->a1outMap = createPageMap(pageCache->maxA1out);
+}
+
+// release the resources assigned to 2Q
+void free2QQueues(PageCache* pageCache)
+{
+    if(pageCache->a1out) {
+        free(pageCache->a1out);
+        pageCache->a1out = NULL;
+    }
+    if(pageCache->a1outMap) {
+        freePageMap(pageCache->a1outMap);
+        pageCache->a1outMap = NULL;
+    }
+}
+
+// remember a page removed from A1in, forgetting the oldest one if A1out is full
+static void addPageToA1out(PageCache* pageCache, const PageNumber pageNum)
+{
+    if(pageCache->a1outCnt == pageCache->maxA1out) {
+        PageNumber oldest = pageCache->a1out[pageCache->a1outHead];
+        if(oldest != NO_PAGE) {
+            removePageMap(pageCache->a1outMap, oldest);
+        }
+        pageCache->a1outHead = (pageCache->a1outHead + 1) % pageCache->maxA1out;
+        pageCache->a1outCnt--;
+    }
+    int slot = (pageCache->a1outHead + pageCache->a1outCnt) % pageCache->maxA1out;
+    pageCache->a1out[slot] = pageNum;
+    insertPageMap(pageCache->a1outMap, pageNum, slot);
+    pageCache->a1outCnt++;
+}
+
+// forget a page of A1out, return 1 if it was there. Its ring slot stays as a
+// hole until it becomes the oldest one.
+static int removePageFromA1out(PageCache* pageCache, const PageNumber pageNum)
+{
+    int slot = lookupPageMap(pageCache->a1outMap, pageNum);
+    if(slot == -1) {
+        return 0;
+    }
+    pageCache->a1out[slot] = NO_PAGE;
+    removePageMap(pageCache->a1outMap, pageNum);
+    return 1;
+}
+
+// A page in Am becomes the most recently used one. A page in A1in stays where
+// it is, references shortly after the first one are most likely correlated.
+RC update2QOrder(PageCache* pageCache, Frame* frame)
+{
+    if(frame->hot) {
+        removeFrameFromLRUList(pageCache, frame);
+        addFrameToLRUList(pageCache, frame);
+    }
+    return RC_OK;
+}
+
+// 2Q hooks. A page remembered in A1out was referenced again after leaving 
+// A1in, so it goes to Am. Any other page is referenced for the first time.
+static void onInsert2Q(PageCache* pageCache, Frame* frame)
+{
+    if(removePageFromA1out(pageCache, frame->pageNum)) {
+        frame->hot = 1;
+        addFrameToLRUList(pageCache, frame);
+    } else {
+        frame->hot = 0;
+        appendFrameToList(pageCache, &pageCache->a1inHead, &pageCache->a1inTail, frame);
+        pageCache->a1inCnt++;
+    }
+}
+
+// The oldest unpinned page of A1in while A1in holds more than its share of 
+// the frames, otherwise the least recently used unpinned page of Am. If the
+// chosen queue has only pinned pages the other one is used.
+static Frame* chooseVictim2Q(PageCache* pageCache)
+{
+    Frame* frame;
+    if(pageCache->a1inCnt > pageCache->maxA1in) {
+        frame = findUnpinnedFrame(pageCache, pageCache->a1inHead);
+        if(frame == NULL) {
+            frame = findUnpinnedFrame(pageCache, pageCache->lruHead);
+        }
+    } else {
+        frame = findUnpinnedFrame(pageCache, pageCache->lruHead);
+        if(frame == NULL) {
+            frame = findUnpinnedFrame(pageCache, pageCache->a1inHead);
+        }
+    }
     return frame;
 }
 
-// get the frame from the page cache
+// pages removed from A1in are remembered in A1out
+static void onEvict2Q(PageCache* pageCache, Frame* frame)
+{
+    if(frame->hot) {
+        removeFrameFromLRUList(pageCache, frame);
+    } else {
+        unlinkFrameFromList(pageCache, &pageCache->a1inHead, &pageCache->a1inTail, frame);
+        pageCache->a1inCnt--;
+        addPageToA1out(pageCache, frame->pageNum);
+    }
+    frame->hot = 0;
+}
+
+static int nextVictims2Q(PageCache* pageCache, Frame** victims, int max)
+{
+    int first = pageCache->lruHead;
+    int second = pageCache->a1inHead;
+    if(pageCache->a1inCnt > pageCache->maxA1in) {
+        first = pageCache->a1inHead;
+        second = pageCache->lruHead;
+    }
+    int num = collectUnpinnedFrames(pageCache, first, victims, 0, max);
+    return collectUnpinnedFrames(pageCache, second, victims, num, max);
+}
+
+// the replacement policies, indexed by ReplacementStrategy
+static const ReplacementPolicy policies[] = {
+    {"FIFO", NULL, NULL, NULL, onInsertLRU, chooseVictimLRU, onEvictLRU, nextVictimsLRU},
+    {"LRU", NULL, NULL, onHitLRU, onInsertLRU, chooseVictimLRU, onEvictLRU, nextVictimsLRU},
+    {"CLOCK", NULL, NULL, NULL, onInsertCLOCK, chooseVictimCLOCK, NULL, nextVictimsCLOCK},
+    {"LFU", createLFUBuckets, freeLFUBuckets, updateLFUFrequency, onInsertLFU, chooseVictimLFU, onEvictLFU, nextVictimsLFU},
+    {"LRU-K", createLRUKHistories, freeLRUKHistories, updateLRUKHistory, onInsertLRUK, chooseVictimLRUK, onEvictLRUK, nextVictimsLRUK},
+    {"2Q", create2QQueues, free2QQueues, update2QOrder, onInsert2Q, chooseVictim2Q, onEvict2Q, nextVictims2Q}
+};
+
+// get the hooks implementing a replacement strategy, NULL if it is unknown
+const ReplacementPolicy* getReplacementPolicy(ReplacementStrategy strategy)
+{
+    if(strategy < 0 || strategy >= (int) (sizeof(policies) / sizeof(policies[0]))) {
+        return NULL;
+    }
+    return &policies[strategy];
+}
+
+// get the frame from the page cache, the page must be pinned for the frame to
+// keep storing it once this returns
 Frame* searchPageFromCache(PageCache *const pageCache, int pageNum) {
+    PageTable* stripe = getPageTableStripe(pageCache, pageNum);
+    pthread_mutex_lock(&stripe->latch);
     // get a frame based on page number
-    int i;
-    for(int i = 0; i < pageCache->capacity; i++) {
-        Frame* frame = pageCache->arr[i];
+    Frame* frame = lookupPageTable(pageCache, pageNum);
+    pthread_mutex_unlock(&stripe->latch);
+    return frame;
+}
+
+// hash a page number to its home slot in a table of mask + 1 slots
+static int hashPageNumber(int mask, const PageNumber pageNum)
+{
+    unsigned int h = (unsigned int) pageNum * 2654435761u;
+    h ^= h >> 16;
+    return (int) (h & mask);
+}
+
+// get the stripe of the page table a page is mapped in. It uses another
+// multiplier than hashPageNumber, so that the pages of a stripe still spread
+// over all of its slots.
+PageTable* getPageTableStripe(PageCache *const pageCache, const PageNumber pageNum)
+{
+    unsigned int h = (unsigned int) pageNum * 0x85ebca6bu;
+    return &pageCache->pageTable[(h >> 16) & (PAGE_TABLE_STRIPES - 1)];
+}
+
+// allocate the slots of a stripe, all of them empty
+static void initPageTableSlots(PageTable* pageTable, int capacity)
+{
+    pageTable->capacity = capacity;
+    pageTable->mask = capacity - 1;
+    pageTable->slots = (int*) malloc(capacity * sizeof(int));
+    for(int i = 0; i < capacity; i++) {
+        pageTable->slots[i] = -1;
+    }
+}
+
+// create the PAGE_TABLE_STRIPES stripes of a page table. Every stripe starts 
+// with at least twice as many slots as its share of the frames, so that the 
+// probe sequences stay short, and grows when it gets more than its share.
+PageTable* createPageTable(int numPages)
+{
+    PageTable* pageTable = (PageTable*) malloc(PAGE_TABLE_STRIPES * sizeof(PageTable));
+
+    int capacity = 8;
+    while(capacity < 2 * ((numPages + PAGE_TABLE_STRIPES - 1) / PAGE_TABLE_STRIPES)) {
+        capacity = capacity << 1;
+    }
+
+    for(int s = 0; s < PAGE_TABLE_STRIPES; s++) {
+        initPageTableSlots(&pageTable[s], capacity);
+        pageTable[s].count = 0;
+        pthread_mutex_init(&pageTable[s].latch, NULL);
+        pthread_cond_init(&pageTable[s].loaded, NULL);
+    }
+    return pageTable;
+}
+
+// release the resources assigned to the page table
+void freePageTable(PageCache* pageCache) {
+    if(pageCache->pageTable) {
+        for(int s = 0; s < PAGE_TABLE_STRIPES; s++) {
+            free(pageCache->pageTable[s].slots);
+            pthread_mutex_destroy(&pageCache->pageTable[s].latch);
+            pthread_cond_destroy(&pageCache->pageTable[s].loaded);
+        }
+        free(pageCache->pageTable);
+        pageCache->pageTable = NULL;
+    }
+}
+
+// find the frame storing pageNum, return NULL if the page is not cached.
+// The caller holds the latch of the stripe of pageNum.
+Frame* lookupPageTable(PageCache *const pageCache, const PageNumber pageNum)
+{
+    if(pageCache->pageTable == NULL || pageNum < 0) {
+        return NULL;
+    }
+    PageTable* pageTable = getPageTableStripe(pageCache, pageNum);
+
+    // probe from the home slot until we meet the page or an empty slot
+    int i = hashPageNumber(pageTable->mask, pageNum);
+    while(pageTable->slots[i] != -1) {
+        Frame* frame = pageCache->arr[pageTable->slots[i]];
         if(frame->pageNum == pageNum) {
             return frame;
         }
+        i = (i + 1) & pageTable->mask;
     }
     return NULL;
 }
 
+// double the slots of a stripe and map its frames again
+static void growPageTable(PageCache* pageCache, PageTable* pageTable)
+{
+    int* slots = pageTable->slots;
+    int capacity = pageTable->capacity;
+
+    initPageTableSlots(pageTable, capacity << 1);
+    for(int j = 0; j < capacity; j++) {
+        if(slots[j] == -1) {
+            continue;
+        }
+        int i = hashPageNumber(pageTable->mask, pageCache->arr[slots[j]]->pageNum);
+        while(pageTable->slots[i] != -1) {
+            i = (i + 1) & pageTable->mask;
+        }
+        pageTable->slots[i] = slots[j];
+    }
+    free(slots);
+}
+
+// map the page stored in this frame to the frame index.
+// The caller holds the latch of the stripe of the page.
+RC insertPageTable(PageCache* pageCache, Frame* frame)
+{
+    if(pageCache->pageTable == NULL || frame == NULL || frame->pageNum == NO_PAGE) {
+        return RC_ERROR;
+    }
+    PageTable* pageTable = getPageTableStripe(pageCache, frame->pageNum);
+
+    // keep at least half of the slots empty
+    if(2 * (pageTable->count + 1) > pageTable->capacity) {
+        growPageTable(pageCache, pageTable);
+    }
+
+    int i = hashPageNumber(pageTable->mask, frame->pageNum);
+    while(pageTable->slots[i] != -1) {
+        // this page is already mapped, point it to the new frame
+        if(pageCache->arr[pageTable->slots[i]]->pageNum == frame->pageNum) {
+            pageTable->slots[i] = frame->frameIndex;
+            return RC_OK;
+        }
+        i = (i + 1) & pageTable->mask;
+    }
+    pageTable->slots[i] = frame->frameIndex;
+    pageTable->count++;
+    return RC_OK;
+}
 
+// remove the mapping of the page stored in this frame. 
+// It must be called before the frame is reset, because the following entries
+// are rehashed by the page numbers of their frames.
+// The caller holds the latch of the stripe of the page.
+RC removePageTable(PageCache* pageCache, Frame* frame)
+{
+    if(pageCache->pageTable == NULL || frame == NULL || frame->pageNum == NO_PAGE) {
+        return RC_ERROR;
+    }
+    PageTable* pageTable = getPageTableStripe(pageCache, frame->pageNum);
+
+    // find the slot of this frame
+    int i = hashPageNumber(pageTable->mask, frame->pageNum);
+    while(pageTable->slots[i] != frame->frameIndex) {
+        if(pageTable->slots[i] == -1) {
+            return RC_ERROR;
+        }
+        i = (i + 1) & pageTable->mask;
+    }
+    pageTable->count--;
+
+    // empty the slot and shift back every entry whose home slot is not 
+    // between the hole and its current position
+    int j = i;
+    pageTable->slots[i] = -1;
+    while(1) {
+        j = (j + 1) & pageTable->mask;
+        if(pageTable->slots[j] == -1) {
+            break;
+        }
+        int k = hashPageNumber(pageTable->mask, pageCache->arr[pageTable->slots[j]]->pageNum);
+        if((i <= j) ? (i < k && k <= j) : (i < k || k <= j)) {
+            continue;
+        }
+        pageTable->slots[i] = pageTable->slots[j];
+        pageTable->slots[j] = -1;
+        i = j;
+    }
+    return RC_OK;
+}
 
+// create a page map with at least twice as many slots as entries
+PageMap* createPageMap(int numEntries)
+{
+    PageMap* pageMap = (PageMap*) malloc(sizeof(PageMap));
 
+    int capacity = 8;
+    while(capacity < 2 * numEntries) {
+        capacity = capacity << 1;
+    }
 
+    pageMap->capacity = capacity;
+    pageMap->mask = capacity - 1;
+    pageMap->keys = (PageNumber*) malloc(capacity * sizeof(PageNumber));
+    pageMap->values = (int*) malloc(capacity * sizeof(int));
+    for(int i = 0; i < capacity; i++) {
+        pageMap->keys[i] = NO_PAGE;
+    }
+    return pageMap;
+}
 
+// release the resources assigned to the page map
+void freePageMap(PageMap* pageMap)
+{
+    if(pageMap) {
+        free(pageMap->keys);
+        free(pageMap->values);
+        free(pageMap);
+    }
+}
 
+// get the value mapped from pageNum, -1 if the page is not in the map
+int lookupPageMap(PageMap* pageMap, const PageNumber pageNum)
+{
+    int i = hashPageNumber(pageMap->mask, pageNum);
+    while(pageMap->keys[i] != NO_PAGE) {
+        if(pageMap->keys[i] == pageNum) {
+            return pageMap->values[i];
+        }
+        i = (i + 1) & pageMap->mask;
+    }
+    return -1;
+}
 
+// map pageNum to value, replacing the previous value of pageNum
+RC insertPageMap(PageMap* pageMap, const PageNumber pageNum, int value)
+{
+    if(pageNum < 0) {
+        return RC_ERROR;
+    }
+    int i = hashPageNumber(pageMap->mask, pageNum);
+    while(pageMap->keys[i] != NO_PAGE && pageMap->keys[i] != pageNum) {
+        i = (i + 1) & pageMap->mask;
+    }
+    pageMap->keys[i] = pageNum;
+    pageMap->values[i] = value;
+    return RC_OK;
+}
 
+// remove pageNum from the map, shifting back the following entries as the
+// page table does
+RC removePageMap(PageMap* pageMap, const PageNumber pageNum)
+{
+    int i = hashPageNumber(pageMap->mask, pageNum);
+    while(pageMap->keys[i] != pageNum) {
+        if(pageMap->keys[i] == NO_PAGE) {
+            return RC_ERROR;
+        }
+        i = (i + 1) & pageMap->mask;
+    }
 
+    int j = i;
+    pageMap->keys[i] = NO_PAGE;
+    while(1) {
+        j = (j + 1) & pageMap->mask;
+        if(pageMap->keys[j] == NO_PAGE) {
+            break;
+        }
+        int k = hashPageNumber(pageMap->mask, pageMap->keys[j]);
+        if((i <= j) ? (i < k && k <= j) : (i < k || k <= j)) {
+            continue;
+        }
+        pageMap->keys[i] = pageMap->keys[j];
+        pageMap->values[i] = pageMap->values[j];
+        pageMap->keys[j] = NO_PAGE;
+        i = j;
+    }
+    return RC_OK;
+}
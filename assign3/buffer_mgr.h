@@ -8,13 +8,16 @@
 // Include bool DT
 #include "dt.h"
 
+#include <pthread.h>
+
 // Replacement Strategies
 typedef enum ReplacementStrategy {
 	RS_FIFO = 0,
 	RS_LRU = 1,
 	RS_CLOCK = 2,
 	RS_LFU = 3,
-	RS_LRU_K = 4
+	RS_LRU_K = 4,
+	RS_2Q = 5
 } ReplacementStrategy;
 
 // Data Types and Structures
@@ -25,6 +28,7 @@ typedef struct BM_BufferPool {
 	char *pageFile; // the name of the page file associated with the buffer pool
 	int numPages; // the number of page frames
 	ReplacementStrategy strategy; // the page replacement strategy
+	int pageSize; // the size of the pages of the page file and of the frames holding them
 	void *mgmtData; // use this one to store the bookkeeping info your buffer
 	// manager needs for a buffer pool
 } BM_BufferPool;
@@ -38,33 +42,170 @@ typedef struct BM_PageHandle {
 // Page Frame: each array entry in buffer pool
 typedef struct Frame {
 	PageNumber pageNum; // which page is currently stored in the frame
-	int pinCount; // how many processes are using this page
-	int dirtyBit; // whether the page has been modified
+	_Atomic int pinCount; // how many processes are using this page
+	_Atomic int dirtyBit; // whether the page has been modified
 	char* data; // points to the area in memory storing the content of the page
+	pthread_rwlock_t latch; // held shared while the page is written, exclusive by latchPage to update it
+	_Atomic int loading; // whether the page is being read into the frame, pins of the page wait meanwhile
+	int frameIndex; // the position of this frame in PageCache->arr
+	int prev; // the index of the previous frame in the recency, frequency, correlated or free list, -1 if none
+	int next; // the index of the next frame in the recency, frequency, correlated or free list, -1 if none
+	_Atomic int refBit; // whether the page has been referenced since the clock hand last passed, used by CLOCK
+	int bucket; // the frequency bucket this frame belongs to, used by LFU
+	int history; // the reference history of the stored page, used by LRU-K
+	int heapPos; // the position of this frame in the victim heap, -1 while it is in the correlated list, used by LRU-K
+	int hot; // whether the page is in the Am queue rather than in A1in, used by 2Q
 }Frame;
 
-// used by LRU
-typedef struct Hash
-{
-    int capacity; 
-	int pageCnt;
-    Frame* *arr;
-} Hash;
+// Parameters of LRU-K passed through stratData, NULL selects the defaults
+typedef struct LRUKParams {
+	int k; // the number of reference times kept for every page, 2 by default
+	int correlatedPeriod; // a reference at most this many ticks after the previous one is correlated and not counted, 0 by default
+} LRUKParams;
+
+// Parameters of 2Q passed through stratData, NULL selects the defaults
+typedef struct TwoQParams {
+	int inSize; // the number of frames A1in keeps before it gives up pages, a quarter of the pool by default
+	int outSize; // the number of page numbers remembered in A1out, half of the pool by default
+} TwoQParams;
+
+// Reference history of a page used by LRU-K. It is retained for a while after
+// the page is evicted, so that a page read again soon keeps its history.
+typedef struct PageHistory {
+	PageNumber pageNum;
+	long last; // the time of the most recent reference, correlated or not
+	long *hist; // hist[i] is the time of the (i+1)-th most recent uncorrelated reference, 0 if unknown
+	int prev; // the neighbours in the list of retained or free histories, -1 if none
+	int next;
+} PageHistory;
+
+// Open-addressing hash from page number to an int value. Unlike the page
+// table it stores its keys, so it can track pages that are not in a frame.
+typedef struct PageMap {
+	int capacity; // the number of slots, always a power of two
+	int mask; // capacity - 1, used to wrap probe positions
+	PageNumber *keys; // the page number stored in each slot, NO_PAGE for an empty slot
+	int *values; // the value mapped from each key
+} PageMap;
+
+// Frequency bucket used by LFU: all frames referenced freq times, from the 
+// oldest to the newest one. Buckets are kept in increasing order of freq.
+typedef struct FreqBucket {
+	int freq; // the reference count shared by the frames in this bucket
+	int head; // the first frame in this bucket
+	int tail; // the last frame in this bucket
+	int prev; // the bucket with the next lower frequency, -1 if none
+	int next; // the bucket with the next higher frequency, -1 if none
+} FreqBucket;
+
+// Page table: an open-addressing hash from page number to frame index.
+// Collisions are resolved by linear probing, and removals shift the following
+// entries back so that no tombstones are needed. The table is split into 
+// PAGE_TABLE_STRIPES stripes with their own latch, so that pins of pages in
+// different stripes do not wait for each other.
+#define PAGE_TABLE_STRIPES 16
+typedef struct PageTable {
+	int capacity; // the number of slots, always a power of two
+	int mask; // capacity - 1, used to wrap probe positions
+	int count; // the number of mapped pages
+	int *slots; // the frame index stored in each slot, -1 for an empty slot
+	pthread_mutex_t latch; // held while the stripe is used, and while the pin count of a frame mapped in it goes up from 0
+	pthread_cond_t loaded; // broadcast when a page of this stripe has been read into its frame
+} PageTable;
+
+// Replacement policy: the hooks implementing a replacement strategy. On a hit
+// pinPage calls onHit. On a miss without a free frame it calls chooseVictim,
+// writes the victim back if it is dirty and calls onEvict, then it reads the
+// page and calls onInsert. init gets the stratData passed to initBufferPool.
+// nextVictims lists the frames in the order chooseVictim would take them, it
+// is used by the background flusher to clean them ahead of eviction.
+// init, destroy, onHit, onEvict and nextVictims may be NULL.
+struct PageCache;
+typedef struct ReplacementPolicy {
+	const char *name;
+	void (*init)(struct PageCache* pageCache, void *stratData);
+	void (*destroy)(struct PageCache* pageCache);
+	RC (*onHit)(struct PageCache* pageCache, Frame* frame);
+	void (*onInsert)(struct PageCache* pageCache, Frame* frame);
+	Frame* (*chooseVictim)(struct PageCache* pageCache); // must not change the pool, NULL if every page is pinned
+	void (*onEvict)(struct PageCache* pageCache, Frame* frame);
+	int (*nextVictims)(struct PageCache* pageCache, Frame** victims, int max); // must not change the pool, returns the number of frames
+} ReplacementPolicy;
 
 // The cached page information
 typedef struct PageCache {
-	int front;
-	int rear;
 	int frameCnt; // the number of used frames in this buffer pool
 	int capacity; // the total number of frames the page cache can store 
 	Frame* *arr; // store frames information
 	//add by Jessica
-	int numRead; //stores number of pages that have been read
-	int numWrite; //stores number of pages that been written
+	_Atomic int numRead; //stores number of pages that have been read
+	_Atomic int numWrite; //stores number of pages that been written
+	_Atomic int numCoalescedWrites; // page writes saved by writing runs of adjacent pages with one call
 	// to solve segment default issue by store the file handle
 	SM_FileHandle* fHandle;
-	// hash for LRU
-	int* hash; // store the frames information
+	// write dirty pages as soon as they are unpinned, otherwise they are only
+	// written on eviction, forcePage and forceFlushPool
+	bool writeThrough;
+	int numEvictions;
+	int numCleanEvictions; // evictions whose victim did not have to be written
+	// Latch of the page cache. It protects the state of the replacement policy,
+	// the free list and the page stored in every frame, so a frame only gets
+	// another page while both this latch and the latches of the stripes of 
+	// both pages are held, in that order. Hits only latch their stripe and 
+	// take this latch for the policy, reads and writes are done without it.
+	pthread_mutex_t latch;
+	pthread_rwlock_t ioLatch; // held shared to read and write pages, exclusive to grow the page file
+	// background flusher writing dirty pages before they are evicted
+	pthread_t flusher;
+	pthread_cond_t flusherCond; // signalled to wake the flusher up when it must stop
+	bool flusherRunning;
+	bool flusherStop;
+	double cleanFraction; // the fraction of the frames to be evicted next that is kept clean
+	int flushInterval; // milliseconds between two passes of the flusher
+	Frame** candidates; // the frames the flusher inspects in its current pass
+	// the hooks of the replacement strategy
+	const ReplacementPolicy* policy;
+	// recency list for LRU and load order for FIFO, from the least to the most recently used frame
+	int lruHead;
+	int lruTail;
+	int freeHead; // the first frame that stores no page
+	int clockHand; // the next frame the CLOCK hand inspects
+	// frequency buckets for LFU, at most one bucket per frame plus a spare one
+	FreqBucket* buckets;
+	int minBucket; // the bucket with the lowest frequency
+	int freeBucket; // the first unused bucket
+	int agingPeriod; // halve all frequencies every agingPeriod references, 0 disables aging
+	int refCnt; // the number of references since the last aging
+	// reference histories and victim heap for LRU-K
+	int k;
+	int correlatedPeriod;
+	long timestamp; // logical clock, advanced on every reference
+	PageHistory* histories;
+	PageMap* historyMap; // the history of every resident or retained page
+	int freeHistory; // the first unused history
+	int retainedHead; // the retained histories of evicted pages, from the oldest one
+	int retainedTail;
+	int retainedCnt;
+	int maxRetained; // the number of evicted pages whose histories are retained
+	int* heap; // frame indices ordered by backward K-distance, the largest distance first
+	int heapSize;
+	int* heapSearch; // heap positions still to be looked at while a victim is chosen
+	int correlatedHead; // the frames referenced within the correlated period, kept out of the heap, from the oldest reference
+	int correlatedTail;
+	// queues for 2Q: pages referenced once go through A1in in FIFO order, and
+	// pages referenced again after leaving A1in live in Am, the LRU list
+	int a1inHead; // from the oldest page in A1in
+	int a1inTail;
+	int a1inCnt;
+	int maxA1in;
+	PageNumber* a1out; // ring of the pages removed from A1in, NO_PAGE once a page comes back
+	int a1outHead; // the oldest entry of the ring
+	int a1outCnt;
+	int maxA1out;
+	PageMap* a1outMap; // the ring slot of every page in A1out
+	// page table to find the frame of a page number in constant time,
+	// an array of PAGE_TABLE_STRIPES stripes
+	PageTable* pageTable;
 }PageCache;
 
 
@@ -77,26 +218,56 @@ typedef struct PageCache {
 
 // Helper Interface
 // manamge resources in buffer pool
-extern Frame* createFrameNode();
+extern Frame* createFrameNode(int pageSize);
 extern RC resetFrameNode(Frame* frame);
-extern int* createHash(int capacity);
 extern PageCache* createPageCache(BM_BufferPool *const bm, int numPages);
 extern void freeFrame(PageCache* pageCache);
 extern void freeFileHandle(PageCache* pageCache); 
-extern void freeHash(PageCache* pageCache);
 extern void freePageCache(PageCache* pageCache);
 
+// Manage the page table of a page cache
+extern PageTable* createPageTable(int numPages);
+extern PageTable* getPageTableStripe(PageCache *const pageCache, const PageNumber pageNum);
+extern void freePageTable(PageCache* pageCache);
+extern Frame* lookupPageTable(PageCache *const pageCache, const PageNumber pageNum);
+extern RC insertPageTable(PageCache* pageCache, Frame* frame);
+extern RC removePageTable(PageCache* pageCache, Frame* frame);
+
 // Manage PageCache in buffer pool
 extern int isFull(PageCache* pageCache);
 extern int isEmpty(PageCache* pageCache);
-extern Frame* isHitPageCache(PageCache* pageCache, const PageNumber pageNum);
-extern RC addPageToPageCacheWithFIFO(BM_BufferPool *const bm, BM_PageHandle *const page, 
-			int pageNum); 
-extern RC addPageToPageCacheWithLRU(BM_BufferPool *const bm, BM_PageHandle *const page, 
+extern bool pinCachedPage(PageCache* pageCache, BM_PageHandle *const page, const PageNumber pageNum);
+extern RC addPageToPageCache(BM_BufferPool *const bm, BM_PageHandle *const page, 
 		const PageNumber pageNum);
-extern RC updateLRUOrder(PageCache* pageCache, int pageNum);
-extern RC removePageWithFIFO(BM_BufferPool *const bm, BM_PageHandle *const page);
-extern Frame* removePageWithLRU(BM_BufferPool *const bm, BM_PageHandle *const page, int leastUsedPage);
+extern void evictPage(PageCache* pageCache, Frame* frame);
+extern RC writeFrame(PageCache* pageCache, Frame* frame);
+extern int pinDirtyFrames(PageCache* pageCache, Frame** frames, int num, Frame** pinned);
+extern RC writePinnedFrames(PageCache* pageCache, Frame** frames, int num);
+extern RC syncPageCache(PageCache* pageCache);
+extern int collectNextVictims(PageCache* pageCache, Frame** victims, int max);
+extern const ReplacementPolicy* getReplacementPolicy(ReplacementStrategy strategy);
+extern RC updateLRUOrder(PageCache* pageCache, Frame* frame);
+extern void addFrameToLRUList(PageCache* pageCache, Frame* frame);
+extern void removeFrameFromLRUList(PageCache* pageCache, Frame* frame);
+extern Frame* getFreeFrame(PageCache* pageCache);
+extern void putFreeFrame(PageCache* pageCache, Frame* frame);
+extern void createLFUBuckets(PageCache* pageCache, void *stratData);
+extern void freeLFUBuckets(PageCache* pageCache);
+extern RC updateLFUFrequency(PageCache* pageCache, Frame* frame);
+extern void ageLFUFrequencies(PageCache* pageCache);
+extern RC updateLRUKHistory(PageCache* pageCache, Frame* frame);
+extern void createLRUKHistories(PageCache* pageCache, void *stratData);
+extern void freeLRUKHistories(PageCache* pageCache);
+extern RC update2QOrder(PageCache* pageCache, Frame* frame);
+extern void create2QQueues(PageCache* pageCache, void *stratData);
+extern void free2QQueues(PageCache* pageCache);
+
+// Manage page maps
+extern PageMap* createPageMap(int numEntries);
+extern void freePageMap(PageMap* pageMap);
+extern int lookupPageMap(PageMap* pageMap, const PageNumber pageNum);
+extern RC insertPageMap(PageMap* pageMap, const PageNumber pageNum, int value);
+extern RC removePageMap(PageMap* pageMap, const PageNumber pageNum);
 extern Frame* searchPageFromCache(PageCache *const pageCache, int pageNum);
 
 // Buffer Manager Interface Pool Handling
@@ -105,6 +276,10 @@ extern RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName
 		void *stratData);
 extern RC shutdownBufferPool(BM_BufferPool *const bm);
 extern RC forceFlushPool(BM_BufferPool *const bm);
+extern RC setWriteThrough(BM_BufferPool *const bm, bool writeThrough);
+extern RC setPoolDurability(BM_BufferPool *const bm, SM_Durability durability, int windowMicros);
+extern RC startFlusher(BM_BufferPool *const bm, double cleanFraction, int flushInterval);
+extern RC stopFlusher(BM_BufferPool *const bm);
 
 // Buffer Manager Interface Access Pages
 extern RC markDirty (BM_BufferPool *const bm, BM_PageHandle *const page);
@@ -112,6 +287,12 @@ extern RC unpinPage (BM_BufferPool *const bm, BM_PageHandle *const page);
 extern RC forcePage (BM_BufferPool *const bm, BM_PageHandle *const page);
 extern RC pinPage (BM_BufferPool *const bm, BM_PageHandle *const page, 
 				const PageNumber pageNum);
+extern RC latchPage (BM_BufferPool *const bm, BM_PageHandle *const page, bool exclusive);
+extern RC unlatchPage (BM_BufferPool *const bm, BM_PageHandle *const page);
+extern RC allocatePoolPage (BM_BufferPool *const bm, PageNumber *pageNum);
+extern RC freePoolPage (BM_BufferPool *const bm, const PageNumber pageNum);
+extern RC punchPoolPages (BM_BufferPool *const bm, const PageNumber startPage, int count);
+extern RC truncatePoolFreePages (BM_BufferPool *const bm);
 
 // Statistics Interface
 extern PageNumber *getFrameContents (BM_BufferPool *const bm);
@@ -119,5 +300,9 @@ extern int *getDirtyFlags (BM_BufferPool *const bm);
 extern int *getFixCounts (BM_BufferPool *const bm);
 extern int getNumReadIO (BM_BufferPool *const bm);
 extern int getNumWriteIO (BM_BufferPool *const bm);
+extern int *getFrameFrequencies (BM_BufferPool *const bm);
+extern int getNumEvictions (BM_BufferPool *const bm);
+extern int getNumCleanEvictions (BM_BufferPool *const bm);
+extern int getNumCoalescedWrites (BM_BufferPool *const bm);
 
 #endif
@@ -106,6 +106,9 @@ printStrat (BM_BufferPool *const bm)
 	case RS_LRU_K:
 		printf("LRU-K");
 		break;
+	case RS_2Q:
+		printf("2Q");
+		break;
 	default:
 		printf("%i", bm->strategy);
 		break;
@@ -192,3 +195,54 @@ int getNumWriteIO (BM_BufferPool *const bm) {
 
 	return pageCache->numWrite;
 }
+
+// The getNumEvictions function returns the number of pages evicted from the buffer pool since it
+// was initialized, getNumCleanEvictions the number of those whose frame was clean and so did not
+// have to be written to disk first.
+int getNumEvictions (BM_BufferPool *const bm) {
+	if(bm == NULL) {
+		return -1;
+	}
+	PageCache* pageCache = bm->mgmtData;
+
+	return pageCache->numEvictions;
+}
+int getNumCleanEvictions (BM_BufferPool *const bm) {
+	if(bm == NULL) {
+		return -1;
+	}
+	PageCache* pageCache = bm->mgmtData;
+
+	return pageCache->numCleanEvictions;
+}
+
+// The getNumCoalescedWrites function returns the number of write calls saved by writing runs of
+// adjacent dirty pages with one call: getNumWriteIO counts pages, this many fewer calls were made.
+int getNumCoalescedWrites (BM_BufferPool *const bm) {
+	if(bm == NULL) {
+		return -1;
+	}
+	PageCache* pageCache = bm->mgmtData;
+
+	return pageCache->numCoalescedWrites;
+}
+
+// The getFrameFrequencies function returns an array of ints (of size numPages) where the ith element
+// is the reference count LFU keeps for the page stored in the ith page frame. Return 0 for empty 
+// page frames and for strategies other than LFU.
+int *getFrameFrequencies (BM_BufferPool *const bm)
+{
+	if(bm == NULL) {
+		return NULL;
+	}
+
+	PageCache* pageCache = bm->mgmtData;
+	int numPages = bm->numPages;
+	int *arr = (int*) malloc(numPages * sizeof(int));
+
+	for(int i = 0; i < numPages; i++) {
+		Frame* frame = pageCache->arr[i];
+		arr[i] = (frame->bucket == -1) ? 0 : pageCache->buckets[frame->bucket].freq;
+	}
+	return arr;
+}
@@ -0,0 +1,165 @@
+#include <pthread.h>
+#include <string.h>
+
+#include "crc32c.h"
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#define HAVE_CRC32_INSTRUCTION 1
+#endif
+
+// the CRC32C polynomial in reflected bit order
+#define CRC32C_POLY 0x82F63B78
+
+// crcTable[0] advances the CRC by one byte, crcTable[k] by a byte followed by
+// k '\0' bytes, so eight bytes are processed with eight lookups
+static uint32_t crcTable[8][256];
+
+// x2nTable[k] is x^(2^k) modulo the polynomial, used to shift a CRC over
+// a number of '\0' bytes
+static uint32_t x2nTable[32];
+
+static pthread_once_t crcTableOnce = PTHREAD_ONCE_INIT;
+
+// multiply a and b modulo the polynomial, in reflected bit order
+static uint32_t multModP(uint32_t a, uint32_t b) {
+  uint32_t m = 1u << 31, p = 0;
+  while (1) {
+    if (a & m) {
+      p ^= b;
+      if ((a & (m - 1)) == 0) {
+        break;
+      }
+    }
+    m >>= 1;
+    b = (b & 1) ? (b >> 1) ^ CRC32C_POLY : b >> 1;
+  }
+  return p;
+}
+
+static void initCrcTables(void) {
+  for (int i = 0; i < 256; i++) {
+    uint32_t crc = i;
+    for (int j = 0; j < 8; j++) {
+      crc = (crc >> 1) ^ (CRC32C_POLY & (0u - (crc & 1)));
+    }
+    crcTable[0][i] = crc;
+  }
+  for (int i = 0; i < 256; i++) {
+    for (int k = 1; k < 8; k++) {
+      crcTable[k][i] = (crcTable[k - 1][i] >> 8) ^ crcTable[0][crcTable[k - 1][i] & 0xff];
+    }
+  }
+
+  // x^1 is the bit next to the top one in reflected order
+  x2nTable[0] = 1u << 30;
+  for (int k = 1; k < 32; k++) {
+    x2nTable[k] = multModP(x2nTable[k - 1], x2nTable[k - 1]);
+  }
+}
+
+// x^(8 * len) modulo the polynomial, which shifts a CRC over len '\0' bytes
+static uint32_t shiftBytes(size_t len) {
+  uint32_t p = 1u << 31;
+  int k = 3;
+  while (len > 0) {
+    if (len & 1) {
+      p = multModP(x2nTable[k & 31], p);
+    }
+    len >>= 1;
+    k++;
+  }
+  return p;
+}
+
+uint32_t crc32cSlicingBy8(uint32_t crc, const void *data, size_t len) {
+  pthread_once(&crcTableOnce, initCrcTables);
+  const unsigned char *p = data;
+  crc = ~crc;
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  while (len >= 8) {
+    uint64_t word;
+    memcpy(&word, p, 8);
+    word ^= crc;
+    crc = crcTable[7][word & 0xff] ^ crcTable[6][(word >> 8) & 0xff] ^
+          crcTable[5][(word >> 16) & 0xff] ^ crcTable[4][(word >> 24) & 0xff] ^
+          crcTable[3][(word >> 32) & 0xff] ^ crcTable[2][(word >> 40) & 0xff] ^
+          crcTable[1][(word >> 48) & 0xff] ^ crcTable[0][word >> 56];
+    p += 8;
+    len -= 8;
+  }
+#endif
+  while (len-- > 0) {
+    crc = (crc >> 8) ^ crcTable[0][(crc ^ *p++) & 0xff];
+  }
+  return ~crc;
+}
+
+#ifdef HAVE_CRC32_INSTRUCTION
+// The crc32 instruction takes three cycles but a new one can start every
+// cycle, so long inputs are split in three parts whose CRCs are computed
+// together and then combined: the CRC of a part is shifted over the bytes of
+// the parts after it. The shifts for the length of the last input are kept.
+__attribute__((target("sse4.2")))
+static uint32_t crc32cHardware(uint32_t crc, const void *data, size_t len) {
+  static __thread size_t shiftLen = 0;
+  static __thread uint32_t shift1, shift2;
+  const unsigned char *p = data;
+  uint64_t crc0 = ~crc;
+
+  if (len >= 768) {
+    size_t part = (len / 24) * 8;
+    uint64_t crc1 = 0, crc2 = 0;
+    const unsigned char *end = p + part;
+    while (p < end) {
+      uint64_t w0, w1, w2;
+      memcpy(&w0, p, 8);
+      memcpy(&w1, p + part, 8);
+      memcpy(&w2, p + 2 * part, 8);
+      crc0 = _mm_crc32_u64(crc0, w0);
+      crc1 = _mm_crc32_u64(crc1, w1);
+      crc2 = _mm_crc32_u64(crc2, w2);
+      p += 8;
+    }
+    if (shiftLen != part) {
+      pthread_once(&crcTableOnce, initCrcTables);
+      shift1 = shiftBytes(part);
+      shift2 = shiftBytes(2 * part);
+      shiftLen = part;
+    }
+    crc0 = multModP(shift2, (uint32_t) crc0) ^ multModP(shift1, (uint32_t) crc1) ^ (uint32_t) crc2;
+    p += 2 * part;
+    len -= 3 * part;
+  }
+
+  while (len >= 8) {
+    uint64_t word;
+    memcpy(&word, p, 8);
+    crc0 = _mm_crc32_u64(crc0, word);
+    p += 8;
+    len -= 8;
+  }
+  while (len-- > 0) {
+    crc0 = _mm_crc32_u8((uint32_t) crc0, *p++);
+  }
+  return ~(uint32_t) crc0;
+}
+#endif
+
+int crc32cHardwareAvailable(void) {
+#ifdef HAVE_CRC32_INSTRUCTION
+  return __builtin_cpu_supports("sse4.2") != 0;
+#else
+  return 0;
+#endif
+}
+
+uint32_t crc32c(uint32_t crc, const void *data, size_t len) {
+#ifdef HAVE_CRC32_INSTRUCTION
+  if (__builtin_cpu_supports("sse4.2")) {
+    return crc32cHardware(crc, data, len);
+  }
+#endif
+  return crc32cSlicingBy8(crc, data, len);
+}
@@ -0,0 +1,18 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC32C (Castagnoli) of len bytes of data, continuing from crc, which is 0
+// for the first bytes
+extern uint32_t crc32c (uint32_t crc, const void *data, size_t len);
+
+// the same with slicing-by-8 tables only, which crc32c falls back to if the
+// processor has no crc32 instruction
+extern uint32_t crc32cSlicingBy8 (uint32_t crc, const void *data, size_t len);
+
+// 1 if crc32c uses the crc32 instruction of SSE4.2
+extern int crc32cHardwareAvailable (void);
+
+#endif
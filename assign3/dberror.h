@@ -4,7 +4,7 @@
 #include "stdio.h"
 
 /* module wide constants */
-#define PAGE_SIZE 4096
+#define PAGE_SIZE 4096 // the default and smallest page size, see setPageSize
 
 /* return code definitions */
 typedef int RC;
@@ -19,6 +19,9 @@ typedef int RC;
 #define RC_ALLOC_MEM_FAIL 7
 #define RC_DATATYPE_MISMATCH 8
 #define RC_DATATYPE_UNDEFINE 9
+#define RC_ASYNC_PENDING 10
+#define RC_FILE_FORMAT_UNSUPPORTED 11
+#define RC_CHECKSUM_MISMATCH 12
 
 #define RC_TABLE_NOT_EXISTS 100
 #define RC_TABLE_EXISTS 101
@@ -0,0 +1,245 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "lz.h"
+
+// An LZ77 codec in the block format of LZ4. The data is a sequence of
+// literal runs, each followed by a match that copies earlier output:
+//
+//   token          literal length in the high 4 bits, match length - 4 in the
+//                  low 4 bits, 15 meaning that more bytes follow
+//   [length bytes] 255 for as long as the literal length goes on, then the rest
+//   literals
+//   offset         distance back to the match, 2 bytes little endian
+//   [length bytes] the same for the match length
+//
+// The last sequence has literals only. Matches are found with a hash table of
+// the positions of 4-byte sequences, the first candidate is taken.
+
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 12
+#define LZ_MAX_OFFSET 65535
+
+// matches end this many bytes before the end of the input, and do not start
+// in the last LZ_MATCH_LIMIT bytes, so the input ends with literals
+#define LZ_LAST_LITERALS 5
+#define LZ_MATCH_LIMIT 12
+
+// inputs that do not compress are skipped faster the longer no match is found
+#define LZ_SKIP_TRIGGER 6
+
+static uint32_t read32(const unsigned char *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static uint64_t read64(const unsigned char *p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+// copy len bytes 8 at a time, which may write up to 7 bytes past dst + len
+static void wildCopy(unsigned char *dst, const unsigned char *src, int len) {
+  unsigned char *end = dst + len;
+  do {
+    memcpy(dst, src, 8);
+    dst += 8;
+    src += 8;
+  } while (dst < end);
+}
+
+// the number of bytes from p on that are equal to those from match on, 
+// stopping at limit
+static const unsigned char *extendMatch(const unsigned char *p, const unsigned char *match,
+                                        const unsigned char *limit) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  while (p + 8 <= limit) {
+    uint64_t diff = read64(p) ^ read64(match);
+    if (diff != 0) {
+      return p + (__builtin_ctzll(diff) >> 3);
+    }
+    p += 8;
+    match += 8;
+  }
+#endif
+  while (p < limit && *p == *match) {
+    p++;
+    match++;
+  }
+  return p;
+}
+
+static int hash4(uint32_t v) {
+  return (int) ((v * 2654435761u) >> (32 - LZ_HASH_BITS));
+}
+
+// write the rest of a length whose field in the token is 15
+static unsigned char *writeLength(unsigned char *op, int len) {
+  while (len >= 255) {
+    *op++ = 255;
+    len -= 255;
+  }
+  *op++ = (unsigned char) len;
+  return op;
+}
+
+// the most bytes a sequence of litLen literals and a match of matchLen bytes
+// takes, its match included
+static int sequenceBound(int litLen, int matchLen) {
+  return 1 + litLen / 255 + 1 + litLen + 2 + matchLen / 255 + 1;
+}
+
+int lzCompress(const char *src, int srcLen, char *dst, int dstCap) {
+  const unsigned char *base = (const unsigned char *) src;
+  const unsigned char *ip = base, *anchor = base, *end = base + srcLen;
+  unsigned char *op = (unsigned char *) dst, *opEnd = op + dstCap;
+  int table[1 << LZ_HASH_BITS];
+  int misses = 0;
+
+  if (srcLen > LZ_MATCH_LIMIT) {
+    const unsigned char *matchLimit = end - LZ_MATCH_LIMIT;
+    memset(table, -1, sizeof(table));
+    while (ip < matchLimit) {
+      uint32_t seq = read32(ip);
+      int h = hash4(seq);
+      int ref = table[h];
+      table[h] = (int) (ip - base);
+      if (ref < 0 || ip - (base + ref) > LZ_MAX_OFFSET || read32(base + ref) != seq) {
+        ip += 1 + (misses++ >> LZ_SKIP_TRIGGER);
+        continue;
+      }
+      misses = 0;
+
+      // extend the match as far as it goes
+      const unsigned char *match = base + ref;
+      const unsigned char *matchEnd = extendMatch(ip + LZ_MIN_MATCH, match + LZ_MIN_MATCH, end - LZ_LAST_LITERALS);
+
+      int litLen = (int) (ip - anchor);
+      int matchLen = (int) (matchEnd - ip) - LZ_MIN_MATCH;
+      if (sequenceBound(litLen, matchLen) > opEnd - op) {
+        return 0;
+      }
+      unsigned char *token = op++;
+      *token = (unsigned char) (((litLen >= 15) ? 15 : litLen) << 4 | ((matchLen >= 15) ? 15 : matchLen));
+      if (litLen >= 15) {
+        op = writeLength(op, litLen - 15);
+      }
+      memcpy(op, anchor, litLen);
+      op += litLen;
+      int offset = (int) (ip - match);
+      *op++ = (unsigned char) (offset & 0xff);
+      *op++ = (unsigned char) (offset >> 8);
+      if (matchLen >= 15) {
+        op = writeLength(op, matchLen - 15);
+      }
+      ip = anchor = matchEnd;
+
+      // the sequence just before the end of the match starts the next one
+      // more often than not
+      if (ip < matchLimit) {
+        table[hash4(read32(ip - 2))] = (int) (ip - 2 - base);
+      }
+    }
+  }
+
+  // the last literals
+  int litLen = (int) (end - anchor);
+  if (1 + litLen / 255 + 1 + litLen > opEnd - op) {
+    return 0;
+  }
+  *op++ = (unsigned char) (((litLen >= 15) ? 15 : litLen) << 4);
+  if (litLen >= 15) {
+    op = writeLength(op, litLen - 15);
+  }
+  memcpy(op, anchor, litLen);
+  op += litLen;
+  return (int) (op - (unsigned char *) dst);
+}
+
+// read the rest of a length whose field in the token is 15, -1 if the input
+// ends first
+static int readLength(const unsigned char **ip, const unsigned char *ipEnd) {
+  int len = 0;
+  unsigned char b;
+  do {
+    if (*ip >= ipEnd) {
+      return -1;
+    }
+    b = *(*ip)++;
+    len += b;
+  } while (b == 255);
+  return len;
+}
+
+int lzDecompress(const char *src, int srcLen, char *dst, int dstCap) {
+  const unsigned char *ip = (const unsigned char *) src, *ipEnd = ip + srcLen;
+  unsigned char *op = (unsigned char *) dst, *opEnd = op + dstCap;
+
+  while (ip < ipEnd) {
+    int token = *ip++;
+    int litLen = token >> 4;
+    if (litLen == 15) {
+      int more = readLength(&ip, ipEnd);
+      if (more < 0) {
+        return -1;
+      }
+      litLen += more;
+    }
+    if (litLen > ipEnd - ip || litLen > opEnd - op) {
+      return -1;
+    }
+    if (litLen + 8 <= ipEnd - ip && litLen + 8 <= opEnd - op) {
+      wildCopy(op, ip, litLen);
+    } else {
+      memcpy(op, ip, litLen);
+    }
+    op += litLen;
+    ip += litLen;
+
+    // the last sequence has no match
+    if (ip == ipEnd) {
+      break;
+    }
+    if (ipEnd - ip < 2) {
+      return -1;
+    }
+    int offset = ip[0] | ip[1] << 8;
+    ip += 2;
+    if (offset == 0 || offset > op - (unsigned char *) dst) {
+      return -1;
+    }
+    int matchLen = token & 15;
+    if (matchLen == 15) {
+      int more = readLength(&ip, ipEnd);
+      if (more < 0) {
+        return -1;
+      }
+      matchLen += more;
+    }
+    matchLen += LZ_MIN_MATCH;
+    if (matchLen > opEnd - op) {
+      return -1;
+    }
+
+    // a match that overlaps its own output repeats the bytes from match on,
+    // which are copied in pieces that double in size
+    const unsigned char *match = op - offset;
+    if (offset >= 8 && matchLen + 8 <= opEnd - op) {
+      wildCopy(op, match, matchLen);
+      op += matchLen;
+      continue;
+    }
+    while (matchLen > 0) {
+      int n = (int) (op - match);
+      if (n > matchLen) {
+        n = matchLen;
+      }
+      memcpy(op, match, n);
+      op += n;
+      matchLen -= n;
+    }
+  }
+  return (int) (op - (unsigned char *) dst);
+}
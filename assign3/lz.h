@@ -0,0 +1,13 @@
+#ifndef LZ_H
+#define LZ_H
+
+// compress srcLen bytes of src into dst, which has room for dstCap bytes.
+// Return the length of the compressed data, 0 if it does not fit in dstCap.
+extern int lzCompress (const char *src, int srcLen, char *dst, int dstCap);
+
+// decompress srcLen bytes of src into dst, which has room for dstCap bytes.
+// Return the length of the decompressed data, -1 if src is not valid
+// compressed data or does not fit in dstCap.
+extern int lzDecompress (const char *src, int srcLen, char *dst, int dstCap);
+
+#endif
@@ -32,6 +32,15 @@ int maxPageDiretories; // the max page directories that can be stored in a singl
 
 
 
+// count the max slots that can be used in a single page of pageSize bytes.
+// Records are stored as text at slot * sizeRecord, the page keeps room for a
+// terminating '\0' and for the checksum trailer of files that have one.
+static void initSlotCapacity(Schema *schema, int pageSize)
+{
+    sizeRecord = getRecordSize(schema) + sizeof(int) + sizeof(int) + 2 + 2 + 2 + 3 + 1 + 3 + 1; 
+    capacity = (pageSize - PAGE_CHECKSUM_SIZE - 1) / sizeRecord;
+}
+
 // initialize a record manager
 RC initRecordManager (void *mgmtData) 
 {
@@ -74,9 +83,15 @@ RC createTable (char *name, Schema *schema)
     // get serialize schema data
     char *schemaInfo = serializeSchema(schema);
 
+    // pages are written whole, so the data is copied into a page filled with
+    // '\0' bytes first
+    char *pageData = (char *) calloc(fHandle.pageSize, sizeof(char));
+
     // write the schema data to page 0
-    if(writeBlock(0, &fHandle, schemaInfo) != RC_OK) {
+    strncpy(pageData, schemaInfo, fHandle.pageSize - 1);
+    if(writeBlock(0, &fHandle, pageData) != RC_OK) {
         free(schemaInfo);
+        free(pageData);
         return RC_WRITE_FAILED;
     }
 
@@ -86,10 +101,14 @@ RC createTable (char *name, Schema *schema)
     char *pdInfo = serializePageDirectory(pd);
 
     ensureCapacity(2, &fHandle);
-    if(writeBlock(1, &fHandle, pdInfo) != RC_OK) {
+    memset(pageData, 0, fHandle.pageSize);
+    strncpy(pageData, pdInfo, fHandle.pageSize - 1);
+    if(writeBlock(1, &fHandle, pageData) != RC_OK) {
         free(pdInfo);
+        free(pageData);
         return RC_WRITE_FAILED;
     }
+    free(pageData);
 
     // after page initialize, close those page to flush
     closePageFile(&fHandle);
@@ -97,13 +116,12 @@ RC createTable (char *name, Schema *schema)
     // initalize gloabl data
     numTuples = 0;
 
-    // count the max slots that be used in a single page
-    sizeRecord = getRecordSize(schema) + sizeof(int) + sizeof(int) + 2 + 2 + 2 + 3 + 1 + 3 + 1; 
-    // set the capacity a little bit lower than the value PAGE_SIZE / sizeRecord to consider overhead
-    capacity = 110; 
+    // count the max slots that be used in a single page, pages are of the
+    // size selected with setPageSize
+    initSlotCapacity(schema, fHandle.pageSize);
     
     // get max page directories that can be stored in a signle page
-    maxPageDiretories = PAGE_SIZE / strlen(pdInfo);
+    maxPageDiretories = fHandle.pageSize / strlen(pdInfo);
 
     // release all resources
     free(schemaInfo);
@@ -140,6 +158,9 @@ RC openTable (RM_TableData *rel, char *name)
     Schema *schema = deserializeSchema(page->data);
     unpinPage(bm, page);
 
+    // the slots of a page depend on the record size and the page size
+    initSlotCapacity(schema, bm->pageSize);
+
     // read data from the page 1 since it stores all page directories info
     pinPage(bm, page, 1);
 
@@ -178,9 +199,8 @@ RC closeTable (RM_TableData *rel)
     strcpy(frame->data, pdInfo);
     markDirty(bm, page);
     unpinPage(bm, page);
-    forcePage(bm, page);
 
-    // close the buffer pool
+    // close the buffer pool, which writes back all dirty pages
     shutdownBufferPool(bm);
 
     // release schema resource
@@ -222,6 +242,14 @@ int getNumTuples (RM_TableData *rel)
     return numTuples;
 }
 
+// get the buffer pool caching the pages of the open table, the record manager
+// keeps a single pool rather than one per table
+BM_BufferPool *getTableBufferPool (RM_TableData *rel)
+{
+    (void) rel;
+    return bm;
+}
+
 RC flushDataToPage(char *data, int offset, int pageNum)
 {
     if(data == NULL) {
@@ -233,13 +261,12 @@ RC flushDataToPage(char *data, int offset, int pageNum)
     PageCache* pageCache = bm->mgmtData;
     Frame* frame = searchPageFromCache(pageCache, page->pageNum);
 
-    // copy this data to frame data
-    memset(frame->data + offset, '\0', strlen(data));
-    strcpy(frame->data + offset, data);
+    // copy this data to frame data, without a '\0' that would cut off the
+    // record in the next slot
+    memcpy(frame->data + offset, data, strlen(data));
 
     markDirty(bm, page);
     unpinPage(bm, page);
-    forcePage(bm, page);
     return RC_OK;
 }
 
@@ -376,14 +403,12 @@ RC deleteRecord (RM_TableData *rel, RID id)
             // get this record offset
             int offset = sizeRecord * id.slot;
 
-            // find the frame to be written
-            pinPage(bm, page, p->pageNum);
+            // find the frame to be written, it is still pinned
             PageCache* pageCache = bm->mgmtData;
             Frame* frame = searchPageFromCache(pageCache, page->pageNum);
             strncpy(frame->data + offset, recordStr, sizeRecord);
             markDirty(bm, page);
             unpinPage(bm, page);
-            forcePage(bm, page);
 
             // after that, get all records in this page
             getRecords(rel, page->data, sizeRecord);
@@ -453,11 +478,10 @@ RC updateRecord (RM_TableData *rel, Record *record)
             int offset = sizeRecord * newRecord->id.slot;
             PageCache* pageCache = bm->mgmtData;
             Frame* frame = searchPageFromCache(pageCache, page->pageNum);
-            strcpy(frame->data + offset, newRecordStr);
+            memcpy(frame->data + offset, newRecordStr, strlen(newRecordStr));
 
             markDirty(bm, page);
             unpinPage(bm, page);
-            forcePage(bm, page);
         }
         p = p->next;
     }
@@ -483,6 +507,7 @@ RC getRecord (RM_TableData *rel, RID id, Record *record)
 
     pinPage(bm, page, recordPageNum);
     getRecords(rel, page->data, sizeRecord);
+    unpinPage(bm, page);
     RecordNode *p = head;
     while(p != NULL) {
         if(id.page == p->page && id.slot == p->slot) {
@@ -51,5 +51,6 @@ extern RC setAttr (Record *record, Schema *schema, int attrNum, Value *value);
 
 // helper functions
 PageDirectory * createPageDirectoryNode(int pageNum);
+extern BM_BufferPool *getTableBufferPool (RM_TableData *rel);
 
 #endif // RECORD_MGR_H
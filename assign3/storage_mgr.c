@@ -1,340 +1,2948 @@
+// page offsets are 64 bits wide, also where off_t defaults to 32 bits
+#define _FILE_OFFSET_BITS 64
+// fallocate is used to reserve space ahead of the end of a file
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+// io_uring is used through its system calls, it needs no library
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup)
+#include <linux/io_uring.h>
+#define HAVE_IO_URING 1
+#endif
+#endif
 
 #include "storage_mgr.h"
 #include "dberror.h"
+#include "crc32c.h"
+#include "lz.h"
 
-// Instantiate the storage manager by printing a message to standard out.
-void initStorageManager(void) {
-  printf("The program begins to initialize storage manager.\n");
+// the most buffers a single preadv or pwritev takes
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+// the alignment of the buffers, offsets and lengths of direct I/O. Page sizes
+// are multiples of it and pages are at multiples of their size, so only 
+// buffers need checking.
+#define DIRECT_IO_ALIGNMENT 4096
+
+// the pages of the address range reserved for the mapping of a page file, 
+// enough for the largest file so that the mapping never has to move
+#define MAPPED_RESERVE INT_MAX
+
+// The header of a page file, at the start of an extra page in front of the
+// pages of its first segment: page i of segment 0 is at offset 
+// (i + 1) * pageSize, and the other segments hold pages only. Files created
+// before the header was introduced have no header page, they are recognized
+// by the missing magic, and have pages of PAGE_SIZE bytes. Integers are stored
+// in the byte order of the machine. The header page is as long as the other
+// pages, but only its first PAGE_SIZE bytes are used, so that it can be read
+// before the page size is known.
+#define PAGE_FILE_MAGIC "PAGEFILE"
+#define PAGE_FILE_VERSION 1
+
+// the flags of the header
+#define PAGE_FILE_CHECKSUMS 0x1 // every page ends with a checksum of the rest of it
+#define PAGE_FILE_COMPRESSED 0x2 // the pages are compressed, see SM_PageSlot
+
+typedef struct SM_FileHeader {
+  char magic[8]; // PAGE_FILE_MAGIC, not terminated
+  int32_t version; // the version of the format, files of a later one are refused
+  int32_t pageSize; // the size of the pages
+  int32_t pageCount; // the number of pages, the header page not included
+  int32_t freeListHead; // the first page of the free page map, -1 if there is none
+  int32_t flags; // the features the file was created with, PAGE_FILE_ flags
+  int32_t segmentPages; // the number of pages in a segment, 0 if the file is not segmented
+} SM_FileHeader;
+
+// The free page map has a bit for every page of a file, set if the page is
+// free. The pages are split in ranges of as many pages as a page has bits
+// after its SM_FreeMapHeader and checksum trailer, and the map of a range is
+// kept in a page of the file, the first one freed in the range. The pages of
+// the map are chained from the freeListHead of the header.
+typedef struct SM_FreeMapHeader {
+  int32_t next; // the next page of the map, -1 after the last one
+  int32_t firstPage; // the first page of the range this page has the bits of
+} SM_FreeMapHeader;
+
+// The pages of a compressed file are stored in slots of a whole number of
+// SLOT_UNIT bytes, in the slot area that follows the header page. The page
+// map, the file named fileName.map, has the SM_PageSlot of page i at offset
+// i * sizeof(SM_PageSlot), pages past its end were never written. A page that
+// does not compress is stored as it is, and one that was never written has no
+// slot and reads as '\0' bytes. A page that is written again stays in its
+// slot if it fits, otherwise it moves to a free slot or to the end of the slot
+// area and frees its old slot. The free slots are the gaps between the slots
+// of the map, they are found again when the file is opened.
+#define SLOT_UNIT 128
+
+typedef struct SM_PageSlot {
+  uint32_t offset; // the start of the slot in the slot area, in SLOT_UNIT
+  uint32_t length; // the bytes of the compressed page, pageSize if it is stored as it is, 0 if it was never written
+  uint32_t units; // the size of the slot in SLOT_UNIT
+} SM_PageSlot;
+
+// the free slots of one size
+typedef struct SM_SlotList {
+  uint32_t *offsets;
+  int count;
+  int capacity;
+} SM_SlotList;
+
+// The state of an open page file, stored in SM_FileHandle->mgmtInfo. Pages are
+// read and written with pread and pwrite at their own offset, so there is no
+// shared file cursor and threads can use the same handle at once. Each page
+// moves between the file and memPage with one system call, and there is no
+// stdio buffer to copy it through.
+//
+// A page file may be split into segments of segmentPages pages. Segment 0 is
+// the file named fileName, segment i is the file named fileName.i, and every
+// segment but the last one is full.
+//
+// A page file opened with openMappedPageFile is also mapped into memory. Page
+// i is at map + i * pageSize whatever segment it is in, and its pages are
+// copied from and to the mapping instead of read and written.
+typedef struct SM_FileInfo {
+  int *fds; // the file descriptor of every segment
+  int pageSize; // the size of the pages, also in SM_FileHandle->pageSize
+  int numSegments;
+  char *header; // the header page, aligned for direct I/O, NULL for a file without a header
+  int headerPages; // the pages in front of the pages of the first segment, 1 or 0
+  int segmentPages; // the number of pages in a segment, 0 if the file is not segmented
+  int reservedPages; // space is reserved on disk up to this page, which may be past the last one
+  int direct; // 1 if the segments are open with O_DIRECT
+  int checksums; // 1 if the pages end with a checksum, see setPageChecksums
+  char *map; // the start of the address range of the mapping, NULL if the file is not mapped
+  int mappedPages; // the pages before this one are mapped
+  int mapLimit; // the pages the address range of the mapping has room for
+  struct SM_AsyncIO *async; // the engine of the asynchronous transfers, NULL until the first one
+
+  // the slots of the pages of a compressed file, see SM_PageSlot
+  int compressed; // 1 if the pages are compressed, see setPageCompression
+  int mapFd; // the page map, -1 if the file is not compressed
+  SM_PageSlot *slots; // the slot of every page
+  int slotCapacity; // the pages slots has room for
+  SM_SlotList *freeSlots; // the free slots by their size, of 1 to pageSize / SLOT_UNIT units
+  uint32_t slotEnd; // the end of the slot area, in SLOT_UNIT
+  pthread_rwlock_t slotLatch; // held shared to read a page, exclusive to write one or to grow the map
+
+  // the free page map, see SM_FreeMapHeader
+  int numFreeMaps; // the ranges of pages freeMapPages and freeMaps have room for
+  int *freeMapPages; // the page holding the map of each range, -1 if the range has none
+  char **freeMaps; // the map of each range as it is written, NULL if the range has none
+  int numFreePages; // the pages whose bit is set
+  pthread_mutex_t freeLatch; // held to allocate or free a page
+
+  // the writes are made durable as selected by setDurability. In group commit
+  // mode the force requests are numbered, and a request is served once a 
+  // sync that started after it is done.
+  SM_Durability durability;
+  int syncWindow; // the microseconds a group commit waits for more force requests to join it
+  pthread_mutex_t syncLatch; // protects the state of the group commits
+  pthread_cond_t synced; // broadcast when a group commit is done
+  long forceRequests; // the number of the last force request
+  long syncedRequests; // the force requests up to this one are durable
+  int syncing; // 1 while a group commit is in progress
+  int newSegments; // 1 if segments were created since the directory was synced
+  int numSyncs; // the syncs issued, updated atomically
+  int numForces; // the force requests served, updated atomically
+} SM_FileInfo;
+
+static void destroyAsyncIO(struct SM_AsyncIO *aio);
+
+// the number of pages in a segment of the files that are not segmented yet,
+// 0 keeps them in a single file
+static int segmentSize = 0;
+
+// The setSegmentSize function makes the page files that are created from now
+// on, and the existing ones that still fit in one segment, split into segment
+// files of pagesPerSegment pages as they grow. For example 
+// setSegmentSize((1 << 30) / PAGE_SIZE) selects segments of 1 GiB. A file 
+// that already has several segments keeps its own segment size, and 0 turns
+// segmenting off again.
+RC setSegmentSize(int pagesPerSegment) {
+  if (pagesPerSegment < 0) {
+    return RC_PARAMS_ERROR;
+  }
+  segmentSize = pagesPerSegment;
+  return RC_OK;
+}
+
+// the size of the pages of the files that are created from now on
+static int newPageSize = PAGE_SIZE;
+
+// 1 if pages of size bytes can be stored: a power of two from PAGE_SIZE to
+// MAX_PAGE_SIZE, which is a multiple of the alignment of direct I/O and of the
+// pages of the mappings
+static int validPageSize(int size) {
+  return size >= PAGE_SIZE && size <= MAX_PAGE_SIZE && (size & (size - 1)) == 0;
+}
+
+// The setPageSize function makes the page files that are created from now on
+// have pages of size bytes, a power of two from PAGE_SIZE to MAX_PAGE_SIZE.
+// Larger pages take fewer transfers to scan a file, smaller ones read and 
+// write less for a single record. The size is recorded in the header of a
+// file and given in SM_FileHandle->pageSize once it is open.
+RC setPageSize(int size) {
+  if (!validPageSize(size)) {
+    return RC_PARAMS_ERROR;
+  }
+  newPageSize = size;
+  return RC_OK;
+}
+
+// 1 if page files are created compressed
+static int pageCompression = 0;
+
+// The setPageCompression function makes the page files that are created from
+// now on store their pages compressed with the LZ codec of lz.c, each one in
+// a slot of about the size it compresses to. writeBlock compresses a page and
+// readBlock decompresses it into memPage, so callers see the pages as they
+// are. A compressed file is not segmented, cannot be mapped and is not opened
+// with direct I/O, and its asynchronous transfers are done when they are
+// submitted. A file keeps the choice it was created with, 0 turns compression
+// off for new files.
+RC setPageCompression(int enable) {
+  pageCompression = (enable != 0);
+  return RC_OK;
+}
+
+// 1 if page files are opened with O_DIRECT
+static int directIO = 0;
+
+// The setDirectIO function makes the page files that are opened from now on
+// bypass the page cache of the operating system with O_DIRECT, so a page that
+// the buffer pool holds is not cached in memory a second time. Pages read or
+// written through buffers that are not aligned to DIRECT_IO_ALIGNMENT are
+// copied through an aligned buffer. A file system that rejects O_DIRECT gets
+// buffered I/O instead. 0 turns direct I/O off again.
+RC setDirectIO(int enable) {
+  directIO = (enable != 0);
+  return RC_OK;
+}
+
+// 1 if page files are created with checksums
+static int pageChecksums = 0;
+
+// The setPageChecksums function makes the page files that are created from 
+// now on keep a CRC32C checksum of every page in its last PAGE_CHECKSUM_SIZE
+// bytes, which are left to the storage manager. The checksum is computed when
+// a page is written and checked when it is read, and a page that does not
+// match it is reported with RC_CHECKSUM_MISMATCH. Pages that were never 
+// written read as '\0' bytes without a checksum and are accepted. A file 
+// keeps the choice it was created with, 0 turns checksums off for new files.
+RC setPageChecksums(int enable) {
+  pageChecksums = (enable != 0);
+  return RC_OK;
+}
+
+// open a segment file, with O_DIRECT if *direct is set. *direct is cleared if
+// the file system does not support direct I/O, and the file is opened without.
+static int openSegment(const char *name, int flags, int *direct) {
+  if (*direct) {
+    int fd = open(name, flags | O_DIRECT, 0644);
+    if (fd >= 0 || errno != EINVAL) {
+      return fd;
+    }
+    *direct = 0;
+  }
+  return open(name, flags, 0644);
+}
+
+// go back to buffered I/O on every segment, once one of them cannot be opened
+// with O_DIRECT
+static void dropDirectIO(SM_FileInfo *info) {
+  for (int i = 0; i < info->numSegments; i++) {
+    int flags = fcntl(info->fds[i], F_GETFL);
+    if (flags >= 0) {
+      fcntl(info->fds[i], F_SETFL, flags & ~O_DIRECT);
+    }
+  }
+  info->direct = 0;
+}
+
+// the space reserved ahead of the end of a page file when it grows past the 
+// space reserved before: the larger of growthChunk pages and growthPercent
+// percent of its pages
+static int growthChunk = 256;
+static int growthPercent = 10;
+
+// The setGrowthChunk function selects how much space is reserved on disk 
+// ahead of the end of a page file whenever it grows past the space reserved
+// so far: the larger of chunkPages pages and percent percent of the pages of
+// the file, 1 MiB and 10% by default. The reserved space is not part of the
+// file, it keeps the pages appended later close together and makes their
+// extension cheap. 0 and 0 reserve nothing ahead.
+RC setGrowthChunk(int chunkPages, int percent) {
+  if (chunkPages < 0 || percent < 0) {
+    return RC_PARAMS_ERROR;
+  }
+  growthChunk = chunkPages;
+  growthPercent = percent;
+  return RC_OK;
+}
+
+// Grow a segment file from oldPages to newPages pages in one step, the new
+// pages read as zero bytes. If the pages up to reservedPages already have
+// space reserved, only the file size changes. Otherwise space is reserved up
+// to reservePages pages if the file system can do it without changing the 
+// file size, and the new pages are allocated. Pages are pageSize bytes long.
+static RC extendSegment(int fd, int pageSize, int oldPages, int newPages, int reservedPages, int reservePages) {
+  int err = 0;
+#ifdef FALLOC_FL_KEEP_SIZE
+  if (newPages > reservedPages && reservePages > newPages) {
+    if (fallocate(fd, FALLOC_FL_KEEP_SIZE, (off_t) oldPages * pageSize,
+                  (off_t) (reservePages - oldPages) * pageSize) == 0) {
+      reservedPages = reservePages;
+    }
+  }
+  if (newPages <= reservedPages) {
+    err = (ftruncate(fd, (off_t) newPages * pageSize) == 0) ? 0 : errno;
+    return (err == 0) ? RC_OK : RC_WRITE_FAILED;
+  }
+#endif
+
+  // allocate the new pages, a file system that cannot allocate space ahead
+  // of writes gets a sparse extension instead
+  err = posix_fallocate(fd, (off_t) oldPages * pageSize, (off_t) (newPages - oldPages) * pageSize);
+  if (err == EINVAL || err == EOPNOTSUPP) {
+    err = (ftruncate(fd, (off_t) newPages * pageSize) == 0) ? 0 : errno;
+  }
+  return (err == 0) ? RC_OK : RC_WRITE_FAILED;
+}
+
+// get the name of a segment file: the name of the page file for segment 0,
+// followed by "." and the segment number otherwise
+static char *getSegmentFileName(const char *fileName, int segment) {
+  char *name = (char *) malloc(strlen(fileName) + 16);
+  if (segment == 0) {
+    strcpy(name, fileName);
+  } else {
+    sprintf(name, "%s.%i", fileName, segment);
+  }
+  return name;
+}
+
+// remove the segment files from segment first on, stopping at the first
+// segment that does not exist
+static void removeSegmentFiles(const char *fileName, int first) {
+  for (int segment = first; ; segment++) {
+    char *name = getSegmentFileName(fileName, segment);
+    int removed = remove(name);
+    free(name);
+    if (removed != 0) {
+      break;
+    }
+  }
+}
+
+// get the file descriptor of the segment storing a page and the offset of the
+// page in it, -1 if the file is not open or has no such segment
+static int locatePage(SM_FileHandle *fHandle, int pageNum, off_t *offset) {
+  SM_FileInfo *info = fHandle->mgmtInfo;
+  if (info == NULL) {
+    return -1;
+  }
+  int segment = 0;
+  off_t page = pageNum;
+  if (info->segmentPages > 0) {
+    segment = pageNum / info->segmentPages;
+    page = pageNum % info->segmentPages;
+  }
+  if (segment >= info->numSegments) {
+    return -1;
+  }
+  if (segment == 0) {
+    page += info->headerPages;
+  }
+  *offset = page * info->pageSize;
+  return info->fds[segment];
+}
+
+// create the file of the segment after the last one and open it
+static RC addSegment(SM_FileHandle *fHandle) {
+  SM_FileInfo *info = fHandle->mgmtInfo;
+  char *name = getSegmentFileName(fHandle->fileName, info->numSegments);
+  int direct = info->direct;
+  int fd = openSegment(name, O_RDWR | O_CREAT | O_TRUNC, &direct);
+  free(name);
+  if (fd < 0) {
+    return RC_WRITE_FAILED;
+  }
+  if (direct != info->direct) {
+    dropDirectIO(info);
+  }
+  info->fds = (int *) realloc(info->fds, (info->numSegments + 1) * sizeof(int));
+  info->fds[info->numSegments++] = fd;
+
+  // the new file is only durable once its directory is synced
+  __atomic_store_n(&info->newSegments, 1, __ATOMIC_RELAXED);
+  return RC_OK;
+}
+
+// sync the directory of a page file, which makes the creation of its segment
+// files durable
+static RC syncDirectory(const char *fileName) {
+  char *dir = strdup(fileName);
+  char *slash = strrchr(dir, '/');
+  if (slash == NULL) {
+    strcpy(dir, ".");
+  } else {
+    slash[slash == dir] = '\0';
+  }
+  int fd = open(dir, O_RDONLY | O_DIRECTORY);
+  free(dir);
+  if (fd < 0) {
+    return RC_WRITE_FAILED;
+  }
+  int err = fsync(fd);
+  close(fd);
+  return (err == 0) ? RC_OK : RC_WRITE_FAILED;
+}
+
+// make the segments created since the last sync durable
+static RC syncNewSegments(SM_FileInfo *info, const char *fileName) {
+  if (__atomic_exchange_n(&info->newSegments, 0, __ATOMIC_RELAXED) && syncDirectory(fileName) != RC_OK) {
+    __atomic_store_n(&info->newSegments, 1, __ATOMIC_RELAXED);
+    return RC_WRITE_FAILED;
+  }
+  return RC_OK;
+}
+
+// make a write to the segment fd durable in SM_DURABILITY_SYNC mode
+static RC syncWrite(SM_FileInfo *info, const char *fileName, int fd) {
+  if (info->durability != SM_DURABILITY_SYNC) {
+    return RC_OK;
+  }
+  if (fdatasync(fd) != 0) {
+    return RC_WRITE_FAILED;
+  }
+  __atomic_add_fetch(&info->numSyncs, 1, __ATOMIC_RELAXED);
+  return syncNewSegments(info, fileName);
+}
+
+// read or write the buffers of iov from offset on, retrying the transfers
+// that are interrupted or cut short. Return the number of bytes transferred,
+// which is less than requested only at the end of the file or on an error.
+// The buffers of iov are advanced past the bytes transferred.
+static ssize_t transferVector(int fd, off_t offset, struct iovec *iov, int cnt, int write) {
+  ssize_t done = 0;
+  while (cnt > 0) {
+    ssize_t n = write ? pwritev(fd, iov, cnt, offset + done)
+                      : preadv(fd, iov, cnt, offset + done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      break;
+    }
+    done += n;
+
+    // skip the buffers that are done and advance into the next one
+    while (cnt > 0 && (size_t) n >= iov->iov_len) {
+      n -= iov->iov_len;
+      iov++;
+      cnt--;
+    }
+    if (cnt > 0) {
+      iov->iov_base = (char *) iov->iov_base + n;
+      iov->iov_len -= n;
+    }
+  }
+  return done;
+}
+
+// allocate a page aligned for direct I/O, filled with '\0' bytes
+static char *allocAlignedPage(void) {
+  char *page = NULL;
+  if (posix_memalign((void **) &page, DIRECT_IO_ALIGNMENT, PAGE_SIZE) != 0) {
+    return NULL;
+  }
+  memset(page, 0, PAGE_SIZE);
+  return page;
+}
+
+// the checksum of a page of pageSize bytes, over the bytes in front of its
+// trailer
+static uint32_t pageChecksum(const char *page, int pageSize) {
+  return crc32c(0, page, pageSize - PAGE_CHECKSUM_SIZE);
+}
+
+// store the checksum of the page written from page into its trailer at dest
+static void storeChecksum(char *dest, const char *page, int pageSize) {
+  uint32_t crc = pageChecksum(page, pageSize);
+  memcpy(dest, &crc, PAGE_CHECKSUM_SIZE);
+}
+
+// check a page that was read against the checksum in its trailer. A page that
+// was never written is all '\0' bytes, its trailer too.
+static RC verifyPage(const char *page, int pageSize) {
+  uint32_t stored;
+  memcpy(&stored, page + pageSize - PAGE_CHECKSUM_SIZE, PAGE_CHECKSUM_SIZE);
+  if (stored == pageChecksum(page, pageSize)) {
+    return RC_OK;
+  }
+  if (stored == 0) {
+    int i = 0;
+    while (i < pageSize && page[i] == 0) {
+      i++;
+    }
+    if (i == pageSize) {
+      return RC_OK;
+    }
+  }
+  return RC_CHECKSUM_MISMATCH;
+}
+
+// check count pages that were read
+static RC verifyPages(SM_PageHandle pages[], int count, int pageSize) {
+  for (int i = 0; i < count; i++) {
+    if (verifyPage(pages[i], pageSize) != RC_OK) {
+      return RC_CHECKSUM_MISMATCH;
+    }
+  }
+  return RC_OK;
+}
+
+// fill in the header of a new file
+static void initHeader(char *header, int pageSize, int segmentPages) {
+  SM_FileHeader *h = (SM_FileHeader *) header;
+  memcpy(h->magic, PAGE_FILE_MAGIC, sizeof(h->magic));
+  h->version = PAGE_FILE_VERSION;
+  h->pageSize = pageSize;
+  h->pageCount = 1;
+  h->freeListHead = -1;
+  h->flags = (pageChecksums ? PAGE_FILE_CHECKSUMS : 0) | (pageCompression ? PAGE_FILE_COMPRESSED : 0);
+  h->segmentPages = segmentPages;
+}
+
+// write the header of a file after its page count or segment size changed
+static RC writeHeader(SM_FileHandle *fHandle) {
+  SM_FileInfo *info = fHandle->mgmtInfo;
+  if (info->header == NULL) {
+    return RC_OK;
+  }
+  SM_FileHeader *h = (SM_FileHeader *) info->header;
+  h->pageCount = fHandle->totalNumPages;
+  h->segmentPages = info->segmentPages;
+
+  // only the used part of the header page is written
+  struct iovec iov = { info->header, PAGE_SIZE };
+  if (transferVector(info->fds[0], 0, &iov, 1, 1) != PAGE_SIZE) {
+    return RC_WRITE_FAILED;
+  }
+  return syncWrite(info, fHandle->fileName, info->fds[0]);
+}
+
+// map the pages of a mapped file that are not mapped yet at their place in
+// its address range, with one mapping for the new pages of each segment
+static RC mapPages(SM_FileHandle *fHandle) {
+  SM_FileInfo *info = fHandle->mgmtInfo;
+  if (info->map == NULL) {
+    return RC_OK;
+  }
+  int last = (fHandle->totalNumPages < info->mapLimit) ? fHandle->totalNumPages : info->mapLimit;
+  while (info->mappedPages < last) {
+    off_t offset;
+    int pageNum = info->mappedPages;
+    int fd = locatePage(fHandle, pageNum, &offset);
+    if (fd < 0) {
+      return RC_FILE_NOT_FOUND;
+    }
+    int cnt = last - pageNum;
+    if (info->segmentPages > 0 && cnt > info->segmentPages - pageNum % info->segmentPages) {
+      cnt = info->segmentPages - pageNum % info->segmentPages;
+    }
+    if (mmap(info->map + (size_t) pageNum * info->pageSize, (size_t) cnt * info->pageSize, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_FIXED, fd, offset) == MAP_FAILED) {
+      return RC_ALLOC_MEM_FAIL;
+    }
+    info->mappedPages += cnt;
+  }
+  return RC_OK;
+}
+
+// the page map of a compressed file, to be freed by the caller
+static char *getMapFileName(const char *fileName) {
+  char *name = (char *) malloc(strlen(fileName) + 5);
+  sprintf(name, "%s.map", fileName);
+  return name;
+}
+
+// the offset in the data file of the slot at offset in the slot area
+static off_t slotOffset(SM_FileInfo *info, uint32_t offset) {
+  return (off_t) info->headerPages * info->pageSize + (off_t) offset * SLOT_UNIT;
+}
+
+// make room in the page map for numPages pages, the new ones were never
+// written
+static RC growPageMap(SM_FileInfo *info, int numPages) {
+  if (numPages <= info->slotCapacity) {
+    return RC_OK;
+  }
+  size_t capacity = (info->slotCapacity > 0) ? info->slotCapacity : 64;
+  while (capacity < (size_t) numPages) {
+    capacity *= 2;
+  }
+  SM_PageSlot *slots = (SM_PageSlot *) realloc(info->slots, capacity * sizeof(SM_PageSlot));
+  if (slots == NULL) {
+    return RC_ALLOC_MEM_FAIL;
+  }
+  memset(slots + info->slotCapacity, 0, (capacity - info->slotCapacity) * sizeof(SM_PageSlot));
+  info->slots = slots;
+  info->slotCapacity = (int) capacity;
+  return RC_OK;
+}
+
+// add the slot at offset of the given units to the free slots
+static void freeSlot(SM_FileInfo *info, uint32_t offset, uint32_t units) {
+  SM_SlotList *list = &info->freeSlots[units];
+  if (list->count == list->capacity) {
+    list->capacity = (list->capacity > 0) ? list->capacity * 2 : 16;
+    list->offsets = (uint32_t *) realloc(list->offsets, list->capacity * sizeof(uint32_t));
+  }
+  list->offsets[list->count++] = offset;
+}
+
+// free the space of the slot area from start to end, in slots of a page at most
+static void freeSlotRange(SM_FileInfo *info, uint32_t start, uint32_t end) {
+  uint32_t maxUnits = info->pageSize / SLOT_UNIT;
+  while (start < end) {
+    uint32_t units = (end - start < maxUnits) ? end - start : maxUnits;
+    freeSlot(info, start, units);
+    start += units;
+  }
+}
+
+// take a slot of *units units at least: a free slot of the smallest size that
+// fits, or a new one at the end of the slot area. *units is set to its size.
+static uint32_t allocSlot(SM_FileInfo *info, uint32_t *units) {
+  uint32_t maxUnits = info->pageSize / SLOT_UNIT;
+  for (uint32_t size = *units; size <= maxUnits; size++) {
+    SM_SlotList *list = &info->freeSlots[size];
+    if (list->count > 0) {
+      *units = size;
+      return list->offsets[--list->count];
+    }
+  }
+  uint32_t offset = info->slotEnd;
+  info->slotEnd += *units;
+  return offset;
+}
+
+static int compareSlots(const void *a, const void *b) {
+  uint32_t x = ((const SM_PageSlot *) a)->offset, y = ((const SM_PageSlot *) b)->offset;
+  return (x > y) - (x < y);
+}
+
+// find the free slots of a compressed file again: the gaps between the slots
+// of its first numSlots pages, and the space after them up to areaUnits. The
+// slot area ends after the last of both.
+static RC findFreeSlots(SM_FileInfo *info, int numSlots, uint32_t areaUnits) {
+  uint32_t maxUnits = info->pageSize / SLOT_UNIT;
+  SM_PageSlot *used = (SM_PageSlot *) malloc((numSlots + 1) * sizeof(SM_PageSlot));
+  if (used == NULL) {
+    return RC_ALLOC_MEM_FAIL;
+  }
+  int numUsed = 0;
+  for (int i = 0; i < numSlots; i++) {
+    if (info->slots[i].units > 0) {
+      used[numUsed++] = info->slots[i];
+    }
+  }
+  qsort(used, numUsed, sizeof(SM_PageSlot), compareSlots);
+
+  if (info->freeSlots == NULL) {
+    info->freeSlots = (SM_SlotList *) calloc(maxUnits + 1, sizeof(SM_SlotList));
+  }
+  for (uint32_t units = 0; units <= maxUnits; units++) {
+    info->freeSlots[units].count = 0;
+  }
+  uint32_t end = 0;
+  for (int i = 0; i < numUsed; i++) {
+    freeSlotRange(info, end, used[i].offset);
+    if (used[i].offset + used[i].units > end) {
+      end = used[i].offset + used[i].units;
+    }
+  }
+  free(used);
+  if (areaUnits > end) {
+    freeSlotRange(info, end, areaUnits);
+    end = areaUnits;
+  }
+  info->slotEnd = end;
+  return RC_OK;
+}
+
+// open the page map of a compressed file, read it and find the free slots
+// between the slots of its pages
+static RC openPageMap(SM_FileHandle *fHandle) {
+  SM_FileInfo *info = fHandle->mgmtInfo;
+  char *name = getMapFileName(fHandle->fileName);
+  info->mapFd = open(name, O_RDWR);
+  free(name);
+  struct stat st;
+  if (info->mapFd < 0 || fstat(info->mapFd, &st) != 0) {
+    return RC_FILE_NOT_FOUND;
+  }
+  RC rc = growPageMap(info, fHandle->totalNumPages);
+  if (rc != RC_OK) {
+    return rc;
+  }
+
+  // the map ends after the last page that was written
+  int numSlots = (int) (st.st_size / sizeof(SM_PageSlot));
+  if (numSlots > fHandle->totalNumPages) {
+    numSlots = fHandle->totalNumPages;
+  }
+  struct iovec iov = { info->slots, numSlots * sizeof(SM_PageSlot) };
+  if (transferVector(info->mapFd, 0, &iov, 1, 0) != (ssize_t) (numSlots * sizeof(SM_PageSlot))) {
+    return RC_READ_NON_EXISTING_PAGE;
+  }
+
+  // the slots must fit the pages they hold
+  uint32_t maxUnits = info->pageSize / SLOT_UNIT;
+  for (int i = 0; i < numSlots; i++) {
+    SM_PageSlot *slot = &info->slots[i];
+    if (slot->units > maxUnits || slot->length > slot->units * SLOT_UNIT || (slot->length == 0) != (slot->units == 0)) {
+      return RC_FILE_FORMAT_UNSUPPORTED;
+    }
+  }
+
+  // the space up to the end of the data file is part of the slot area
+  if (fstat(info->fds[0], &st) != 0) {
+    return RC_READ_NON_EXISTING_PAGE;
+  }
+  off_t slotArea = st.st_size - (off_t) info->headerPages * info->pageSize;
+  return findFreeSlots(info, numSlots, (slotArea > 0) ? (uint32_t) (slotArea / SLOT_UNIT) : 0);
+}
+
+// read a page of a compressed file into memPage, through packed which has
+// room for a page
+static RC readCompressedPage(SM_FileInfo *info, int pageNum, char *memPage, char *packed) {
+  int pageSize = info->pageSize;
+
+  // a page stored as it is is read into memPage directly
+  pthread_rwlock_rdlock(&info->slotLatch);
+  SM_PageSlot slot = info->slots[pageNum];
+  ssize_t n = 0;
+  if (slot.length > 0) {
+    struct iovec iov = { ((int) slot.length == pageSize) ? memPage : packed, slot.length };
+    n = transferVector(info->fds[0], slotOffset(info, slot.offset), &iov, 1, 0);
+  }
+  pthread_rwlock_unlock(&info->slotLatch);
+  if (n != (ssize_t) slot.length) {
+    return RC_READ_NON_EXISTING_PAGE;
+  }
+
+  if (slot.length == 0) {
+    memset(memPage, 0, pageSize);
+  } else if ((int) slot.length < pageSize && lzDecompress(packed, slot.length, memPage, pageSize) != pageSize) {
+    return RC_CHECKSUM_MISMATCH;
+  }
+  return info->checksums ? verifyPage(memPage, pageSize) : RC_OK;
+}
+
+// compress a page of a compressed file and write it to its slot, through
+// scratch which has room for two pages. The slot is written before the page
+// map points to it.
+static RC writeCompressedPage(SM_FileHandle *fHandle, int pageNum, const char *memPage, char *scratch) {
+  SM_FileInfo *info = fHandle->mgmtInfo;
+  int pageSize = info->pageSize;
+  const char *image = memPage;
+  if (info->checksums) {
+    char *copy = scratch + pageSize;
+    memcpy(copy, memPage, pageSize - PAGE_CHECKSUM_SIZE);
+    storeChecksum(copy + pageSize - PAGE_CHECKSUM_SIZE, memPage, pageSize);
+    image = copy;
+  }
+
+  // a page that does not get smaller is stored as it is
+  const char *data = scratch;
+  int length = lzCompress(image, pageSize, scratch, pageSize - 1);
+  if (length == 0) {
+    data = image;
+    length = pageSize;
+  }
+
+  // a page that no longer fits its slot moves to another one
+  pthread_rwlock_wrlock(&info->slotLatch);
+  SM_PageSlot *slot = &info->slots[pageNum];
+  uint32_t units = (length + SLOT_UNIT - 1) / SLOT_UNIT;
+  if (units > slot->units) {
+    if (slot->units > 0) {
+      freeSlot(info, slot->offset, slot->units);
+    }
+    slot->offset = allocSlot(info, &units);
+    slot->units = units;
+  }
+  slot->length = length;
+  RC rc = RC_OK;
+  struct iovec iov = { (void *) data, length };
+  if (transferVector(info->fds[0], slotOffset(info, slot->offset), &iov, 1, 1) != length) {
+    rc = RC_WRITE_FAILED;
+  } else {
+    struct iovec entry = { slot, sizeof(SM_PageSlot) };
+    if (transferVector(info->mapFd, (off_t) pageNum * sizeof(SM_PageSlot), &entry, 1, 1) != sizeof(SM_PageSlot)) {
+      rc = RC_WRITE_FAILED;
+    }
+  }
+  pthread_rwlock_unlock(&info->slotLatch);
+
+  if (rc == RC_OK) {
+    rc = syncWrite(info, fHandle->fileName, info->fds[0]);
+  }
+  if (rc == RC_OK) {
+    rc = syncWrite(info, fHandle->fileName, info->mapFd);
+  }
+  return rc;
+}
+
+// read or write count pages of a compressed file from startPage on, one page
+// at a time
+static RC transferCompressedPages(int startPage, int count, SM_FileHandle *fHandle, SM_PageHandle pages[], int write) {
+  SM_FileInfo *info = fHandle->mgmtInfo;
+  char *scratch = (char *) malloc(2 * (size_t) info->pageSize);
+  if (scratch == NULL) {
+    return write ? RC_WRITE_FAILED : RC_READ_NON_EXISTING_PAGE;
+  }
+  RC rc = RC_OK;
+  for (int i = 0; i < count && rc == RC_OK; i++) {
+    rc = write ? writeCompressedPage(fHandle, startPage + i, pages[i], scratch)
+               : readCompressedPage(info, startPage + i, pages[i], scratch);
+  }
+  free(scratch);
+  return rc;
+}
+
+// 1 if every one of the count pages is in a buffer that direct I/O accepts
+static int pagesAligned(SM_PageHandle pages[], int count) {
+  for (int i = 0; i < count; i++) {
+    if ((uintptr_t) pages[i] % DIRECT_IO_ALIGNMENT != 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// read or write count pages from startPage on, with one preadv or pwritev for
+// the pages of each segment, or of each IOV_MAX pages. With direct I/O, pages
+// in unaligned buffers are moved through an aligned copy. Pages of a mapped
+// file are copied from or to the mapping.
+//
+// With checksums, the trailer of a written page is taken from checksums
+// instead of the buffer, which is left as it is, and a page that is read is
+// checked once it is in its buffer.
+static RC transferPages(int startPage, int count, SM_FileHandle *fHandle, SM_PageHandle pages[], int write) {
+  SM_FileInfo *info = fHandle->mgmtInfo;
+  if (info->compressed) {
+    return transferCompressedPages(startPage, count, fHandle, pages, write);
+  }
+  struct iovec iov[IOV_MAX];
+  uint32_t checksums[IOV_MAX / 2];
+  int pageSize = info->pageSize;
+  int dataSize = info->checksums ? pageSize - PAGE_CHECKSUM_SIZE : pageSize;
+  int done = 0;
+
+  while (done < count) {
+    off_t offset;
+    int pageNum = startPage + done;
+
+    // mapped pages are copied from or to the mapping. Written pages are 
+    // scheduled for write back like pwrite does, msync does not wait for it.
+    if (pageNum < info->mappedPages) {
+      int cnt = count - done;
+      if (cnt > info->mappedPages - pageNum) {
+        cnt = info->mappedPages - pageNum;
+      }
+      char *mapped = info->map + (size_t) pageNum * pageSize;
+      for (int i = 0; i < cnt; i++) {
+        if (write) {
+          memcpy(mapped + (size_t) i * pageSize, pages[done + i], dataSize);
+          if (info->checksums) {
+            storeChecksum(mapped + (size_t) i * pageSize + dataSize, pages[done + i], pageSize);
+          }
+        } else {
+          memcpy(pages[done + i], mapped + (size_t) i * pageSize, pageSize);
+        }
+      }
+      if (write && msync(mapped, (size_t) cnt * pageSize, MS_ASYNC) != 0) {
+        return RC_WRITE_FAILED;
+      }
+      if (!write && info->checksums && verifyPages(pages + done, cnt, pageSize) != RC_OK) {
+        return RC_CHECKSUM_MISMATCH;
+      }
+      if (write) {
+        off_t offset;
+        RC rc = syncWrite(info, fHandle->fileName, locatePage(fHandle, pageNum, &offset));
+        if (rc != RC_OK) {
+          return rc;
+        }
+      }
+      done += cnt;
+      continue;
+    }
+
+    int fd = locatePage(fHandle, pageNum, &offset);
+    if (fd < 0) {
+      return RC_FILE_NOT_FOUND;
+    }
+
+    // stop at the end of the segment
+    int cnt = count - done;
+    if (info->segmentPages > 0 && cnt > info->segmentPages - pageNum % info->segmentPages) {
+      cnt = info->segmentPages - pageNum % info->segmentPages;
+    }
+    if (cnt > IOV_MAX / 2) {
+      cnt = IOV_MAX / 2;
+    }
+
+    // direct I/O writes whole aligned pages, so the checksums go into a copy
+    char *bounce = NULL;
+    if (info->direct && (!pagesAligned(pages + done, cnt) || (write && info->checksums))) {
+      if (posix_memalign((void **) &bounce, DIRECT_IO_ALIGNMENT, (size_t) cnt * pageSize) != 0) {
+        return write ? RC_WRITE_FAILED : RC_READ_NON_EXISTING_PAGE;
+      }
+    }
+
+    // a written page with a checksum takes two buffers, its data and its trailer
+    int numIov = 0;
+    for (int i = 0; i < cnt; i++) {
+      if (bounce != NULL) {
+        char *copy = bounce + (size_t) i * pageSize;
+        if (write) {
+          memcpy(copy, pages[done + i], dataSize);
+          if (info->checksums) {
+            storeChecksum(copy + dataSize, pages[done + i], pageSize);
+          }
+        }
+        iov[numIov].iov_base = copy;
+        iov[numIov++].iov_len = pageSize;
+      } else if (write && info->checksums) {
+        checksums[i] = pageChecksum(pages[done + i], pageSize);
+        iov[numIov].iov_base = pages[done + i];
+        iov[numIov++].iov_len = dataSize;
+        iov[numIov].iov_base = &checksums[i];
+        iov[numIov++].iov_len = PAGE_CHECKSUM_SIZE;
+      } else {
+        iov[numIov].iov_base = pages[done + i];
+        iov[numIov++].iov_len = pageSize;
+      }
+    }
+    ssize_t n = transferVector(fd, offset, iov, numIov, write);
+    if (bounce && !write && n == (ssize_t) cnt * pageSize) {
+      for (int i = 0; i < cnt; i++) {
+        memcpy(pages[done + i], bounce + (size_t) i * pageSize, pageSize);
+      }
+    }
+    free(bounce);
+    if (n != (ssize_t) cnt * pageSize) {
+      return write ? RC_WRITE_FAILED : RC_READ_NON_EXISTING_PAGE;
+    }
+    if (!write && info->checksums && verifyPages(pages + done, cnt, pageSize) != RC_OK) {
+      return RC_CHECKSUM_MISMATCH;
+    }
+    if (write) {
+      RC rc = syncWrite(info, fHandle->fileName, fd);
+      if (rc != RC_OK) {
+        return rc;
+      }
+    }
+    done += cnt;
+  }
+  return RC_OK;
+}
+
+// the pages each page of the free page map has a bit for
+static int freeMapBits(SM_FileInfo *info) {
+  return (info->pageSize - (int) sizeof(SM_FreeMapHeader) - PAGE_CHECKSUM_SIZE) * 8;
+}
+
+// make room for the maps of numRanges ranges of pages, the new ones have no map
+static RC growFreeMaps(SM_FileInfo *info, int numRanges) {
+  if (numRanges <= info->numFreeMaps) {
+    return RC_OK;
+  }
+  int *pages = (int *) realloc(info->freeMapPages, numRanges * sizeof(int));
+  if (pages == NULL) {
+    return RC_ALLOC_MEM_FAIL;
+  }
+  info->freeMapPages = pages;
+  char **maps = (char **) realloc(info->freeMaps, numRanges * sizeof(char *));
+  if (maps == NULL) {
+    return RC_ALLOC_MEM_FAIL;
+  }
+  info->freeMaps = maps;
+  for (int i = info->numFreeMaps; i < numRanges; i++) {
+    pages[i] = -1;
+    maps[i] = NULL;
+  }
+  info->numFreeMaps = numRanges;
+  return RC_OK;
+}
+
+// read the pages of the free page map of a file with a header, following the
+// chain from the header
+static RC loadFreeMap(SM_FileHandle *fHandle) {
+  SM_FileInfo *info = fHandle->mgmtInfo;
+  int bits = freeMapBits(info);
+  int pageNum = ((SM_FileHeader *) info->header)->freeListHead;
+  int numMaps = 0;
+  while (pageNum >= 0) {
+    // a chain that leaves the file or goes round in circles is not ours
+    if (pageNum >= fHandle->totalNumPages || numMaps++ >= fHandle->totalNumPages) {
+      return RC_FILE_FORMAT_UNSUPPORTED;
+    }
+    char *map = (char *) malloc(info->pageSize);
+    if (map == NULL) {
+      return RC_ALLOC_MEM_FAIL;
+    }
+    SM_FreeMapHeader *m = (SM_FreeMapHeader *) map;
+    RC rc = transferPages(pageNum, 1, fHandle, &map, 0);
+    if (rc == RC_OK && (m->firstPage < 0 || m->firstPage % bits != 0 || m->firstPage / bits != pageNum / bits)) {
+      rc = RC_FILE_FORMAT_UNSUPPORTED;
+    }
+    if (rc == RC_OK) {
+      rc = growFreeMaps(info, pageNum / bits + 1);
+    }
+    if (rc == RC_OK && info->freeMaps[pageNum / bits] != NULL) {
+      rc = RC_FILE_FORMAT_UNSUPPORTED;
+    }
+    if (rc != RC_OK) {
+      free(map);
+      return rc;
+    }
+    int range = pageNum / bits;
+    info->freeMaps[range] = map;
+    info->freeMapPages[range] = pageNum;
+
+    unsigned char *bitmap = (unsigned char *) map + sizeof(SM_FreeMapHeader);
+    for (int i = 0; i < bits / 8; i++) {
+      info->numFreePages += __builtin_popcount(bitmap[i]);
+    }
+    pageNum = m->next;
+  }
+  return RC_OK;
+}
+
+// open the segments of a file with a header, as many as its pages need
+static RC openHeaderSegments(SM_FileHandle *fHandle) {
+  SM_FileInfo *info = fHandle->mgmtInfo;
+  SM_FileHeader *h = (SM_FileHeader *) info->header;
+  if (h->version > PAGE_FILE_VERSION || !validPageSize(h->pageSize) || h->pageCount < 0 || h->segmentPages < 0 ||
+      (h->flags & ~(PAGE_FILE_CHECKSUMS | PAGE_FILE_COMPRESSED)) != 0 ||
+      ((h->flags & PAGE_FILE_COMPRESSED) && h->segmentPages != 0)) {
+    return RC_FILE_FORMAT_UNSUPPORTED;
+  }
+  info->pageSize = h->pageSize;
+  fHandle->pageSize = h->pageSize;
+  info->checksums = (h->flags & PAGE_FILE_CHECKSUMS) != 0;
+  info->compressed = (h->flags & PAGE_FILE_COMPRESSED) != 0;
+  fHandle->totalNumPages = h->pageCount;
+  info->segmentPages = h->segmentPages;
+
+  int numSegments = 1;
+  if (info->segmentPages > 0 && h->pageCount > info->segmentPages) {
+    numSegments = (h->pageCount + info->segmentPages - 1) / info->segmentPages;
+  }
+  while (info->numSegments < numSegments) {
+    int direct = info->direct;
+    char *name = getSegmentFileName(fHandle->fileName, info->numSegments);
+    int fd = openSegment(name, O_RDWR, &direct);
+    free(name);
+    if (fd < 0) {
+      return RC_FILE_NOT_FOUND;
+    }
+    info->fds = (int *) realloc(info->fds, (info->numSegments + 1) * sizeof(int));
+    info->fds[info->numSegments++] = fd;
+    if (direct != info->direct) {
+      dropDirectIO(info);
+    }
+  }
+
+  // a compressed file is read and written through the page cache, the slots
+  // of its pages are not aligned
+  if (info->compressed) {
+    if (info->direct) {
+      dropDirectIO(info);
+    }
+    return openPageMap(fHandle);
+  }
+
+  // a file in a single segment takes the segment size selected now if it
+  // still fits in it, the header records it once the file grows
+  if (info->segmentPages == 0 && fHandle->totalNumPages <= segmentSize) {
+    info->segmentPages = segmentSize;
+  }
+  return RC_OK;
+}
+
+// count the pages of a file without a header from the size of its segments
+static RC measureSegments(SM_FileHandle *fHandle) {
+  SM_FileInfo *info = fHandle->mgmtInfo;
+  struct stat st;
+  if (fstat(info->fds[0], &st) != 0) {
+    return RC_READ_NON_EXISTING_PAGE;
+  }
+
+  // measure total pages over all segments
+  int firstPages = (int) (st.st_size / info->pageSize);
+  fHandle->totalNumPages = firstPages;
+  while (1) {
+    int direct = info->direct;
+    char *name = getSegmentFileName(fHandle->fileName, info->numSegments);
+    int fd = openSegment(name, O_RDWR, &direct);
+    free(name);
+    if (fd < 0) {
+      break;
+    }
+    if (fstat(fd, &st) != 0) {
+      close(fd);
+      return RC_READ_NON_EXISTING_PAGE;
+    }
+    info->fds = (int *) realloc(info->fds, (info->numSegments + 1) * sizeof(int));
+    info->fds[info->numSegments++] = fd;
+    fHandle->totalNumPages += (int) (st.st_size / info->pageSize);
+    if (direct != info->direct) {
+      dropDirectIO(info);
+    }
+  }
+
+  // the first segment of a segmented file is full, a file in a single 
+  // segment takes the segment size selected now if it still fits in it
+  if (info->numSegments > 1) {
+    info->segmentPages = firstPages;
+  } else {
+    info->segmentPages = (firstPages <= segmentSize) ? segmentSize : 0;
+  }
+  return RC_OK;
+}
+
+// Instantiate the storage manager by printing a message to standard out.
+void initStorageManager(void) {
+  printf("The program begins to initialize storage manager.\n");
+}
+
+// The createPageFile function is to create a new page file with one page size.
+// This page file fills with '\0' bytes. It starts with a header page that 
+// describes the file and is not counted as one of its pages. The pages are of
+// the size selected with setPageSize, PAGE_SIZE by default. A compressed file,
+// see setPageCompression, stores no page until it is written, and starts with
+// an empty page map.
+RC createPageFile(char *fileName) {
+  // validates parameters
+  if (fileName == NULL) {
+    return RC_FILE_NOT_FOUND;
+  }
+
+  // creates a non-null file pointer
+  FILE *fp = fopen(fileName, "w+");
+  if (fp == NULL) {
+    return RC_FILE_NOT_FOUND;
+  }
+
+  // writes the header page, then one page filled with '\0' bytes
+  char *str = (char *) calloc(newPageSize, sizeof(char));
+  initHeader(str, newPageSize, pageCompression ? 0 : segmentSize);
+  fwrite(str, sizeof(char), newPageSize, fp);
+  if (!pageCompression) {
+    memset(str, 0, newPageSize);
+    fwrite(str, sizeof(char), newPageSize, fp);
+  }
+
+  // closes file, flushes buffers, deallocates memory
+  fclose(fp);
+  free(str);
+  if(fp) {
+    fp = NULL;
+  }
+
+  // the segments and page map of a former file with this name must not be
+  // taken for ours
+  removeSegmentFiles(fileName, 1);
+  char *mapName = getMapFileName(fileName);
+  if (pageCompression) {
+    fp = fopen(mapName, "w");
+    if (fp != NULL) {
+      fclose(fp);
+    }
+  } else {
+    remove(mapName);
+  }
+  free(mapName);
+  return (pageCompression && fp == NULL) ? RC_FILE_NOT_FOUND : RC_OK;
+}
+
+// The openPageFile function is to open an existing file and get statistic data
+// and store those to the file handle.
+//
+// - If the file doesn't exist, return RC_FILE_NOT_FOUND.
+// - If opening the file is successful, then the files of this file handle is
+//   initialized with the information about the opened file.
+//
+// For example, the information about the opened file may contain file name,
+// total number of pages, current page position
+//
+// The number of pages and segments is read from the header page. A file 
+// without a header is measured from the size of its segments instead.
+//
+// - If the header is of a later format version or another page size, or has
+//   flags this version does not know, return RC_FILE_FORMAT_UNSUPPORTED.
+RC openPageFile(char *fileName, SM_FileHandle *fHandle) {
+  // validates parameters
+  if (fileName == NULL) {
+    return RC_FILE_NOT_FOUND;
+  }
+
+  if (fHandle == NULL) {
+    return RC_FILE_HANDLE_NOT_INIT;
+  }
+
+  // opens the file for reading and writing, bypassing the page cache if
+  // direct I/O is selected and the file system supports it
+  int direct = directIO;
+  int fd = openSegment(fileName, O_RDWR, &direct);
+  if (fd < 0) {
+    return RC_FILE_NOT_FOUND;
+  }
+
+  // stores file information, reset position
+  SM_FileInfo *info = (SM_FileInfo *) malloc(sizeof(SM_FileInfo));
+  info->fds = (int *) malloc(sizeof(int));
+  info->fds[0] = fd;
+  info->numSegments = 1;
+  info->pageSize = PAGE_SIZE;
+  info->header = NULL;
+  info->headerPages = 0;
+  info->reservedPages = 0;
+  info->direct = direct;
+  info->checksums = 0;
+  info->map = NULL;
+  info->mappedPages = 0;
+  info->mapLimit = 0;
+  info->async = NULL;
+  info->compressed = 0;
+  info->mapFd = -1;
+  info->slots = NULL;
+  info->slotCapacity = 0;
+  info->freeSlots = NULL;
+  info->slotEnd = 0;
+  pthread_rwlock_init(&info->slotLatch, NULL);
+  info->numFreeMaps = 0;
+  info->freeMapPages = NULL;
+  info->freeMaps = NULL;
+  info->numFreePages = 0;
+  pthread_mutex_init(&info->freeLatch, NULL);
+  info->durability = SM_DURABILITY_NONE;
+  info->syncWindow = 0;
+  pthread_mutex_init(&info->syncLatch, NULL);
+  pthread_cond_init(&info->synced, NULL);
+  info->forceRequests = 0;
+  info->syncedRequests = 0;
+  info->syncing = 0;
+  info->newSegments = 0;
+  info->numSyncs = 0;
+  info->numForces = 0;
+  fHandle->mgmtInfo = info;
+  fHandle->fileName = fileName;
+  fHandle->curPagePos = 0;
+  fHandle->pageSize = PAGE_SIZE;
+
+  // the header tells the number of pages and segments without looking at the
+  // size of the files, a file without a header is measured
+  char *header = allocAlignedPage();
+  struct iovec iov = { header, PAGE_SIZE };
+  RC rc;
+  if (header != NULL && transferVector(fd, 0, &iov, 1, 0) == PAGE_SIZE &&
+      memcmp(header, PAGE_FILE_MAGIC, sizeof(((SM_FileHeader *) header)->magic)) == 0) {
+    info->header = header;
+    info->headerPages = 1;
+    rc = openHeaderSegments(fHandle);
+    if (rc == RC_OK) {
+      rc = loadFreeMap(fHandle);
+    }
+  } else {
+    free(header);
+    rc = measureSegments(fHandle);
+  }
+  if (rc != RC_OK) {
+    closePageFile(fHandle);
+    return rc;
+  }
+  return RC_OK;
+}
+
+// The openMappedPageFile function is to open an existing file like 
+// openPageFile and map it into memory. Its pages are copied from and to the 
+// mapping without a system call, and getBlockPointer gives access to them in
+// place. The mapping grows with the file and never moves. Where the address
+// space is too small to reserve room for the largest file, a smaller range is
+// reserved, and the pages past it are read and written without the mapping.
+//
+// - If no address range for the mapping can be reserved, the file is not
+//   opened and RC_ALLOC_MEM_FAIL is returned.
+// - If the file is compressed, its pages cannot be mapped, it is not opened
+//   and RC_FILE_FORMAT_UNSUPPORTED is returned.
+RC openMappedPageFile(char *fileName, SM_FileHandle *fHandle) {
+  RC rc = openPageFile(fileName, fHandle);
+  if (rc != RC_OK) {
+    return rc;
+  }
+  SM_FileInfo *info = fHandle->mgmtInfo;
+  if (info->compressed) {
+    closePageFile(fHandle);
+    return RC_FILE_FORMAT_UNSUPPORTED;
+  }
+
+  // the mapping is served by the page cache, bypassing it for the other
+  // transfers would only make them slower
+  if (info->direct) {
+    dropDirectIO(info);
+  }
+
+  // reserve the address range without memory behind it, the pages are mapped
+  // into it as the file grows. The range is halved as long as it is refused
+  // and still has room for the file.
+  int limit = MAPPED_RESERVE;
+  void *map;
+  while ((map = mmap(NULL, (size_t) limit * info->pageSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                     -1, 0)) == MAP_FAILED && limit / 2 >= fHandle->totalNumPages) {
+    limit /= 2;
+  }
+  if (map == MAP_FAILED) {
+    closePageFile(fHandle);
+    return RC_ALLOC_MEM_FAIL;
+  }
+  info->map = (char *) map;
+  info->mapLimit = limit;
+  rc = mapPages(fHandle);
+  if (rc != RC_OK) {
+    closePageFile(fHandle);
+  }
+  return rc;
+}
+
+// The closePageFile method is to close the current page file, removing every
+// reference to the file.
+RC closePageFile(SM_FileHandle *fHandle) {
+  // validates parameters
+  if (fHandle == NULL) {
+    return RC_FILE_HANDLE_NOT_INIT;
+  }
+  // get the file information through fHandle
+  SM_FileInfo *info = fHandle->mgmtInfo;
+  if (info == NULL) {
+    return RC_FILE_NOT_FOUND;
+  }
+  // the transfers still in flight finish before the file is closed
+  if (info->async != NULL) {
+    destroyAsyncIO(info->async);
+  }
+  if (info->map != NULL) {
+    munmap(info->map, (size_t) info->mapLimit * info->pageSize);
+  }
+  for (int i = 0; i < info->numSegments; i++) {
+    close(info->fds[i]);
+  }
+  if (info->mapFd >= 0) {
+    close(info->mapFd);
+  }
+  if (info->freeSlots != NULL) {
+    for (int i = 0; i <= info->pageSize / SLOT_UNIT; i++) {
+      free(info->freeSlots[i].offsets);
+    }
+  }
+  free(info->freeSlots);
+  free(info->slots);
+  pthread_rwlock_destroy(&info->slotLatch);
+  for (int i = 0; i < info->numFreeMaps; i++) {
+    free(info->freeMaps[i]);
+  }
+  free(info->freeMaps);
+  free(info->freeMapPages);
+  pthread_mutex_destroy(&info->freeLatch);
+  pthread_mutex_destroy(&info->syncLatch);
+  pthread_cond_destroy(&info->synced);
+  free(info->header);
+  free(info->fds);
+  free(info);
+  fHandle->mgmtInfo = NULL;
+  return RC_OK;
+}
+
+// The destroyPageFile method is to delete the page file based on filename.
+RC destroyPageFile(char *fileName) {
+  // validates parameters
+  if (fileName == NULL) {
+    return RC_FILE_NOT_FOUND;
+  }
+
+  // if the result is not zero, then some errors happened in this process
+  if (remove(fileName) != 0) {
+    return RC_FILE_NOT_FOUND;
+  }
+  removeSegmentFiles(fileName, 1);
+  char *mapName = getMapFileName(fileName);
+  remove(mapName);
+  free(mapName);
+  return RC_OK;
+}
+
+/* reading blocks from disc */
+
+// The readBlock method is to read the pageNum block from a file and stores its
+// content in the memory pointed to by the memPage page handle.
+//
+// - If the file has less than pageNum pages, the method should
+//   return RC_READ_NON_EXISTING_PAGE.
+// - If the file keeps checksums and the page does not match its checksum, the
+//   method should return RC_CHECKSUM_MISMATCH. The page is in memPage anyway.
+RC readBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage) {
+  // validates parameters
+  if (fHandle == NULL) {
+    return RC_FILE_HANDLE_NOT_INIT;
+  }
+  if (memPage == NULL) {
+    return RC_WRITE_FAILED;
+  }
+
+  // check the validation of pageNum, since the pageNum starts with 0, so the
+  // valid range of pageNum should be range of totalNumPages
+  if (pageNum < 0 || pageNum >= fHandle->totalNumPages) {
+    return RC_READ_NON_EXISTING_PAGE;
+  }
+  if (fHandle->mgmtInfo == NULL) {
+    return RC_FILE_NOT_FOUND;
+  }
+
+  // read the page at its offset in its segment, through an aligned copy if
+  // direct I/O cannot use memPage. The current position is only bookkeeping,
+  // it is updated atomically since the handle may be shared by threads.
+  RC rc = transferPages(pageNum, 1, fHandle, &memPage, 0);
+  if (rc != RC_OK) {
+    return rc;
+  }
+  __atomic_store_n(&fHandle->curPagePos, pageNum, __ATOMIC_RELAXED);
+  return RC_OK;
+
+}
+
+// The readBlocks method is to read count pages from startPage on and store
+// them in the memory pointed to by pages[0] to pages[count - 1]. The pages 
+// are read with as few system calls as possible, one per segment for a file
+// that is segmented. The current page position is moved to the last page read.
+//
+// - If the file has less than startPage + count pages, the method should
+//   return RC_READ_NON_EXISTING_PAGE.
+RC readBlocks(int startPage, int count, SM_FileHandle *fHandle, SM_PageHandle pages[]) {
+  // validates parameters
+  if (fHandle == NULL) {
+    return RC_FILE_HANDLE_NOT_INIT;
+  }
+  if (pages == NULL || count < 1) {
+    return RC_PARAMS_ERROR;
+  }
+  if (fHandle->mgmtInfo == NULL) {
+    return RC_FILE_NOT_FOUND;
+  }
+  if (startPage < 0 || startPage + count > fHandle->totalNumPages) {
+    return RC_READ_NON_EXISTING_PAGE;
+  }
+
+  RC rc = transferPages(startPage, count, fHandle, pages, 0);
+  if (rc != RC_OK) {
+    return rc;
+  }
+  __atomic_store_n(&fHandle->curPagePos, startPage + count - 1, __ATOMIC_RELAXED);
+  return RC_OK;
+}
+
+// The getBlockPos method is to get the current page position in a file.
+int getBlockPos(SM_FileHandle *fHandle) {
+  // validates parameters
+  if (fHandle == NULL) {
+    return -1;
+  }
+  return __atomic_load_n(&fHandle->curPagePos, __ATOMIC_RELAXED);
+}
+
+// The getBlockPointer method is to set *page to the pageNum block in the 
+// mapping of a file opened with openMappedPageFile, without copying it. The 
+// pointer stays valid until the file is closed, and changes made through it 
+// are written back to the file like those made with writeBlock. The page is
+// not checked against its checksum, and changes made through the pointer do
+// not update it: a file with checksums should be written with writeBlock.
+//
+// - If the file is not mapped, the method should return RC_PARAMS_ERROR.
+RC getBlockPointer(int pageNum, SM_FileHandle *fHandle, SM_PageHandle *page) {
+  // validates parameters
+  if (fHandle == NULL) {
+    return RC_FILE_HANDLE_NOT_INIT;
+  }
+  SM_FileInfo *info = fHandle->mgmtInfo;
+  if (info == NULL) {
+    return RC_FILE_NOT_FOUND;
+  }
+  if (info->map == NULL || page == NULL) {
+    return RC_PARAMS_ERROR;
+  }
+  if (pageNum < 0 || pageNum >= info->mappedPages) {
+    return RC_READ_NON_EXISTING_PAGE;
+  }
+  *page = info->map + (size_t) pageNum * info->pageSize;
+  __atomic_store_n(&fHandle->curPagePos, pageNum, __ATOMIC_RELAXED);
+  return RC_OK;
+}
+
+// The readFirstBlock method is to read the first page in a file. The current
+// page position should be moved to the page that was read.
+//
+// - If the user tries to read a block before the first page or after the last
+//   page of the file, the method should return RC READ NON EXISTING PAGE.
+RC readFirstBlock(SM_FileHandle *fHandle, SM_PageHandle memPage) {
+  // the first block number is page 0
+  return readBlock(0, fHandle, memPage);
+}
+
+// The readPreviousBlock method is to read the previous page relative to the
+// current page position of the file. The current page position should be moved
+// to the page that was read.
+//
+// - If the user tries to read a block before the first page or after the last
+//   page of the file, the method should return RC_READ_NON_EXISTING_PAGE.
+RC readPreviousBlock(SM_FileHandle *fHandle, SM_PageHandle memPage) {
+  // if the value of position is -1, errors happened in this process
+  int pageNum = getBlockPos(fHandle);
+  if (pageNum == -1) {
+    return RC_FILE_HANDLE_NOT_INIT;
+  }
+
+  // the previous block should be pageNum - 1
+  return readBlock(pageNum - 1, fHandle, memPage);
+}
+
+// The readCurrentBlock method is to read the current page position of the file.
+// The current page position should be moved to the page that was read.
+//
+// - If the user tries to read a block before the first page or after the last
+//   page of the file, the method should return RC_READ_NON_EXISTING_PAGE.
+RC readCurrentBlock(SM_FileHandle *fHandle, SM_PageHandle memPage) {
+  // if the value of pageNum is -1, errors happened in this process
+  int pageNum = getBlockPos(fHandle);
+  if (pageNum == -1) {
+    return RC_FILE_HANDLE_NOT_INIT;
+  }
+  return readBlock(pageNum, fHandle, memPage);
+
+}
+
+// The readNextBlock method is to read the next page relative to the current
+// page position of the file. The current page position should be moved to the
+// page that was read.
+//
+// - If the user tries to read a block before the first page or after the last
+//   page of the file, the method should return RC_READ_NON_EXISTING_PAGE.
+RC readNextBlock(SM_FileHandle *fHandle, SM_PageHandle memPage) {
+  // if the value of pageNum is -1, errors happened in this process
+  int pageNum = getBlockPos(fHandle);
+  if (pageNum == -1) {
+    return RC_FILE_HANDLE_NOT_INIT;
+  }
+
+  // the next block should be pageNum + 1
+  return readBlock(pageNum + 1, fHandle, memPage);
+}
+
+// The readLastBlock method is to read the last page in a file.
+RC readLastBlock(SM_FileHandle *fHandle, SM_PageHandle memPage) {
+  // validates parameters
+  if (fHandle == NULL) {
+    return RC_FILE_HANDLE_NOT_INIT;
+  }
+
+  // the previous block should be pageNum - 1
+  int lastBlockPageNum = fHandle->totalNumPages - 1;
+  return readBlock(lastBlockPageNum, fHandle, memPage);
+}
+
+/* writing blocks to a page file */
+
+// The writeBlock method is to write a page date to disk using either the
+// current position or an absolute position.
+RC writeBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage) {
+  // validates parameters
+  if (fHandle == NULL) {
+    return RC_FILE_HANDLE_NOT_INIT;
+  }
+
+  if (memPage == NULL) {
+    return RC_WRITE_FAILED;
+  }
+
+  if (pageNum < 0 || pageNum >= fHandle->totalNumPages) {
+    return RC_READ_NON_EXISTING_PAGE;
+  }
+
+  if (fHandle->mgmtInfo == NULL) {
+    return RC_FILE_NOT_FOUND;
+  }
+
+  // write data from memory, update page. The whole page is written, it may
+  // contain '\0' bytes between records. An unaligned memPage is copied to an
+  // aligned buffer first if the file is open for direct I/O. If the file 
+  // keeps checksums, the trailer of the page is replaced by the checksum of
+  // the rest of it on disk, memPage is not changed.
+  RC rc = transferPages(pageNum, 1, fHandle, &memPage, 1);
+  if (rc != RC_OK) {
+    return rc;
+  }
+  __atomic_store_n(&fHandle->curPagePos, pageNum, __ATOMIC_RELAXED);
+  return RC_OK;
+}
+
+// The writeBlocks method is to write count pages from startPage on, taking 
+// their content from pages[0] to pages[count - 1], with as few system calls
+// as possible. The current page position is moved to the last page written.
+RC writeBlocks(int startPage, int count, SM_FileHandle *fHandle, SM_PageHandle pages[]) {
+  // validates parameters
+  if (fHandle == NULL) {
+    return RC_FILE_HANDLE_NOT_INIT;
+  }
+  if (pages == NULL || count < 1) {
+    return RC_PARAMS_ERROR;
+  }
+  if (fHandle->mgmtInfo == NULL) {
+    return RC_FILE_NOT_FOUND;
+  }
+  if (startPage < 0 || startPage + count > fHandle->totalNumPages) {
+    return RC_READ_NON_EXISTING_PAGE;
+  }
+
+  RC rc = transferPages(startPage, count, fHandle, pages, 1);
+  if (rc != RC_OK) {
+    return rc;
+  }
+  __atomic_store_n(&fHandle->curPagePos, startPage + count - 1, __ATOMIC_RELAXED);
+  return RC_OK;
+}
+
+/* making writes durable */
+
+// The setDurability method is to select when the writes to a page file are
+// made durable:
+//
+// - SM_DURABILITY_NONE leaves it to the operating system, syncPageFile does
+//   nothing. This is the default.
+// - SM_DURABILITY_SYNC syncs every write before it returns.
+// - SM_DURABILITY_GROUP_COMMIT syncs on syncPageFile. A thread that finds no
+//   sync in progress waits windowMicros microseconds for more force requests,
+//   then serves them all with one sync, and requests made meanwhile are served
+//   by the next one.
+RC setDurability(SM_FileHandle *fHandle, SM_Durability durability, int windowMicros) {
+  // validates parameters
+  if (fHandle == NULL) {
+    return RC_FILE_HANDLE_NOT_INIT;
+  }
+  SM_FileInfo *info = fHandle->mgmtInfo;
+  if (info == NULL) {
+    return RC_FILE_NOT_FOUND;
+  }
+  if (durability < SM_DURABILITY_NONE || durability > SM_DURABILITY_GROUP_COMMIT || windowMicros < 0) {
+    return RC_PARAMS_ERROR;
+  }
+  pthread_mutex_lock(&info->syncLatch);
+  info->durability = durability;
+  info->syncWindow = windowMicros;
+  pthread_mutex_unlock(&info->syncLatch);
+  return RC_OK;
+}
+
+// sync every segment of a file and the creation of its new segments
+static RC syncSegments(SM_FileHandle *fHandle) {
+  SM_FileInfo *info = fHandle->mgmtInfo;
+  for (int i = 0; i < info->numSegments; i++) {
+    if (fdatasync(info->fds[i]) != 0) {
+      return RC_WRITE_FAILED;
+    }
+  }
+  if (info->mapFd >= 0 && fdatasync(info->mapFd) != 0) {
+    return RC_WRITE_FAILED;
+  }
+  __atomic_add_fetch(&info->numSyncs, 1, __ATOMIC_RELAXED);
+  return syncNewSegments(info, fHandle->fileName);
+}
+
+// The syncPageFile method is to force the pages written so far to disk, as
+// selected by setDurability. Concurrent force requests of a group commit 
+// share a sync.
+RC syncPageFile(SM_FileHandle *fHandle) {
+  // validates parameters
+  if (fHandle == NULL) {
+    return RC_FILE_HANDLE_NOT_INIT;
+  }
+  SM_FileInfo *info = fHandle->mgmtInfo;
+  if (info == NULL) {
+    return RC_FILE_NOT_FOUND;
+  }
+
+  pthread_mutex_lock(&info->syncLatch);
+  __atomic_add_fetch(&info->numForces, 1, __ATOMIC_RELAXED);
+  if (info->durability != SM_DURABILITY_GROUP_COMMIT) {
+    pthread_mutex_unlock(&info->syncLatch);
+    return RC_OK;
+  }
+
+  RC rc = RC_OK;
+  long request = ++info->forceRequests;
+  while (info->syncedRequests < request) {
+    if (info->syncing) {
+      pthread_cond_wait(&info->synced, &info->syncLatch);
+      continue;
+    }
+
+    // lead the next group commit: wait for more requests to join, then serve
+    // every request made before the sync starts
+    info->syncing = 1;
+    int window = info->syncWindow;
+    pthread_mutex_unlock(&info->syncLatch);
+    if (window > 0) {
+      struct timespec ts = { window / 1000000, (long) (window % 1000000) * 1000 };
+      nanosleep(&ts, NULL);
+    }
+    pthread_mutex_lock(&info->syncLatch);
+    long group = info->forceRequests;
+    pthread_mutex_unlock(&info->syncLatch);
+
+    rc = syncSegments(fHandle);
+
+    pthread_mutex_lock(&info->syncLatch);
+    info->syncing = 0;
+    if (rc == RC_OK) {
+      info->syncedRequests = group;
+    }
+    pthread_cond_broadcast(&info->synced);
+    if (rc != RC_OK) {
+      break;
+    }
+  }
+  pthread_mutex_unlock(&info->syncLatch);
+  return rc;
+}
+
+// the number of syncs issued for a file, -1 if it is not open
+int getNumSyncs(SM_FileHandle *fHandle) {
+  if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+    return -1;
+  }
+  SM_FileInfo *info = fHandle->mgmtInfo;
+  return __atomic_load_n(&info->numSyncs, __ATOMIC_RELAXED);
+}
+
+// the number of force requests served for a file, -1 if it is not open
+int getNumForceRequests(SM_FileHandle *fHandle) {
+  if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+    return -1;
+  }
+  SM_FileInfo *info = fHandle->mgmtInfo;
+  return __atomic_load_n(&info->numForces, __ATOMIC_RELAXED);
+}
+
+// The writeCurrentBlock method is to write current page to disk using either
+// the current position or an absolute position.
+RC writeCurrentBlock(SM_FileHandle *fHandle, SM_PageHandle memPage) {
+  // validates parameters
+  if (fHandle == NULL) {
+    return RC_FILE_HANDLE_NOT_INIT;
+  }
+
+  // write block using current page number
+  int curPageNum = fHandle->curPagePos;
+  return writeBlock(curPageNum, fHandle, memPage);
+}
+
+// The appendEmptyBlock method is to increase the number of pages in the file by
+// one. The new last page should be filled with zero bytes.
+RC appendEmptyBlock(SM_FileHandle *fHandle) {
+  // validates parameters
+  if (fHandle == NULL) {
+    return RC_FILE_HANDLE_NOT_INIT;
+  }
+  return ensureCapacity(fHandle->totalNumPages + 1, fHandle);
+}
+
+// The ensureCapacity method is to check current capacity.
+//
+// - If the file has less than number of pages, then increase the size to the
+//   number of pages.
+//
+// Every segment that grows is extended in one step, and totalNumPages is 
+// updated once. Space is reserved ahead as selected by setGrowthChunk.
+RC ensureCapacity(int numberOfPages, SM_FileHandle *fHandle) {
+  // validates parameters
+  if (fHandle == NULL) {
+    return RC_FILE_HANDLE_NOT_INIT;
+  }
+  if (numberOfPages < 1) {
+    return RC_READ_NON_EXISTING_PAGE;
+  }
+  SM_FileInfo *info = fHandle->mgmtInfo;
+  if (info == NULL) {
+    return RC_FILE_NOT_FOUND;
+  }
+  if (numberOfPages <= fHandle->totalNumPages) {
+    return RC_OK;
+  }
+
+  // the pages of a compressed file take space once they are written, only
+  // the page map grows
+  if (info->compressed) {
+    pthread_rwlock_wrlock(&info->slotLatch);
+    RC rc = growPageMap(info, numberOfPages);
+    if (rc == RC_OK) {
+      fHandle->totalNumPages = numberOfPages;
+    }
+    pthread_rwlock_unlock(&info->slotLatch);
+    return (rc == RC_OK) ? writeHeader(fHandle) : rc;
+  }
+
+  // reserve the next chunk once the reserved space is used up
+  int reserved = info->reservedPages;
+  int reserve = reserved;
+  if (numberOfPages > reserve) {
+    int chunk = (int) ((long) fHandle->totalNumPages * growthPercent / 100);
+    if (chunk < growthChunk) {
+      chunk = growthChunk;
+    }
+    reserve = numberOfPages + chunk;
+  }
+
+  // extend the segments from the last one on, creating the missing ones
+  while (fHandle->totalNumPages < numberOfPages) {
+    int total = fHandle->totalNumPages;
+    int segment = 0, first = 0, last = numberOfPages, end = reserve, done = reserved;
+    if (info->segmentPages > 0) {
+      segment = total / info->segmentPages;
+      first = segment * info->segmentPages;
+      if (last > first + info->segmentPages) {
+        last = first + info->segmentPages;
+      }
+      if (end > first + info->segmentPages) {
+        end = first + info->segmentPages;
+      }
+      if (done < first) {
+        done = first;
+      }
+    }
+    if (segment == info->numSegments) {
+      RC rc = addSegment(fHandle);
+      if (rc != RC_OK) {
+        return rc;
+      }
+    }
+
+    // the header page is in front of the pages of the first segment
+    int shift = (segment == 0) ? info->headerPages - first : -first;
+    RC rc = extendSegment(info->fds[segment], info->pageSize, total + shift, last + shift, done + shift, end + shift);
+    if (rc != RC_OK) {
+      return rc;
+    }
+    fHandle->totalNumPages = last;
+  }
+  // where the reservation failed, the pages up to reserve are extended 
+  // sparse, they read as zero bytes all the same
+  info->reservedPages = reserve;
+
+  // the header records the new page count, the mapping of a mapped file 
+  // grows with it
+  RC rc = writeHeader(fHandle);
+  if (rc != RC_OK) {
+    return rc;
+  }
+  return mapPages(fHandle);
+}
+
+/* allocating and freeing pages */
+
+// write the page of the free page map of a range of pages
+static RC writeFreeMap(SM_FileHandle *fHandle, int range) {
+  SM_FileInfo *info = fHandle->mgmtInfo;
+  return transferPages(info->freeMapPages[range], 1, fHandle, &info->freeMaps[range], 1);
+}
+
+// the first set bit of a map of numBits bits, -1 if there is none
+static int findSetBit(const unsigned char *bitmap, int numBits) {
+  int numBytes = numBits / 8;
+  int i = 0;
+  while (i + 8 <= numBytes) {
+    uint64_t word;
+    memcpy(&word, bitmap + i, sizeof(word));
+    if (word != 0) {
+      break;
+    }
+    i += 8;
+  }
+  for (; i < numBytes; i++) {
+    if (bitmap[i] != 0) {
+      return i * 8 + __builtin_ctz(bitmap[i]);
+    }
+  }
+  return -1;
+}
+
+// The allocatePage function is to give a page of a file to the caller and
+// store its number in *pageNum. A page that was freed with freePage is taken
+// first, the one with the lowest number, it keeps what was last written to
+// it. The file is only extended by a page filled with '\0' bytes when no page
+// is free.
+RC allocatePage(SM_FileHandle *fHandle, int *pageNum) {
+  // validates parameters
+  if (fHandle == NULL) {
+    return RC_FILE_HANDLE_NOT_INIT;
+  }
+  SM_FileInfo *info = fHandle->mgmtInfo;
+  if (info == NULL) {
+    return RC_FILE_NOT_FOUND;
+  }
+  if (pageNum == NULL) {
+    return RC_PARAMS_ERROR;
+  }
+
+  pthread_mutex_lock(&info->freeLatch);
+  RC rc = RC_OK;
+  if (info->numFreePages > 0) {
+    int bits = freeMapBits(info);
+    for (int range = 0; range < info->numFreeMaps; range++) {
+      if (info->freeMaps[range] == NULL) {
+        continue;
+      }
+      unsigned char *bitmap = (unsigned char *) info->freeMaps[range] + sizeof(SM_FreeMapHeader);
+      int bit = findSetBit(bitmap, bits);
+      if (bit < 0) {
+        continue;
+      }
+      bitmap[bit / 8] &= ~(1 << (bit % 8));
+      rc = writeFreeMap(fHandle, range);
+      if (rc != RC_OK) {
+        bitmap[bit / 8] |= 1 << (bit % 8);
+      } else {
+        info->numFreePages--;
+        *pageNum = range * bits + bit;
+      }
+      pthread_mutex_unlock(&info->freeLatch);
+      return rc;
+    }
+  }
+
+  int last = fHandle->totalNumPages;
+  rc = ensureCapacity(last + 1, fHandle);
+  if (rc == RC_OK) {
+    *pageNum = last;
+  }
+  pthread_mutex_unlock(&info->freeLatch);
+  return rc;
+}
+
+// The freePage function is to give a page of a file back, allocatePage hands
+// it out again before the file grows. Its bit is set in the free page map of
+// its range of pages. The first page freed in a range holds the map of the
+// range instead, so freeing it takes no new space.
+//
+// - If the file has less than pageNum pages, return RC_READ_NON_EXISTING_PAGE.
+// - If the page is already free or holds the free page map, return 
+//   RC_PARAMS_ERROR.
+// - If the file has no header to keep the map in, return 
+//   RC_FILE_FORMAT_UNSUPPORTED.
+RC freePage(int pageNum, SM_FileHandle *fHandle) {
+  // validates parameters
+  if (fHandle == NULL) {
+    return RC_FILE_HANDLE_NOT_INIT;
+  }
+  SM_FileInfo *info = fHandle->mgmtInfo;
+  if (info == NULL) {
+    return RC_FILE_NOT_FOUND;
+  }
+  if (pageNum < 0 || pageNum >= fHandle->totalNumPages) {
+    return RC_READ_NON_EXISTING_PAGE;
+  }
+  if (info->header == NULL) {
+    return RC_FILE_FORMAT_UNSUPPORTED;
+  }
+
+  pthread_mutex_lock(&info->freeLatch);
+  int bits = freeMapBits(info);
+  int range = pageNum / bits, bit = pageNum % bits;
+  RC rc = growFreeMaps(info, range + 1);
+  for (int i = 0; rc == RC_OK && i < info->numFreeMaps; i++) {
+    if (info->freeMapPages[i] == pageNum) {
+      rc = RC_PARAMS_ERROR;
+    }
+  }
+  if (rc != RC_OK) {
+    pthread_mutex_unlock(&info->freeLatch);
+    return rc;
+  }
+
+  // the page becomes the map of its range, which is written before the
+  // header chains it
+  if (info->freeMaps[range] == NULL) {
+    SM_FileHeader *h = (SM_FileHeader *) info->header;
+    char *map = (char *) calloc(info->pageSize, sizeof(char));
+    if (map == NULL) {
+      pthread_mutex_unlock(&info->freeLatch);
+      return RC_ALLOC_MEM_FAIL;
+    }
+    SM_FreeMapHeader *m = (SM_FreeMapHeader *) map;
+    m->next = h->freeListHead;
+    m->firstPage = range * bits;
+    info->freeMaps[range] = map;
+    info->freeMapPages[range] = pageNum;
+    rc = writeFreeMap(fHandle, range);
+    if (rc == RC_OK) {
+      h->freeListHead = pageNum;
+      rc = writeHeader(fHandle);
+    }
+    if (rc != RC_OK) {
+      h->freeListHead = m->next;
+      info->freeMaps[range] = NULL;
+      info->freeMapPages[range] = -1;
+      free(map);
+    }
+    pthread_mutex_unlock(&info->freeLatch);
+    return rc;
+  }
+
+  unsigned char *bitmap = (unsigned char *) info->freeMaps[range] + sizeof(SM_FreeMapHeader);
+  if (bitmap[bit / 8] & (1 << (bit % 8))) {
+    pthread_mutex_unlock(&info->freeLatch);
+    return RC_PARAMS_ERROR;
+  }
+  bitmap[bit / 8] |= 1 << (bit % 8);
+  rc = writeFreeMap(fHandle, range);
+  if (rc != RC_OK) {
+    bitmap[bit / 8] &= ~(1 << (bit % 8));
+  } else {
+    info->numFreePages++;
+  }
+  pthread_mutex_unlock(&info->freeLatch);
+  return rc;
+}
+
+// the number of free pages of a file, -1 if it is not open
+int getNumFreePages(SM_FileHandle *fHandle) {
+  if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+    return -1;
+  }
+  SM_FileInfo *info = fHandle->mgmtInfo;
+  pthread_mutex_lock(&info->freeLatch);
+  int numFreePages = info->numFreePages;
+  pthread_mutex_unlock(&info->freeLatch);
+  return numFreePages;
+}
+
+// 1 if a page holds the free page map of its range
+static int isFreeMapPage(SM_FileInfo *info, int pageNum) {
+  int range = pageNum / freeMapBits(info);
+  return range < info->numFreeMaps && info->freeMapPages[range] == pageNum;
+}
+
+// write count pages of '\0' bytes from offset on, for a file system that
+// cannot punch holes
+static RC writeZeroPages(SM_FileInfo *info, int fd, off_t offset, int count) {
+  char *zero = NULL;
+  if (posix_memalign((void **) &zero, DIRECT_IO_ALIGNMENT, info->pageSize) != 0) {
+    return RC_WRITE_FAILED;
+  }
+  memset(zero, 0, info->pageSize);
+  RC rc = RC_OK;
+  for (int i = 0; i < count && rc == RC_OK; i++) {
+    struct iovec iov = { zero, info->pageSize };
+    if (transferVector(fd, offset + (off_t) i * info->pageSize, &iov, 1, 1) != info->pageSize) {
+      rc = RC_WRITE_FAILED;
+    }
+  }
+  free(zero);
+  return rc;
+}
+
+// punch count pages from startPage on out of their segments
+static RC punchSegmentPages(SM_FileHandle *fHandle, int startPage, int count) {
+  SM_FileInfo *info = fHandle->mgmtInfo;
+  int done = 0;
+  while (done < count) {
+    off_t offset;
+    int pageNum = startPage + done;
+    int fd = locatePage(fHandle, pageNum, &offset);
+    if (fd < 0) {
+      return RC_FILE_NOT_FOUND;
+    }
+
+    // stop at the end of the segment
+    int cnt = count - done;
+    if (info->segmentPages > 0 && cnt > info->segmentPages - pageNum % info->segmentPages) {
+      cnt = info->segmentPages - pageNum % info->segmentPages;
+    }
+    int err = EOPNOTSUPP;
+#ifdef FALLOC_FL_PUNCH_HOLE
+    err = (fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, (off_t) cnt * info->pageSize) == 0)
+              ? 0 : errno;
+#endif
+    RC rc = RC_OK;
+    if (err == EOPNOTSUPP || err == ENOSYS) {
+      rc = writeZeroPages(info, fd, offset, cnt);
+    } else if (err != 0) {
+      rc = RC_WRITE_FAILED;
+    }
+    if (rc == RC_OK) {
+      rc = syncWrite(info, fHandle->fileName, fd);
+    }
+    if (rc != RC_OK) {
+      return rc;
+    }
+    done += cnt;
+  }
+  return RC_OK;
+}
+
+// drop the slots of count pages of a compressed file from startPage on. The
+// page map forgets a slot before its space is punched out of the data file.
+static RC punchCompressedPages(SM_FileHandle *fHandle, int startPage, int count) {
+  SM_FileInfo *info = fHandle->mgmtInfo;
+  RC rc = RC_OK;
+  pthread_rwlock_wrlock(&info->slotLatch);
+  for (int pageNum = startPage; pageNum < startPage + count && rc == RC_OK; pageNum++) {
+    SM_PageSlot slot = info->slots[pageNum];
+    if (slot.units == 0) {
+      continue;
+    }
+    memset(&info->slots[pageNum], 0, sizeof(SM_PageSlot));
+    struct iovec entry = { &info->slots[pageNum], sizeof(SM_PageSlot) };
+    if (transferVector(info->mapFd, (off_t) pageNum * sizeof(SM_PageSlot), &entry, 1, 1) != sizeof(SM_PageSlot)) {
+      info->slots[pageNum] = slot;
+      rc = RC_WRITE_FAILED;
+      break;
+    }
+    freeSlot(info, slot.offset, slot.units);
+
+    // the slot reads as '\0' bytes where its space is not given back
+#ifdef FALLOC_FL_PUNCH_HOLE
+    fallocate(info->fds[0], FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, slotOffset(info, slot.offset),
+              (off_t) slot.units * SLOT_UNIT);
+#endif
+  }
+  pthread_rwlock_unlock(&info->slotLatch);
+
+  if (rc == RC_OK) {
+    rc = syncWrite(info, fHandle->fileName, info->mapFd);
+  }
+  return rc;
+}
+
+// The punchPages function is to give the space of count pages from startPage
+// on back to the file system, with fallocate(FALLOC_FL_PUNCH_HOLE). The pages
+// read as '\0' bytes afterwards, a file system that cannot punch holes gets
+// them written that way. The file keeps its number of pages, and the pages
+// stay allocated or free as they were. The pages that hold the free page map
+// are kept. A buffer pool drops its copies of the pages with punchPoolPages.
+//
+// - If the file has less than startPage + count pages, return 
+//   RC_READ_NON_EXISTING_PAGE.
+RC punchPages(int startPage, int count, SM_FileHandle *fHandle) {
+  // validates parameters
+  if (fHandle == NULL) {
+    return RC_FILE_HANDLE_NOT_INIT;
+  }
+  SM_FileInfo *info = fHandle->mgmtInfo;
+  if (info == NULL) {
+    return RC_FILE_NOT_FOUND;
+  }
+  if (startPage < 0 || count < 0 || startPage > fHandle->totalNumPages - count) {
+    return RC_READ_NON_EXISTING_PAGE;
+  }
+
+  // the runs of pages between the pages of the free page map
+  pthread_mutex_lock(&info->freeLatch);
+  RC rc = RC_OK;
+  int pageNum = startPage, end = startPage + count;
+  while (pageNum < end && rc == RC_OK) {
+    if (isFreeMapPage(info, pageNum)) {
+      pageNum++;
+      continue;
+    }
+    int last = pageNum + 1;
+    while (last < end && !isFreeMapPage(info, last)) {
+      last++;
+    }
+    rc = info->compressed ? punchCompressedPages(fHandle, pageNum, last - pageNum)
+                          : punchSegmentPages(fHandle, pageNum, last - pageNum);
+    pageNum = last;
+  }
+  pthread_mutex_unlock(&info->freeLatch);
+  return rc;
+}
+
+// move the map of a range to newPage, or take it out of the chain of the
+// free page map if newPage is -1. The maps to be written are marked in
+// changed, with FREE_MAP_MOVED for a map at a new page, which is written
+// before the map or header that points to it.
+#define FREE_MAP_CHANGED 1
+#define FREE_MAP_MOVED 2
+static void moveFreeMap(SM_FileInfo *info, int range, int newPage, char *changed) {
+  SM_FreeMapHeader *m = (SM_FreeMapHeader *) info->freeMaps[range];
+  SM_FileHeader *h = (SM_FileHeader *) info->header;
+  int pageNum = info->freeMapPages[range];
+  int next = (newPage >= 0) ? newPage : m->next;
+  if (h->freeListHead == pageNum) {
+    h->freeListHead = next;
+  } else {
+    for (int i = 0; i < info->numFreeMaps; i++) {
+      SM_FreeMapHeader *prev = (SM_FreeMapHeader *) info->freeMaps[i];
+      if (prev != NULL && prev->next == pageNum) {
+        prev->next = next;
+        if (changed[i] == 0) {
+          changed[i] = FREE_MAP_CHANGED;
+        }
+        break;
+      }
+    }
+  }
+  if (newPage >= 0) {
+    info->freeMapPages[range] = newPage;
+    changed[range] = FREE_MAP_MOVED;
+  } else {
+    free(info->freeMaps[range]);
+    info->freeMaps[range] = NULL;
+    info->freeMapPages[range] = -1;
+    changed[range] = 0;
+  }
 }
 
-// The createPageFile function is to create a new page file with one page size.
-// This page file fills with '\0' bytes.
-RC createPageFile(char *fileName) {
-  // validates parameters
-  if (fileName == NULL) {
-    return RC_FILE_NOT_FOUND;
+// cut the slots of a compressed file down to those of its first numPages
+// pages, and the data file and page map down to them
+static RC shrinkCompressedPages(SM_FileHandle *fHandle, int numPages) {
+  SM_FileInfo *info = fHandle->mgmtInfo;
+  pthread_rwlock_wrlock(&info->slotLatch);
+  memset(info->slots + numPages, 0, (info->slotCapacity - numPages) * sizeof(SM_PageSlot));
+  RC rc = findFreeSlots(info, numPages, 0);
+  if (rc == RC_OK && (ftruncate(info->mapFd, (off_t) numPages * sizeof(SM_PageSlot)) != 0 ||
+                      ftruncate(info->fds[0], slotOffset(info, info->slotEnd)) != 0)) {
+    rc = RC_WRITE_FAILED;
   }
+  pthread_rwlock_unlock(&info->slotLatch);
 
-  // creates a non-null file pointer
-  FILE *fp = fopen(fileName, "w+");
-  if (fp == NULL) {
-    return RC_FILE_NOT_FOUND;
+  if (rc == RC_OK) {
+    rc = syncWrite(info, fHandle->fileName, info->mapFd);
+  }
+  if (rc == RC_OK) {
+    rc = syncWrite(info, fHandle->fileName, info->fds[0]);
   }
+  return rc;
+}
 
-  // allocates the PAGE_SIZE memory and assigns the value to str pointer
-  char *str = (char *) calloc(PAGE_SIZE, sizeof(char));
-  fwrite(str, sizeof(char), PAGE_SIZE, fp);
+// cut a file down to its first numPages pages. The header records the new
+// page count before the segments are cut, and the segment files past the 
+// last page are removed.
+static RC shrinkPages(SM_FileHandle *fHandle, int numPages) {
+  SM_FileInfo *info = fHandle->mgmtInfo;
+  int pageSize = info->pageSize;
 
-  // closes file, flushes buffers, deallocates memory
-  fclose(fp);
-  free(str);
-  if(fp) {
-    fp = NULL;
+  // the mapped pages that are gone are reserved address space again
+  if (info->mappedPages > numPages) {
+    if (mmap(info->map + (size_t) numPages * pageSize, (size_t) (info->mappedPages - numPages) * pageSize, PROT_NONE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0) == MAP_FAILED) {
+      return RC_ALLOC_MEM_FAIL;
+    }
+    info->mappedPages = numPages;
+  }
+  fHandle->totalNumPages = numPages;
+  info->reservedPages = numPages;
+  if (fHandle->curPagePos >= numPages) {
+    __atomic_store_n(&fHandle->curPagePos, (numPages > 0) ? numPages - 1 : 0, __ATOMIC_RELAXED);
+  }
+  RC rc = writeHeader(fHandle);
+  if (rc != RC_OK) {
+    return rc;
+  }
+  if (info->compressed) {
+    return shrinkCompressedPages(fHandle, numPages);
   }
-  return RC_OK;
-}
 
-// The openPageFile function is to open an existing file and get statistic data
-// and store those to the file handle.
-//
-// - If the file doesn't exist, return RC_FILE_NOT_FOUND.
-// - If opening the file is successful, then the files of this file handle is
-//   initialized with the information about the opened file.
-//
-// For example, the information about the opened file may contain file name,
-// total number of pages, current page position
-RC openPageFile(char *fileName, SM_FileHandle *fHandle) {
-  // validates parameters
-  if (fileName == NULL) {
-    return RC_FILE_NOT_FOUND;
+  // the removal of a segment file is durable once its directory is synced
+  int last = 0;
+  if (info->segmentPages > 0 && numPages > 0) {
+    last = (numPages - 1) / info->segmentPages;
+  }
+  while (info->numSegments > last + 1) {
+    info->numSegments--;
+    close(info->fds[info->numSegments]);
+    char *name = getSegmentFileName(fHandle->fileName, info->numSegments);
+    remove(name);
+    free(name);
+    __atomic_store_n(&info->newSegments, 1, __ATOMIC_RELAXED);
   }
+  int pages = (info->segmentPages > 0) ? numPages - last * info->segmentPages : numPages;
+  if (last == 0) {
+    pages += info->headerPages;
+  }
+  if (ftruncate(info->fds[last], (off_t) pages * pageSize) != 0) {
+    return RC_WRITE_FAILED;
+  }
+  return syncWrite(info, fHandle->fileName, info->fds[last]);
+}
 
+// The truncateFreePages function is to shorten a file by the free pages at its
+// end, see freePage, and give their space back to the file system. A page at
+// the end that holds the map of its range is dropped as well, the map moves
+// to the first free page of the range, or goes if the range has none. The
+// free page map is written first, then the header, then the segments are 
+// cut. Segment files past the new end are removed, and a mapped file no 
+// longer maps the pages that are gone. A buffer pool drops its copies of the
+// pages with truncatePoolFreePages.
+RC truncateFreePages(SM_FileHandle *fHandle) {
+  // validates parameters
   if (fHandle == NULL) {
     return RC_FILE_HANDLE_NOT_INIT;
   }
-
-  // opens a non-null file pointer
-  FILE *fp = fopen(fileName, "r+");
-  if (fp == NULL) {
+  SM_FileInfo *info = fHandle->mgmtInfo;
+  if (info == NULL) {
     return RC_FILE_NOT_FOUND;
   }
 
-  // seek to the end of the file to get file size, measure total pages
-  if (fseek(fp, 0, SEEK_END) != 0) {
-    fclose(fp);
-    if(fp == NULL) {
-      fp = NULL;
+  pthread_mutex_lock(&info->freeLatch);
+  int bits = freeMapBits(info);
+  int numPages = fHandle->totalNumPages;
+  char *changed = (char *) calloc(info->numFreeMaps + 1, sizeof(char));
+  while (numPages > 0) {
+    int pageNum = numPages - 1, range = pageNum / bits, bit = pageNum % bits;
+    if (range >= info->numFreeMaps || info->freeMaps[range] == NULL) {
+      break;
     }
-    return RC_READ_NON_EXISTING_PAGE;
+    unsigned char *bitmap = (unsigned char *) info->freeMaps[range] + sizeof(SM_FreeMapHeader);
+    if (info->freeMapPages[range] == pageNum) {
+      int first = findSetBit(bitmap, bits);
+      if (first >= 0) {
+        bitmap[first / 8] &= ~(1 << (first % 8));
+        info->numFreePages--;
+        moveFreeMap(info, range, range * bits + first, changed);
+      } else {
+        moveFreeMap(info, range, -1, changed);
+      }
+    } else if (bitmap[bit / 8] & (1 << (bit % 8))) {
+      bitmap[bit / 8] &= ~(1 << (bit % 8));
+      info->numFreePages--;
+      if (changed[range] == 0) {
+        changed[range] = FREE_MAP_CHANGED;
+      }
+    } else {
+      break;
+    }
+    numPages--;
   }
 
-  // stores file information, reset position
-  fHandle->mgmtInfo = fp;
-  fHandle->fileName = fileName;
-  fHandle->curPagePos = 0;
+  RC rc = RC_OK;
+  for (int i = 0; i < info->numFreeMaps && rc == RC_OK; i++) {
+    if (changed[i] == FREE_MAP_MOVED) {
+      rc = writeFreeMap(fHandle, i);
+    }
+  }
+  for (int i = 0; i < info->numFreeMaps && rc == RC_OK; i++) {
+    if (changed[i] == FREE_MAP_CHANGED) {
+      rc = writeFreeMap(fHandle, i);
+    }
+  }
+  free(changed);
+  if (rc == RC_OK && numPages < fHandle->totalNumPages) {
+    rc = shrinkPages(fHandle, numPages);
+  }
+  pthread_mutex_unlock(&info->freeLatch);
+  return rc;
+}
 
-  // measure total pages
-  long fileSize = ftell(fp);
-  fHandle->totalNumPages = (int) (fileSize / PAGE_SIZE);
+/* asynchronous reads and writes */
 
-  return RC_OK;
-}
+// An asynchronous read or write of one page. The requests of a file are kept
+// in a table, the index of a request in it is its token.
+typedef struct SM_AsyncRequest {
+  int fd; // the segment file and the offset of the page in it
+  off_t offset;
+  char *memPage;
+  int write;
+  int sync; // 1 if the write is durable once it is done
+  int state; // one of the ASYNC_ states
+  RC rc; // the result once the request is done
+  int next; // the next request in the free list or the queue of the workers
+} SM_AsyncRequest;
 
-// The closePageFile method is to close the current page file, removing every
-// reference to the file.
-RC closePageFile(SM_FileHandle *fHandle) {
-  // validates parameters
-  if (fHandle == NULL) {
-    return RC_FILE_HANDLE_NOT_INIT;
-  }
-  // get the file pointer through fHandle
-  FILE *fp = fHandle->mgmtInfo;
-  fclose(fp);
-  if (fp != NULL) {
-    fp = NULL;
+#define ASYNC_FREE 0
+#define ASYNC_QUEUED 1 // waiting for a worker
+#define ASYNC_SUBMITTED 2 // being transferred
+#define ASYNC_DONE 3 // done, until it is waited for
+
+// The engine of the asynchronous transfers of a page file. With io_uring, the
+// requests are submitted to the kernel and the thread that waits collects the
+// completions for every other one. Otherwise a pool of worker threads 
+// emulates it, each one transferring a request at a time with pread or 
+// pwrite. latch protects everything but the rings, which are shared with the
+// kernel.
+typedef struct SM_AsyncIO {
+  SM_FileInfo *info; // the file and its name
+  const char *fileName;
+  pthread_mutex_t latch;
+  pthread_cond_t done; // broadcast when requests are done
+  pthread_cond_t queued; // signalled when a request is queued for the workers
+  SM_AsyncRequest *requests;
+  int capacity;
+  int freeList;
+  int queueHead, queueTail; // the requests waiting for a worker
+  int inFlight; // the requests that are queued or submitted
+  int stopping;
+  pthread_t *workers;
+  int numWorkers;
+  int ringFd; // the io_uring, -1 if the workers are used
+#ifdef HAVE_IO_URING
+  int ringEntries;
+  int reaping; // 1 while a thread waits for completions in the kernel
+  void *sqRing, *cqRing;
+  size_t sqRingSize, cqRingSize;
+  struct io_uring_sqe *sqes;
+  size_t sqesSize;
+  unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+  unsigned *cqHead, *cqTail, *cqMask;
+  struct io_uring_cqe *cqes;
+#endif
+} SM_AsyncIO;
+
+// the engine and the number of requests it keeps in flight, for the files
+// that start transferring asynchronously from now on
+static SM_AsyncEngine asyncEngine = SM_ASYNC_IO_URING;
+static int asyncQueueDepth = 32;
+
+// serializes the creation of the engines
+static pthread_mutex_t asyncSetupLatch = PTHREAD_MUTEX_INITIALIZER;
+
+// The setAsyncEngine function selects the engine that the page files which
+// start transferring asynchronously from now on use, and the number of 
+// requests it keeps in flight: the entries of the io_uring or the worker 
+// threads. If io_uring is selected but the kernel does not provide it, the
+// worker threads are used instead. A file keeps its engine until it is closed.
+RC setAsyncEngine(SM_AsyncEngine engine, int queueDepth) {
+  if ((engine != SM_ASYNC_IO_URING && engine != SM_ASYNC_THREADS) || queueDepth < 1) {
+    return RC_PARAMS_ERROR;
   }
+  asyncEngine = engine;
+  asyncQueueDepth = queueDepth;
   return RC_OK;
 }
 
-// The destroyPageFile method is to delete the page file based on filename.
-RC destroyPageFile(char *fileName) {
-  // validates parameters
-  if (fileName == NULL) {
-    return RC_FILE_NOT_FOUND;
+// read or write the page of a request, retrying transfers that are cut short,
+// and check a page that is read against its checksum
+static RC transferRequest(SM_AsyncIO *aio, int fd, off_t offset, char *memPage, int write) {
+  int pageSize = aio->info->pageSize;
+  struct iovec iov = { memPage, pageSize };
+  if (transferVector(fd, offset, &iov, 1, write) != pageSize) {
+    return write ? RC_WRITE_FAILED : RC_READ_NON_EXISTING_PAGE;
   }
-
-  // if the result is not zero, then some errors happened in this process
-  if (remove(fileName) != 0) {
-    return RC_FILE_NOT_FOUND;
+  if (write) {
+    return syncWrite(aio->info, aio->fileName, fd);
   }
-  return RC_OK;
+  return aio->info->checksums ? verifyPage(memPage, pageSize) : RC_OK;
 }
 
-/* reading blocks from disc */
+// record the result of a request that is no longer in flight
+static void completeRequest(SM_AsyncIO *aio, SM_AsyncRequest *req, RC rc) {
+  req->rc = rc;
+  req->state = ASYNC_DONE;
+  aio->inFlight--;
+}
 
-// The readBlock method is to read the pageNum block from a file and stores its
-// content in the memory pointed to by the memPage page handle.
-//
-// - If the file has less than pageNum pages, the method should
-//   return RC_READ_NON_EXISTING_PAGE.
-RC readBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage) {
-  // validates parameters
-  if (fHandle == NULL) {
-    return RC_FILE_HANDLE_NOT_INIT;
+#ifdef HAVE_IO_URING
+static void teardownRing(SM_AsyncIO *aio) {
+  if (aio->sqes != NULL && aio->sqes != MAP_FAILED) {
+    munmap(aio->sqes, aio->sqesSize);
   }
-  if (memPage == NULL) {
-    return RC_WRITE_FAILED;
+  if (aio->cqRing != NULL && aio->cqRing != MAP_FAILED && aio->cqRing != aio->sqRing) {
+    munmap(aio->cqRing, aio->cqRingSize);
   }
-
-  // check the validation of pageNum, since the pageNum starts with 0, so the
-  // valid range of pageNum should be range of totalNumPages
-  if (pageNum < 0 || pageNum >= fHandle->totalNumPages) {
-    return RC_READ_NON_EXISTING_PAGE;
+  if (aio->sqRing != NULL && aio->sqRing != MAP_FAILED) {
+    munmap(aio->sqRing, aio->sqRingSize);
   }
-  // get the non-null file pointer
-  FILE *fp = fHandle->mgmtInfo;
-  if (fp == NULL) {
-    return RC_FILE_NOT_FOUND;
+  close(aio->ringFd);
+  aio->ringFd = -1;
+}
+
+// set up an io_uring of entries entries and map its rings, return 0 on 
+// success and -1 if the kernel does not provide io_uring with IORING_OP_READ
+// and IORING_OP_WRITE
+static int setupRing(SM_AsyncIO *aio, int entries) {
+  struct io_uring_params p;
+  memset(&p, 0, sizeof(p));
+  aio->ringFd = (int) syscall(__NR_io_uring_setup, entries, &p);
+  if (aio->ringFd < 0) {
+    aio->ringFd = -1;
+    return -1;
   }
+  aio->sqRing = aio->cqRing = NULL;
+  aio->sqes = NULL;
 
-  // seek to the offset of the file
-  int offset = pageNum * PAGE_SIZE;
-  if (fseek(fp, offset, SEEK_SET) != 0) {
-    return RC_READ_NON_EXISTING_PAGE;
+  // the read and write operations came with the same kernel as this feature
+  if (!(p.features & IORING_FEAT_RW_CUR_POS)) {
+    teardownRing(aio);
+    return -1;
   }
 
-  // read data from memory, update page
-  fread(memPage, sizeof(char), PAGE_SIZE, fp);
-  fHandle->curPagePos = pageNum;
-  return RC_OK;
+  // both rings may be in a single mapping
+  aio->sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  aio->cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    if (aio->cqRingSize > aio->sqRingSize) {
+      aio->sqRingSize = aio->cqRingSize;
+    }
+    aio->cqRingSize = aio->sqRingSize;
+  }
+  aio->sqRing = mmap(NULL, aio->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     aio->ringFd, IORING_OFF_SQ_RING);
+  if (aio->sqRing == MAP_FAILED) {
+    teardownRing(aio);
+    return -1;
+  }
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    aio->cqRing = aio->sqRing;
+  } else {
+    aio->cqRing = mmap(NULL, aio->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       aio->ringFd, IORING_OFF_CQ_RING);
+  }
+  aio->sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+  aio->sqes = mmap(NULL, aio->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   aio->ringFd, IORING_OFF_SQES);
+  if (aio->cqRing == MAP_FAILED || aio->sqes == MAP_FAILED) {
+    teardownRing(aio);
+    return -1;
+  }
 
+  char *sq = aio->sqRing, *cq = aio->cqRing;
+  aio->sqHead = (unsigned *) (sq + p.sq_off.head);
+  aio->sqTail = (unsigned *) (sq + p.sq_off.tail);
+  aio->sqMask = (unsigned *) (sq + p.sq_off.ring_mask);
+  aio->sqArray = (unsigned *) (sq + p.sq_off.array);
+  aio->cqHead = (unsigned *) (cq + p.cq_off.head);
+  aio->cqTail = (unsigned *) (cq + p.cq_off.tail);
+  aio->cqMask = (unsigned *) (cq + p.cq_off.ring_mask);
+  aio->cqes = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+  aio->ringEntries = p.sq_entries;
+  aio->reaping = 0;
+  return 0;
 }
 
-// The getBlockPos method is to get the current page position in a file.
-int getBlockPos(SM_FileHandle *fHandle) {
-  // validates parameters
-  if (fHandle == NULL) {
-    return -1;
+// submit a request to the kernel, the latch is held and fewer than 
+// ringEntries requests are in flight. A request the kernel does not take is
+// transferred right away.
+static void submitToRing(SM_AsyncIO *aio, int idx) {
+  SM_AsyncRequest *req = &aio->requests[idx];
+  unsigned tail = *aio->sqTail;
+  unsigned slot = tail & *aio->sqMask;
+  struct io_uring_sqe *sqe = &aio->sqes[slot];
+
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = req->write ? IORING_OP_WRITE : IORING_OP_READ;
+  sqe->fd = req->fd;
+  sqe->off = (unsigned long long) req->offset;
+  sqe->addr = (unsigned long long) (uintptr_t) req->memPage;
+  sqe->len = aio->info->pageSize;
+  sqe->rw_flags = req->sync ? RWF_DSYNC : 0;
+  sqe->user_data = (unsigned long long) idx;
+  aio->sqArray[slot] = slot;
+  __atomic_store_n(aio->sqTail, tail + 1, __ATOMIC_RELEASE);
+
+  req->state = ASYNC_SUBMITTED;
+  aio->inFlight++;
+  long n;
+  do {
+    n = syscall(__NR_io_uring_enter, aio->ringFd, 1, 0, 0, NULL, 0);
+  } while (n < 0 && errno == EINTR);
+  if (n < 0 && __atomic_load_n(aio->sqHead, __ATOMIC_ACQUIRE) == tail) {
+    __atomic_store_n(aio->sqTail, tail, __ATOMIC_RELEASE);
+    completeRequest(aio, req, transferRequest(aio, req->fd, req->offset, req->memPage, req->write));
   }
-  return fHandle->curPagePos;
 }
 
-// The readFirstBlock method is to read the first page in a file. The current
-// page position should be moved to the page that was read.
-//
-// - If the user tries to read a block before the first page or after the last
-//   page of the file, the method should return RC READ NON EXISTING PAGE.
-RC readFirstBlock(SM_FileHandle *fHandle, SM_PageHandle memPage) {
-  // the first block number is page 0
-  return readBlock(0, fHandle, memPage);
+// record the completions the kernel posted, the latch is held. A transfer that
+// was cut short or interrupted is finished synchronously. Writes in 
+// SM_DURABILITY_SYNC mode are submitted with RWF_DSYNC, so they are durable
+// once they complete.
+static void reapRing(SM_AsyncIO *aio) {
+  unsigned head = *aio->cqHead;
+  unsigned tail = __atomic_load_n(aio->cqTail, __ATOMIC_ACQUIRE);
+  int pageSize = aio->info->pageSize;
+  while (head != tail) {
+    struct io_uring_cqe *cqe = &aio->cqes[head & *aio->cqMask];
+    SM_AsyncRequest *req = &aio->requests[cqe->user_data];
+    RC rc;
+    if (cqe->res == pageSize && req->sync) {
+      __atomic_add_fetch(&aio->info->numSyncs, 1, __ATOMIC_RELAXED);
+      rc = syncNewSegments(aio->info, aio->fileName);
+    } else if (cqe->res == pageSize) {
+      rc = (!req->write && aio->info->checksums) ? verifyPage(req->memPage, pageSize) : RC_OK;
+    } else if ((cqe->res >= 0 && cqe->res < pageSize) || cqe->res == -EINTR || cqe->res == -EAGAIN) {
+      rc = transferRequest(aio, req->fd, req->offset, req->memPage, req->write);
+    } else {
+      rc = req->write ? RC_WRITE_FAILED : RC_READ_NON_EXISTING_PAGE;
+    }
+    completeRequest(aio, req, rc);
+    head++;
+  }
+  __atomic_store_n(aio->cqHead, head, __ATOMIC_RELEASE);
 }
+#endif
 
-// The readPreviousBlock method is to read the previous page relative to the
-// current page position of the file. The current page position should be moved
-// to the page that was read.
-//
-// - If the user tries to read a block before the first page or after the last
-//   page of the file, the method should return RC_READ_NON_EXISTING_PAGE.
-RC readPreviousBlock(SM_FileHandle *fHandle, SM_PageHandle memPage) {
-  // if the value of position is -1, errors happened in this process
-  int pageNum = getBlockPos(fHandle);
-  if (pageNum == -1) {
-    return RC_FILE_HANDLE_NOT_INIT;
+// wait until requests in flight are done, the latch is held. With io_uring the
+// first thread that waits collects the completions for the others.
+static void awaitCompletion(SM_AsyncIO *aio) {
+#ifdef HAVE_IO_URING
+  if (aio->ringFd >= 0 && !aio->reaping) {
+    aio->reaping = 1;
+    pthread_mutex_unlock(&aio->latch);
+    syscall(__NR_io_uring_enter, aio->ringFd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+    pthread_mutex_lock(&aio->latch);
+    aio->reaping = 0;
+    reapRing(aio);
+    pthread_cond_broadcast(&aio->done);
+    return;
   }
+#endif
+  pthread_cond_wait(&aio->done, &aio->latch);
+}
 
-  // the previous block should be pageNum - 1
-  return readBlock(pageNum - 1, fHandle, memPage);
+// transfer the requests queued for the workers until the engine stops
+static void *runAsyncWorker(void *arg) {
+  SM_AsyncIO *aio = arg;
+  pthread_mutex_lock(&aio->latch);
+  while (1) {
+    while (aio->queueHead < 0 && !aio->stopping) {
+      pthread_cond_wait(&aio->queued, &aio->latch);
+    }
+    if (aio->queueHead < 0) {
+      break;
+    }
+    int idx = aio->queueHead;
+    SM_AsyncRequest *req = &aio->requests[idx];
+    aio->queueHead = req->next;
+    if (aio->queueHead < 0) {
+      aio->queueTail = -1;
+    }
+    req->state = ASYNC_SUBMITTED;
+
+    // the table may move while the page is transferred
+    int fd = req->fd, write = req->write;
+    off_t offset = req->offset;
+    char *memPage = req->memPage;
+    pthread_mutex_unlock(&aio->latch);
+    RC rc = transferRequest(aio, fd, offset, memPage, write);
+    pthread_mutex_lock(&aio->latch);
+
+    completeRequest(aio, &aio->requests[idx], rc);
+    pthread_cond_broadcast(&aio->done);
+  }
+  pthread_mutex_unlock(&aio->latch);
+  return NULL;
 }
 
-// The readCurrentBlock method is to read the current page position of the file.
-// The current page position should be moved to the page that was read.
-//
-// - If the user tries to read a block before the first page or after the last
-//   page of the file, the method should return RC_READ_NON_EXISTING_PAGE.
-RC readCurrentBlock(SM_FileHandle *fHandle, SM_PageHandle memPage) {
-  // if the value of pageNum is -1, errors happened in this process
-  int pageNum = getBlockPos(fHandle);
-  if (pageNum == -1) {
-    return RC_FILE_HANDLE_NOT_INIT;
+// create the engine of a file as selected by setAsyncEngine
+static SM_AsyncIO *createAsyncIO(SM_FileHandle *fHandle) {
+  SM_AsyncIO *aio = (SM_AsyncIO *) calloc(1, sizeof(SM_AsyncIO));
+  aio->info = fHandle->mgmtInfo;
+  aio->fileName = fHandle->fileName;
+  pthread_mutex_init(&aio->latch, NULL);
+  pthread_cond_init(&aio->done, NULL);
+  pthread_cond_init(&aio->queued, NULL);
+  aio->capacity = 0;
+  aio->freeList = -1;
+  aio->queueHead = aio->queueTail = -1;
+  aio->ringFd = -1;
+
+#ifdef HAVE_IO_URING
+  if (asyncEngine == SM_ASYNC_IO_URING && setupRing(aio, asyncQueueDepth) == 0) {
+    return aio;
   }
-  return readBlock(pageNum, fHandle, memPage);
+#endif
 
+  // without workers, requests are transferred when they are submitted
+  aio->workers = (pthread_t *) malloc(asyncQueueDepth * sizeof(pthread_t));
+  while (aio->numWorkers < asyncQueueDepth &&
+         pthread_create(&aio->workers[aio->numWorkers], NULL, runAsyncWorker, aio) == 0) {
+    aio->numWorkers++;
+  }
+  return aio;
 }
 
-// The readNextBlock method is to read the next page relative to the current
-// page position of the file. The current page position should be moved to the
-// page that was read.
-//
-// - If the user tries to read a block before the first page or after the last
-//   page of the file, the method should return RC_READ_NON_EXISTING_PAGE.
-RC readNextBlock(SM_FileHandle *fHandle, SM_PageHandle memPage) {
-  // if the value of pageNum is -1, errors happened in this process
-  int pageNum = getBlockPos(fHandle);
-  if (pageNum == -1) {
-    return RC_FILE_HANDLE_NOT_INIT;
+// wait for the requests in flight and release the engine
+static void destroyAsyncIO(SM_AsyncIO *aio) {
+  pthread_mutex_lock(&aio->latch);
+  while (aio->inFlight > 0) {
+    awaitCompletion(aio);
   }
+  aio->stopping = 1;
+  pthread_cond_broadcast(&aio->queued);
+  pthread_mutex_unlock(&aio->latch);
 
-  // the next block should be pageNum + 1
-  return readBlock(pageNum + 1, fHandle, memPage);
+  for (int i = 0; i < aio->numWorkers; i++) {
+    pthread_join(aio->workers[i], NULL);
+  }
+#ifdef HAVE_IO_URING
+  if (aio->ringFd >= 0) {
+    teardownRing(aio);
+  }
+#endif
+  pthread_mutex_destroy(&aio->latch);
+  pthread_cond_destroy(&aio->done);
+  pthread_cond_destroy(&aio->queued);
+  free(aio->workers);
+  free(aio->requests);
+  free(aio);
 }
 
-// The readLastBlock method is to read the last page in a file.
-RC readLastBlock(SM_FileHandle *fHandle, SM_PageHandle memPage) {
-  // validates parameters
-  if (fHandle == NULL) {
-    return RC_FILE_HANDLE_NOT_INIT;
+// get the engine of a file, creating it on the first asynchronous transfer
+static SM_AsyncIO *getAsyncIO(SM_FileHandle *fHandle) {
+  SM_FileInfo *info = fHandle->mgmtInfo;
+  SM_AsyncIO *aio = __atomic_load_n(&info->async, __ATOMIC_ACQUIRE);
+  if (aio == NULL) {
+    pthread_mutex_lock(&asyncSetupLatch);
+    aio = info->async;
+    if (aio == NULL) {
+      aio = createAsyncIO(fHandle);
+      __atomic_store_n(&info->async, aio, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&asyncSetupLatch);
   }
-
-  // the previous block should be pageNum - 1
-  int lastBlockPageNum = fHandle->totalNumPages - 1;
-  return readBlock(lastBlockPageNum, fHandle, memPage);
+  return aio;
 }
 
-/* writing blocks to a page file */
+// take a request from the free list, doubling the table if it is empty. The
+// latch is held.
+static int allocRequest(SM_AsyncIO *aio) {
+  if (aio->freeList < 0) {
+    int capacity = aio->capacity ? aio->capacity * 2 : 64;
+    aio->requests = (SM_AsyncRequest *) realloc(aio->requests, capacity * sizeof(SM_AsyncRequest));
+    for (int i = capacity - 1; i >= aio->capacity; i--) {
+      aio->requests[i].state = ASYNC_FREE;
+      aio->requests[i].next = aio->freeList;
+      aio->freeList = i;
+    }
+    aio->capacity = capacity;
+  }
+  int idx = aio->freeList;
+  aio->freeList = aio->requests[idx].next;
+  return idx;
+}
 
-// The writeBlock method is to write a page date to disk using either the
-// current position or an absolute position.
-RC writeBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage) {
+// start reading or writing a page asynchronously
+static RC submitBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage, SM_AsyncToken *token, int write) {
   // validates parameters
   if (fHandle == NULL) {
     return RC_FILE_HANDLE_NOT_INIT;
   }
-
-  if (memPage == NULL) {
-    return RC_WRITE_FAILED;
+  SM_FileInfo *info = fHandle->mgmtInfo;
+  if (info == NULL) {
+    return RC_FILE_NOT_FOUND;
+  }
+  if (memPage == NULL || token == NULL) {
+    return RC_PARAMS_ERROR;
   }
-
   if (pageNum < 0 || pageNum >= fHandle->totalNumPages) {
     return RC_READ_NON_EXISTING_PAGE;
   }
-
-  // get the non-null file pointer
-  FILE *fp = fHandle->mgmtInfo;
-  if (fp == NULL) {
+  off_t offset;
+  int fd = locatePage(fHandle, pageNum, &offset);
+  if (fd < 0) {
     return RC_FILE_NOT_FOUND;
   }
 
-  
-  // seek to the offset of the file
-  int offset = pageNum * PAGE_SIZE;
-  if (fseek(fp, offset, SEEK_SET) != 0) {
-    return RC_READ_NON_EXISTING_PAGE;
+  SM_AsyncIO *aio = getAsyncIO(fHandle);
+  pthread_mutex_lock(&aio->latch);
+  int idx = allocRequest(aio);
+  SM_AsyncRequest *req = &aio->requests[idx];
+  req->fd = fd;
+  req->offset = offset;
+  req->memPage = memPage;
+  req->write = write;
+  req->sync = write && info->durability == SM_DURABILITY_SYNC;
+  req->next = -1;
+  *token = idx;
+
+  // mapped pages are only copied, and pages that direct I/O cannot transfer
+  // in place go through an aligned copy, both are done right away. So are 
+  // writes with checksums, whose trailer is not in memPage, and the pages of
+  // compressed files, which are not where locatePage puts them.
+  if (pageNum < info->mappedPages || (info->direct && !pagesAligned(&memPage, 1)) ||
+      (write && info->checksums) || info->compressed ||
+      (aio->ringFd < 0 && aio->numWorkers == 0)) {
+    req->state = ASYNC_SUBMITTED;
+    pthread_mutex_unlock(&aio->latch);
+    RC rc = transferPages(pageNum, 1, fHandle, &memPage, write);
+    pthread_mutex_lock(&aio->latch);
+    aio->requests[idx].rc = rc;
+    aio->requests[idx].state = ASYNC_DONE;
+    pthread_mutex_unlock(&aio->latch);
+    return RC_OK;
   }
 
-  // write data from memory, update page
-  fwrite(memPage, sizeof(char), strlen(memPage), fp);
-  fHandle->curPagePos = pageNum;
+#ifdef HAVE_IO_URING
+  if (aio->ringFd >= 0) {
+    while (aio->inFlight >= aio->ringEntries) {
+      awaitCompletion(aio);
+    }
+    submitToRing(aio, idx);
+    pthread_mutex_unlock(&aio->latch);
+    return RC_OK;
+  }
+#endif
+
+  req->state = ASYNC_QUEUED;
+  if (aio->queueTail < 0) {
+    aio->queueHead = idx;
+  } else {
+    aio->requests[aio->queueTail].next = idx;
+  }
+  aio->queueTail = idx;
+  aio->inFlight++;
+  pthread_cond_signal(&aio->queued);
+  pthread_mutex_unlock(&aio->latch);
   return RC_OK;
 }
 
-// The writeCurrentBlock method is to write current page to disk using either
-// the current position or an absolute position.
-RC writeCurrentBlock(SM_FileHandle *fHandle, SM_PageHandle memPage) {
-  // validates parameters
-  if (fHandle == NULL) {
-    return RC_FILE_HANDLE_NOT_INIT;
+// The submitReadBlock method is to start reading the pageNum block into the
+// memory pointed to by memPage, and set *token to identify the read. The 
+// page is in memPage once pollBlock or waitBlock report the read done, and
+// memPage must stay valid until then. The current page position does not 
+// change.
+//
+// - If the file has less than pageNum pages, the method should
+//   return RC_READ_NON_EXISTING_PAGE.
+RC submitReadBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage, SM_AsyncToken *token) {
+  return submitBlock(pageNum, fHandle, memPage, token, 0);
+}
+
+// The submitWriteBlock method is to start writing the memory pointed to by
+// memPage to the pageNum block, and set *token to identify the write. memPage
+// must not change until pollBlock or waitBlock report the write done.
+RC submitWriteBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage, SM_AsyncToken *token) {
+  return submitBlock(pageNum, fHandle, memPage, token, 1);
+}
+
+// find the request of a token, the latch is held
+static SM_AsyncRequest *getRequest(SM_AsyncIO *aio, SM_AsyncToken token) {
+  if (token < 0 || token >= aio->capacity || aio->requests[token].state == ASYNC_FREE) {
+    return NULL;
   }
+  return &aio->requests[token];
+}
 
-  // write block using current page number
-  int curPageNum = fHandle->curPagePos;
-  return writeBlock(curPageNum, fHandle, memPage);
+// return the result of a request that is done and release its token, the
+// latch is held
+static RC finishRequest(SM_AsyncIO *aio, SM_AsyncToken token) {
+  SM_AsyncRequest *req = &aio->requests[token];
+  RC rc = req->rc;
+  req->state = ASYNC_FREE;
+  req->next = aio->freeList;
+  aio->freeList = token;
+  return rc;
 }
 
-// The appendEmptyBlock method is to increase the number of pages in the file by
-// one. The new last page should be filled with zero bytes.
-RC appendEmptyBlock(SM_FileHandle *fHandle) {
+// The pollBlock method is to check if the read or write identified by token 
+// is done without waiting for it. 
+//
+// - If it is still in flight, the method should return RC_ASYNC_PENDING.
+// - Otherwise the token is released and the result of the transfer is 
+//   returned.
+RC pollBlock(SM_AsyncToken token, SM_FileHandle *fHandle) {
   // validates parameters
   if (fHandle == NULL) {
     return RC_FILE_HANDLE_NOT_INIT;
   }
-
-  // get the non-null file pointer
-  FILE *fp = fHandle->mgmtInfo;
-  if (fp == NULL) {
+  SM_FileInfo *info = fHandle->mgmtInfo;
+  if (info == NULL) {
     return RC_FILE_NOT_FOUND;
   }
+  SM_AsyncIO *aio = __atomic_load_n(&info->async, __ATOMIC_ACQUIRE);
+  if (aio == NULL) {
+    return RC_PARAMS_ERROR;
+  }
 
-  // move pointer to the end of the file
-  if (fseek(fp, 0, SEEK_END) != 0) {
-    return RC_READ_NON_EXISTING_PAGE;
+  pthread_mutex_lock(&aio->latch);
+  SM_AsyncRequest *req = getRequest(aio, token);
+  if (req == NULL) {
+    pthread_mutex_unlock(&aio->latch);
+    return RC_PARAMS_ERROR;
   }
 
-  // allocates the PAGE_SIZE memory and assigns the value to str pointer
-  char *str = (char *) calloc(PAGE_SIZE, sizeof(char));
-  fwrite(str, sizeof(char), PAGE_SIZE, fp); 
-  // plus 1 to total number of pages, deallocates the memory
-  fHandle->totalNumPages++;
-  free(str);
-  return RC_OK;
+  // a thread waiting in the kernel collects the completions itself
+#ifdef HAVE_IO_URING
+  if (aio->ringFd >= 0 && !aio->reaping) {
+    reapRing(aio);
+  }
+#endif
+  RC rc = (req->state == ASYNC_DONE) ? finishRequest(aio, token) : RC_ASYNC_PENDING;
+  pthread_mutex_unlock(&aio->latch);
+  return rc;
 }
 
-// The ensureCapacity method is to check current capacity.
-//
-// - If the file has less than number of pages, then increase the size to the
-//   number of pages.
-RC ensureCapacity(int numberOfPages, SM_FileHandle *fHandle) {
+// The waitBlock method is to wait until the read or write identified by 
+// token is done, release the token and return the result of the transfer.
+RC waitBlock(SM_AsyncToken token, SM_FileHandle *fHandle) {
   // validates parameters
   if (fHandle == NULL) {
     return RC_FILE_HANDLE_NOT_INIT;
   }
-  if (numberOfPages < 1) {
-    return RC_READ_NON_EXISTING_PAGE;
+  SM_FileInfo *info = fHandle->mgmtInfo;
+  if (info == NULL) {
+    return RC_FILE_NOT_FOUND;
+  }
+  SM_AsyncIO *aio = __atomic_load_n(&info->async, __ATOMIC_ACQUIRE);
+  if (aio == NULL) {
+    return RC_PARAMS_ERROR;
   }
 
-  // append remaining blocks
-  int currentNumPages = fHandle->totalNumPages;
-  int cnt = numberOfPages - currentNumPages;
-
-  for (int i = 0; i < cnt; i++) {
-    appendEmptyBlock(fHandle);
+  pthread_mutex_lock(&aio->latch);
+  if (getRequest(aio, token) == NULL) {
+    pthread_mutex_unlock(&aio->latch);
+    return RC_PARAMS_ERROR;
   }
+  while (aio->requests[token].state != ASYNC_DONE) {
+    awaitCompletion(aio);
+  }
+  RC rc = finishRequest(aio, token);
+  pthread_mutex_unlock(&aio->latch);
+  return rc;
+}
 
-  // check whether the total number of pages is the same as required
-  if (fHandle->totalNumPages < numberOfPages) {
-    return RC_WRITE_FAILED;
+// The getAsyncEngine method is to set *engine to the engine that transfers
+// the pages of a file asynchronously, which is SM_ASYNC_THREADS if io_uring 
+// was selected but is not available.
+RC getAsyncEngine(SM_FileHandle *fHandle, SM_AsyncEngine *engine) {
+  // validates parameters
+  if (fHandle == NULL) {
+    return RC_FILE_HANDLE_NOT_INIT;
   }
+  if (fHandle->mgmtInfo == NULL) {
+    return RC_FILE_NOT_FOUND;
+  }
+  if (engine == NULL) {
+    return RC_PARAMS_ERROR;
+  }
+  SM_AsyncIO *aio = getAsyncIO(fHandle);
+  *engine = (aio->ringFd >= 0) ? SM_ASYNC_IO_URING : SM_ASYNC_THREADS;
   return RC_OK;
 }
+
@@ -10,11 +10,34 @@ typedef struct SM_FileHandle {
 	char *fileName;
 	int totalNumPages;
 	int curPagePos;
+	int pageSize; // the size of the pages of the file, see setPageSize
 	void *mgmtInfo;
 } SM_FileHandle;
 
 typedef char* SM_PageHandle;
 
+// the largest page size, pages are PAGE_SIZE bytes long by default
+#define MAX_PAGE_SIZE 65536
+
+// the bytes at the end of every page of a file with checksums that hold the
+// checksum of the rest of the page, see setPageChecksums
+#define PAGE_CHECKSUM_SIZE 4
+
+// identifies an asynchronous read or write until it is waited for
+typedef int SM_AsyncToken;
+
+// when the writes to a page file are made durable
+typedef enum SM_Durability {
+	SM_DURABILITY_NONE = 0,
+	SM_DURABILITY_SYNC = 1,
+	SM_DURABILITY_GROUP_COMMIT = 2
+} SM_Durability;
+
+typedef enum SM_AsyncEngine {
+	SM_ASYNC_IO_URING = 0,
+	SM_ASYNC_THREADS = 1
+} SM_AsyncEngine;
+
 /************************************************************
  *                    interface                             *
  ************************************************************/
@@ -22,11 +45,20 @@ typedef char* SM_PageHandle;
 extern void initStorageManager (void);
 extern RC createPageFile (char *fileName);
 extern RC openPageFile (char *fileName, SM_FileHandle *fHandle);
+extern RC openMappedPageFile (char *fileName, SM_FileHandle *fHandle);
 extern RC closePageFile (SM_FileHandle *fHandle);
 extern RC destroyPageFile (char *fileName);
+extern RC setSegmentSize (int pagesPerSegment);
+extern RC setGrowthChunk (int chunkPages, int percent);
+extern RC setDirectIO (int enable);
+extern RC setPageChecksums (int enable);
+extern RC setPageSize (int size);
+extern RC setPageCompression (int enable);
 
 /* reading blocks from disc */
 extern RC readBlock (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage);
+extern RC readBlocks (int startPage, int count, SM_FileHandle *fHandle, SM_PageHandle pages[]);
+extern RC getBlockPointer (int pageNum, SM_FileHandle *fHandle, SM_PageHandle *page);
 extern int getBlockPos (SM_FileHandle *fHandle);
 extern RC readFirstBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC readPreviousBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
@@ -36,8 +68,30 @@ extern RC readLastBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 
 /* writing blocks to a page file */
 extern RC writeBlock (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage);
+extern RC writeBlocks (int startPage, int count, SM_FileHandle *fHandle, SM_PageHandle pages[]);
 extern RC writeCurrentBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC appendEmptyBlock (SM_FileHandle *fHandle);
 extern RC ensureCapacity (int numberOfPages, SM_FileHandle *fHandle);
 
+/* allocating and freeing pages */
+extern RC allocatePage (SM_FileHandle *fHandle, int *pageNum);
+extern RC freePage (int pageNum, SM_FileHandle *fHandle);
+extern int getNumFreePages (SM_FileHandle *fHandle);
+extern RC punchPages (int startPage, int count, SM_FileHandle *fHandle);
+extern RC truncateFreePages (SM_FileHandle *fHandle);
+
+/* making writes durable */
+extern RC setDurability (SM_FileHandle *fHandle, SM_Durability durability, int windowMicros);
+extern RC syncPageFile (SM_FileHandle *fHandle);
+extern int getNumSyncs (SM_FileHandle *fHandle);
+extern int getNumForceRequests (SM_FileHandle *fHandle);
+
+/* asynchronous reads and writes */
+extern RC setAsyncEngine (SM_AsyncEngine engine, int queueDepth);
+extern RC getAsyncEngine (SM_FileHandle *fHandle, SM_AsyncEngine *engine);
+extern RC submitReadBlock (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage, SM_AsyncToken *token);
+extern RC submitWriteBlock (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage, SM_AsyncToken *token);
+extern RC pollBlock (SM_AsyncToken token, SM_FileHandle *fHandle);
+extern RC waitBlock (SM_AsyncToken token, SM_FileHandle *fHandle);
+
 #endif
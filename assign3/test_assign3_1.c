@@ -415,6 +415,9 @@ testInsertManyRecords(void)
 		rids[i] = r->id;
 	}
 
+	// dirty pages are only written when they leave the buffer pool
+	ASSERT_TRUE(getNumWriteIO(getTableBufferPool(table)) < numInserts, "inserts are not written through");
+
 	TEST_CHECK(closeTable(table));
 	TEST_CHECK(openTable(table, "test_table_t"));
 
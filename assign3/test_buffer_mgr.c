@@ -0,0 +1,2139 @@
+#include "dberror.h"
+#include "storage_mgr.h"
+#include "buffer_mgr_stat.h"
+#include "buffer_mgr.h"
+#include "test_helper.h"
+#include "crc32c.h"
+#include "lz.h"
+
+#include <time.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+// check the per-frame frequencies reported by getFrameFrequencies
+#define ASSERT_EQUALS_FREQUENCIES(expected,bm,message)			\
+		do {									\
+			int *_freq = getFrameFrequencies(bm);				\
+			int _i;								\
+			for (_i = 0; _i < (bm)->numPages; _i++)				\
+				ASSERT_EQUALS_INT((expected)[_i], _freq[_i], message);	\
+			free(_freq);							\
+		} while(0)
+
+// check whether two the content of a buffer pool is the same as an expected content
+// (given in the format produced by sprintPoolContent)
+#define ASSERT_EQUALS_POOL(expected,bm,message)			        \
+		do {									\
+			char *real;								\
+			char *_exp = (char *) (expected);                                   \
+			real = sprintPoolContent(bm);					\
+			if (strcmp((_exp),real) != 0)					\
+			{									\
+				printf("[%s-%s-L%i-%s] FAILED: expected <%s> but was <%s>: %s\n",TEST_INFO, _exp, real, message); \
+				free(real);							\
+				exit(1);							\
+			}									\
+			printf("[%s-%s-L%i-%s] OK: expected <%s> and was <%s>: %s\n",TEST_INFO, _exp, real, message); \
+			free(real);								\
+		} while(0)
+
+// test methods
+static void testPageTable (void);
+static void testLRU (void);
+static void testLRUSkipsPinnedPages (void);
+static void testCLOCK (void);
+static void testStrategyComparison (void);
+static void testLFU (void);
+static void testLFUAging (void);
+static void testLRU_K (void);
+static void testLRU_KCorrelatedPeriod (void);
+static void test2Q (void);
+static void testReplacementPolicies (void);
+static void testWriteBack (void);
+static void testFlusher (void);
+static void testConcurrentPins (void);
+static void testSegmentedPageFile (void);
+static void testVectoredIO (void);
+static void testWriteCoalescing (void);
+static void testDirectIO (void);
+static void testMappedPageFile (void);
+static void testAsyncIO (void);
+static void testGroupCommit (void);
+static void testFileHeader (void);
+static void testPageChecksums (void);
+static void testPageSizes (void);
+static void testPageCompression (void);
+static void testFreePages (void);
+static void testPunchPages (void);
+
+// helper methods
+static void createDummyPages (int num);
+static void *runCommitWorker (void *arg);
+static void fillRecordPage (char *page, int seed);
+static long getFileSize (char *fileName);
+static double runSkewedWorkload (ReplacementStrategy strategy, int numFrames, int numRequests, double *pinsPerSec);
+
+char *testName;
+
+// main method
+int
+main (void)
+{
+	initStorageManager();
+	testName = "";
+
+	testPageTable();
+	testLRU();
+	testLRUSkipsPinnedPages();
+	testCLOCK();
+	testStrategyComparison();
+	testLFU();
+	testLFUAging();
+	testLRU_K();
+	testLRU_KCorrelatedPeriod();
+	test2Q();
+	testReplacementPolicies();
+	testWriteBack();
+	testFlusher();
+	testConcurrentPins();
+	testSegmentedPageFile();
+	testVectoredIO();
+	testWriteCoalescing();
+	testDirectIO();
+	testMappedPageFile();
+	testAsyncIO();
+	testGroupCommit();
+	testFileHeader();
+	testPageChecksums();
+	testPageSizes();
+	testPageCompression();
+	testFreePages();
+	testPunchPages();
+
+	return 0;
+}
+
+// write "Page-<i>" to the first num pages of testbuffer.bin
+void
+createDummyPages (int num)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	int i;
+
+	CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_FIFO, NULL));
+	for (i = 0; i < num; i++)
+	{
+		CHECK(pinPage(bm, h, i));
+		sprintf(h->data, "%s-%i", "Page", h->pageNum);
+		CHECK(markDirty(bm, h));
+		CHECK(unpinPage(bm,h));
+	}
+	CHECK(shutdownBufferPool(bm));
+	free(h);
+}
+
+// ************************************************************
+// pin more pages than the pool can hold and check that the page table
+// always maps exactly the pages that are stored in the frames
+void
+testPageTable (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	PageCache *pageCache;
+	PageNumber *frameContents;
+	int numFrames = 64, numPages = 500;
+	int i, mapped;
+	testName = "test page table lookups";
+
+	TEST_CHECK(createPageFile("testbuffer.bin"));
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", numFrames, RS_FIFO, NULL));
+	pageCache = bm->mgmtData;
+
+	for(i = 0; i < numPages; i++)
+	{
+		TEST_CHECK(pinPage(bm, h, i));
+		ASSERT_TRUE(searchPageFromCache(pageCache, i) != NULL, "pinned page is in the page table");
+		TEST_CHECK(unpinPage(bm, h));
+	}
+
+	// every resident page maps to its own frame
+	frameContents = getFrameContents(bm);
+	for(i = 0; i < numFrames; i++)
+	{
+		Frame *frame = searchPageFromCache(pageCache, frameContents[i]);
+		ASSERT_TRUE(frame != NULL && frame->frameIndex == i, "resident page maps to its frame");
+	}
+	free(frameContents);
+
+	// evicted pages are no longer mapped
+	mapped = 0;
+	for(i = 0; i < numPages; i++)
+		if (searchPageFromCache(pageCache, i) != NULL)
+			mapped++;
+	ASSERT_EQUALS_INT(numFrames, mapped, "only resident pages are mapped");
+	ASSERT_TRUE(searchPageFromCache(pageCache, 0) == NULL, "page 0 has been evicted");
+	ASSERT_EQUALS_INT(numPages, getNumReadIO(bm), "every page was read once");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+
+	free(h);
+	TEST_DONE();
+}
+
+// ************************************************************
+// test the LRU page replacement strategy
+void
+testLRU (void)
+{
+	// expected results
+	const char *poolContents[] = {
+		// read first five pages and directly unpin them
+		"[0 0],[-1 0],[-1 0],[-1 0],[-1 0]" ,
+		"[0 0],[1 0],[-1 0],[-1 0],[-1 0]",
+		"[0 0],[1 0],[2 0],[-1 0],[-1 0]",
+		"[0 0],[1 0],[2 0],[3 0],[-1 0]",
+		"[0 0],[1 0],[2 0],[3 0],[4 0]",
+		// use some of the page to create a fixed LRU order without changing pool content
+		"[0 0],[1 0],[2 0],[3 0],[4 0]",
+		"[0 0],[1 0],[2 0],[3 0],[4 0]",
+		"[0 0],[1 0],[2 0],[3 0],[4 0]",
+		"[0 0],[1 0],[2 0],[3 0],[4 0]",
+		"[0 0],[1 0],[2 0],[3 0],[4 0]",
+		// check that pages get evicted in LRU order
+		"[0 0],[1 0],[2 0],[5 0],[4 0]",
+		"[0 0],[1 0],[2 0],[5 0],[6 0]",
+		"[7 0],[1 0],[2 0],[5 0],[6 0]",
+		"[7 0],[1 0],[8 0],[5 0],[6 0]",
+		"[7 0],[9 0],[8 0],[5 0],[6 0]"
+	};
+	const int orderRequests[] = {3,4,0,2,1};
+	const int numLRUOrderChange = 5;
+
+	int i;
+	int snapshot = 0;
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	testName = "Testing LRU page replacement";
+
+	TEST_CHECK(createPageFile("testbuffer.bin"));
+	createDummyPages(100);
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 5, RS_LRU, NULL));
+
+	// reading first five pages linearly with direct unpin and no modifications
+	for(i = 0; i < 5; i++)
+	{
+		pinPage(bm, h, i);
+		unpinPage(bm, h);
+		ASSERT_EQUALS_POOL(poolContents[snapshot++], bm, "check pool content reading in pages");
+	}
+
+	// read pages to change LRU order
+	for(i = 0; i < numLRUOrderChange; i++)
+	{
+		pinPage(bm, h, orderRequests[i]);
+		unpinPage(bm, h);
+		ASSERT_EQUALS_POOL(poolContents[snapshot++], bm, "check pool content using pages");
+	}
+
+	// replace pages and check that it happens in LRU order
+	for(i = 0; i < 5; i++)
+	{
+		pinPage(bm, h, 5 + i);
+		unpinPage(bm, h);
+		ASSERT_EQUALS_POOL(poolContents[snapshot++], bm, "check pool content using pages");
+	}
+
+	// check number of write IOs
+	ASSERT_EQUALS_INT(0, getNumWriteIO(bm), "check number of write I/Os");
+	ASSERT_EQUALS_INT(10, getNumReadIO(bm), "check number of read I/Os");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+
+	free(h);
+	TEST_DONE();
+}
+
+// ************************************************************
+// the least recently used page is not evicted while it is pinned
+void
+testLRUSkipsPinnedPages (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	BM_PageHandle *h3 = MAKE_PAGE_HANDLE();
+	BM_PageHandle *pinned = MAKE_PAGE_HANDLE();
+	testName = "Testing LRU with pinned pages";
+
+	TEST_CHECK(createPageFile("testbuffer.bin"));
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LRU, NULL));
+
+	// page 0 is the least recently used page but stays pinned
+	TEST_CHECK(pinPage(bm, pinned, 0));
+	TEST_CHECK(pinPage(bm, h, 1));
+	TEST_CHECK(unpinPage(bm, h));
+	TEST_CHECK(pinPage(bm, h, 2));
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_EQUALS_POOL("[0 1],[1 0],[2 0]", bm, "pool is full");
+
+	TEST_CHECK(pinPage(bm, h, 3));
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_EQUALS_POOL("[0 1],[3 0],[2 0]", bm, "page 1 is evicted instead of pinned page 0");
+
+	// pin every frame
+	TEST_CHECK(pinPage(bm, h, 2));
+	TEST_CHECK(pinPage(bm, h3, 3));
+	ASSERT_ERROR(pinPage(bm, h, 4), "no frame can be evicted when every page is pinned");
+	ASSERT_EQUALS_POOL("[0 1],[3 1],[2 1]", bm, "pool content is unchanged");
+
+	h->pageNum = 2;
+	TEST_CHECK(unpinPage(bm, h));
+	TEST_CHECK(unpinPage(bm, h3));
+	TEST_CHECK(unpinPage(bm, pinned));
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+
+	free(h);
+	free(h3);
+	free(pinned);
+	TEST_DONE();
+}
+
+// ************************************************************
+// test the CLOCK page replacement strategy
+void
+testCLOCK (void)
+{
+	// expected results
+	const char *poolContents[] = {
+		// page 4 replaces page 0 after the hand clears every reference bit
+		"[4 0],[1 0],[2 0],[3 0]",
+		// page 1 was referenced again and gets a second chance
+		"[4 0],[1 0],[5 0],[3 0]",
+		"[4 0],[1 0],[5 0],[6 0]",
+		"[4 0],[7 0],[5 0],[6 0]"
+	};
+	const int requests[] = {4,1,5,6,7};
+	int i;
+	int snapshot = 0;
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	testName = "Testing CLOCK page replacement";
+
+	TEST_CHECK(createPageFile("testbuffer.bin"));
+	createDummyPages(100);
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 4, RS_CLOCK, NULL));
+
+	for(i = 0; i < 4; i++)
+	{
+		TEST_CHECK(pinPage(bm, h, i));
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	ASSERT_EQUALS_POOL("[0 0],[1 0],[2 0],[3 0]", bm, "check pool content reading in pages");
+
+	for(i = 0; i < 5; i++)
+	{
+		TEST_CHECK(pinPage(bm, h, requests[i]));
+		TEST_CHECK(unpinPage(bm, h));
+		// the hit on page 1 does not change the pool content
+		if (requests[i] != 1)
+			ASSERT_EQUALS_POOL(poolContents[snapshot++], bm, "check pool content using pages");
+	}
+
+	TEST_CHECK(pinPage(bm, h, 7));
+	ASSERT_EQUALS_STRING("Page-7", h->data, "replaced frame holds the new page");
+	TEST_CHECK(unpinPage(bm, h));
+
+	ASSERT_EQUALS_INT(0, getNumWriteIO(bm), "check number of write I/Os");
+	ASSERT_EQUALS_INT(8, getNumReadIO(bm), "check number of read I/Os");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+
+	free(h);
+	TEST_DONE();
+}
+
+// ************************************************************
+// compare hit ratio and throughput of the replacement strategies on a
+// workload where a small hot set receives most of the requests
+void
+testStrategyComparison (void)
+{
+	const int numFrames = 32, numRequests = 200000;
+	double fifo, lru, clock, lfu, lruk, twoQ, pinsPerSec;
+	testName = "Comparing replacement strategies";
+
+	TEST_CHECK(createPageFile("testbuffer.bin"));
+
+	fifo = runSkewedWorkload(RS_FIFO, numFrames, numRequests, &pinsPerSec);
+	printf("FIFO : hit ratio %.3f, %.0f pins/s\n", fifo, pinsPerSec);
+	lru = runSkewedWorkload(RS_LRU, numFrames, numRequests, &pinsPerSec);
+	printf("LRU  : hit ratio %.3f, %.0f pins/s\n", lru, pinsPerSec);
+	clock = runSkewedWorkload(RS_CLOCK, numFrames, numRequests, &pinsPerSec);
+	printf("CLOCK: hit ratio %.3f, %.0f pins/s\n", clock, pinsPerSec);
+	lfu = runSkewedWorkload(RS_LFU, numFrames, numRequests, &pinsPerSec);
+	printf("LFU  : hit ratio %.3f, %.0f pins/s\n", lfu, pinsPerSec);
+	lruk = runSkewedWorkload(RS_LRU_K, numFrames, numRequests, &pinsPerSec);
+	printf("LRU-K: hit ratio %.3f, %.0f pins/s\n", lruk, pinsPerSec);
+	twoQ = runSkewedWorkload(RS_2Q, numFrames, numRequests, &pinsPerSec);
+	printf("2Q   : hit ratio %.3f, %.0f pins/s\n", twoQ, pinsPerSec);
+
+	ASSERT_TRUE(clock > fifo, "CLOCK hits more often than FIFO");
+	ASSERT_TRUE(clock > lru - 0.05, "CLOCK hit ratio is close to LRU");
+	ASSERT_TRUE(lfu > lru, "LFU keeps the hot pages better than LRU");
+	ASSERT_TRUE(lruk > lru, "LRU-K keeps the hot pages better than LRU");
+	ASSERT_TRUE(twoQ > lru, "2Q keeps the hot pages better than LRU");
+
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+	TEST_DONE();
+}
+
+// Pin and unpin numRequests pages of testbuffer.bin: 80% of the requests go to
+// 16 hot pages and the rest to 1024 cold pages. Returns the hit ratio.
+double
+runSkewedWorkload (ReplacementStrategy strategy, int numFrames, int numRequests, double *pinsPerSec)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	unsigned int seed = 42;
+	struct timespec start, end;
+	double hitRatio;
+	int i;
+
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", numFrames, strategy, NULL));
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < numRequests; i++)
+	{
+		int pageNum;
+		seed = seed * 1103515245 + 12345;
+		if ((seed >> 16) % 10 < 8)
+			pageNum = (seed >> 8) % 16;
+		else
+			pageNum = 16 + (seed >> 4) % 1024;
+		TEST_CHECK(pinPage(bm, h, pageNum));
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	hitRatio = 1.0 - (double) getNumReadIO(bm) / numRequests;
+	*pinsPerSec = numRequests / ((end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	free(h);
+	return hitRatio;
+}
+
+// ************************************************************
+// test the LFU page replacement strategy
+void
+testLFU (void)
+{
+	const int requests[] = {0,1,2,0,0,1};
+	const int frequencies[] = {3,2,1};
+	int i;
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	testName = "Testing LFU page replacement";
+
+	TEST_CHECK(createPageFile("testbuffer.bin"));
+	createDummyPages(10);
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LFU, NULL));
+
+	for(i = 0; i < 6; i++)
+	{
+		TEST_CHECK(pinPage(bm, h, requests[i]));
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	ASSERT_EQUALS_POOL("[0 0],[1 0],[2 0]", bm, "check pool content reading in pages");
+	ASSERT_EQUALS_FREQUENCIES(frequencies, bm, "check reference counts");
+
+	// page 2 is the least frequently used page
+	TEST_CHECK(pinPage(bm, h, 3));
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_EQUALS_POOL("[0 0],[1 0],[3 0]", bm, "page 2 is replaced");
+
+	// the new page has been used once, so it is replaced next
+	TEST_CHECK(pinPage(bm, h, 4));
+	ASSERT_EQUALS_STRING("Page-4", h->data, "replaced frame holds the new page");
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_EQUALS_POOL("[0 0],[1 0],[4 0]", bm, "page 3 is replaced");
+	ASSERT_EQUALS_FREQUENCIES(frequencies, bm, "check reference counts");
+
+	ASSERT_EQUALS_INT(5, getNumReadIO(bm), "check number of read I/Os");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+
+	free(h);
+	TEST_DONE();
+}
+
+// ************************************************************
+// test that LFU halves the reference counts every aging period
+void
+testLFUAging (void)
+{
+	const int requests[] = {0,0,1,1,1};
+	const int agedFrequencies[] = {1,1};
+	int agingPeriod = 3;
+	int i;
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	testName = "Testing LFU aging";
+
+	TEST_CHECK(createPageFile("testbuffer.bin"));
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 2, RS_LFU, &agingPeriod));
+
+	// the third hit halves the counts 2 and 3 to 1
+	for(i = 0; i < 5; i++)
+	{
+		TEST_CHECK(pinPage(bm, h, requests[i]));
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	ASSERT_EQUALS_FREQUENCIES(agedFrequencies, bm, "counts are halved after the aging period");
+
+	// page 0 reached the merged count first and is replaced
+	TEST_CHECK(pinPage(bm, h, 2));
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_EQUALS_POOL("[2 0],[1 0]", bm, "page 0 is replaced");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+
+	free(h);
+	TEST_DONE();
+}
+
+// ************************************************************
+// test the LRU-K page replacement strategy with K = 2: pages referenced once
+// are replaced before pages referenced twice, even by a long scan
+void
+testLRU_K (void)
+{
+	const char *poolContents[] = {
+		// page 1 has been referenced once and page 0 twice
+		"[0 0],[3 0],[2 0]",
+		"[0 0],[3 0],[4 0]",
+		// page 1 comes back with its retained history and stays
+		"[0 0],[1 0],[4 0]",
+		"[0 0],[1 0],[5 0]"
+	};
+	const int requests[] = {0,1,2,0};
+	int i;
+	int snapshot = 0;
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	testName = "Testing LRU-K page replacement";
+
+	TEST_CHECK(createPageFile("testbuffer.bin"));
+	createDummyPages(30);
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LRU_K, NULL));
+
+	for(i = 0; i < 4; i++)
+	{
+		TEST_CHECK(pinPage(bm, h, requests[i]));
+		TEST_CHECK(unpinPage(bm, h));
+	}
+
+	TEST_CHECK(pinPage(bm, h, 3));
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_EQUALS_POOL(poolContents[snapshot++], bm, "check pool content using pages");
+	TEST_CHECK(pinPage(bm, h, 4));
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_EQUALS_POOL(poolContents[snapshot++], bm, "check pool content using pages");
+	TEST_CHECK(pinPage(bm, h, 1));
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_EQUALS_POOL(poolContents[snapshot++], bm, "check pool content using pages");
+	TEST_CHECK(pinPage(bm, h, 5));
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_EQUALS_POOL(poolContents[snapshot++], bm, "check pool content using pages");
+
+	// a scan over pages used once does not replace pages 0 and 1
+	for(i = 6; i < 30; i++)
+	{
+		TEST_CHECK(pinPage(bm, h, i));
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	ASSERT_EQUALS_POOL("[0 0],[1 0],[29 0]", bm, "scan only replaces its own pages");
+
+	TEST_CHECK(pinPage(bm, h, 1));
+	ASSERT_EQUALS_STRING("Page-1", h->data, "page 1 still holds its content");
+	TEST_CHECK(unpinPage(bm, h));
+
+	ASSERT_EQUALS_INT(0, getNumWriteIO(bm), "check number of write I/Os");
+	ASSERT_EQUALS_INT(31, getNumReadIO(bm), "check number of read I/Os");
+
+	// a pinned page with the largest distance is passed over, the pin is its
+	// second reference so it stays once it is unpinned
+	TEST_CHECK(pinPage(bm, h, 29));
+	TEST_CHECK(pinPage(bm, h, 6));
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_EQUALS_POOL("[6 0],[1 0],[29 1]", bm, "pinned page is not replaced");
+	h->pageNum = 29;
+	TEST_CHECK(unpinPage(bm, h));
+	TEST_CHECK(pinPage(bm, h, 7));
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_EQUALS_POOL("[7 0],[1 0],[29 0]", bm, "page referenced once is replaced");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+
+	free(h);
+	TEST_DONE();
+}
+
+// ************************************************************
+// test that references within the correlated reference period count once
+void
+testLRU_KCorrelatedPeriod (void)
+{
+	// page 0 is referenced twice in a row, page 1 twice far apart
+	const int requests[] = {1,0,0,2,1,2};
+	LRUKParams params = {2, 1};
+	BM_BufferPool *bm;
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	int i;
+	testName = "Testing LRU-K correlated reference period";
+
+	TEST_CHECK(createPageFile("testbuffer.bin"));
+
+	// without a correlated period page 1 has the oldest second reference
+	bm = MAKE_POOL();
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LRU_K, NULL));
+	for(i = 0; i < 6; i++)
+	{
+		TEST_CHECK(pinPage(bm, h, requests[i]));
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	TEST_CHECK(pinPage(bm, h, 3));
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_EQUALS_POOL("[3 0],[0 0],[2 0]", bm, "page 1 is replaced");
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	// with a correlated period of one tick page 0 was referenced only once
+	bm = MAKE_POOL();
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LRU_K, &params));
+	for(i = 0; i < 6; i++)
+	{
+		TEST_CHECK(pinPage(bm, h, requests[i]));
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	TEST_CHECK(pinPage(bm, h, 3));
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_EQUALS_POOL("[1 0],[3 0],[2 0]", bm, "page 0 is replaced");
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+
+	free(h);
+	TEST_DONE();
+}
+
+// ************************************************************
+// test the 2Q page replacement strategy: pages referenced once leave through
+// A1in, a page referenced again after that moves to Am and survives a scan
+void
+test2Q (void)
+{
+	const char *poolContents[] = {
+		"[4 0],[1 0],[2 0],[3 0]",
+		// page 0 is remembered in A1out, so it comes back into Am
+		"[4 0],[0 0],[2 0],[3 0]",
+		// the scan only replaces pages of A1in
+		"[7 0],[0 0],[8 0],[9 0]",
+		// a second reference inside A1in does not keep page 7
+		"[10 0],[0 0],[8 0],[9 0]",
+		"[10 0],[0 0],[7 0],[9 0]"
+	};
+	TwoQParams params = {1, 2};
+	int i;
+	int snapshot = 0;
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	testName = "Testing 2Q page replacement";
+
+	TEST_CHECK(createPageFile("testbuffer.bin"));
+	createDummyPages(11);
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 4, RS_2Q, &params));
+
+	for(i = 0; i < 5; i++)
+	{
+		TEST_CHECK(pinPage(bm, h, i));
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	ASSERT_EQUALS_POOL(poolContents[snapshot++], bm, "check pool content using pages");
+
+	TEST_CHECK(pinPage(bm, h, 0));
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_EQUALS_POOL(poolContents[snapshot++], bm, "check pool content using pages");
+
+	for(i = 5; i < 10; i++)
+	{
+		TEST_CHECK(pinPage(bm, h, i));
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	ASSERT_EQUALS_POOL(poolContents[snapshot++], bm, "check pool content using pages");
+
+	TEST_CHECK(pinPage(bm, h, 7));
+	TEST_CHECK(unpinPage(bm, h));
+	TEST_CHECK(pinPage(bm, h, 10));
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_EQUALS_POOL(poolContents[snapshot++], bm, "check pool content using pages");
+
+	TEST_CHECK(pinPage(bm, h, 7));
+	ASSERT_EQUALS_STRING("Page-7", h->data, "page 7 is read again");
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_EQUALS_POOL(poolContents[snapshot++], bm, "check pool content using pages");
+
+	ASSERT_EQUALS_INT(0, getNumWriteIO(bm), "check number of write I/Os");
+	ASSERT_EQUALS_INT(13, getNumReadIO(bm), "check number of read I/Os");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+
+	free(h);
+	TEST_DONE();
+}
+
+// ************************************************************
+// test that every replacement strategy is backed by a complete policy
+void
+testReplacementPolicies (void)
+{
+	const char *names[] = {"FIFO", "LRU", "CLOCK", "LFU", "LRU-K", "2Q"};
+	const ReplacementPolicy *policy;
+	BM_BufferPool *bm = MAKE_POOL();
+	int s;
+	testName = "Testing replacement policy table";
+
+	for (s = RS_FIFO; s <= RS_2Q; s++)
+	{
+		policy = getReplacementPolicy(s);
+		ASSERT_TRUE(policy != NULL, "strategy has a policy");
+		ASSERT_EQUALS_STRING(names[s], policy->name, "policy name");
+		ASSERT_TRUE(policy->onInsert != NULL && policy->chooseVictim != NULL, "policy has the mandatory hooks");
+	}
+	ASSERT_TRUE(getReplacementPolicy(RS_2Q + 1) == NULL, "unknown strategy has no policy");
+
+	TEST_CHECK(createPageFile("testbuffer.bin"));
+	ASSERT_EQUALS_INT(RC_ERROR, initBufferPool(bm, "testbuffer.bin", 3, RS_2Q + 1, NULL), "unknown strategy is rejected");
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+
+	free(bm);
+	TEST_DONE();
+}
+
+// ************************************************************
+// test that dirty pages are written on eviction and flush only, unless the
+// pool is switched to write-through
+void
+testWriteBack (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	int i;
+	testName = "Testing write-back and write-through";
+
+	TEST_CHECK(createPageFile("testbuffer.bin"));
+	createDummyPages(4);
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 2, RS_LRU, NULL));
+
+	// updating a page several times does not write it
+	for(i = 0; i < 3; i++)
+	{
+		TEST_CHECK(pinPage(bm, h, 0));
+		sprintf(h->data, "Page-0-%i", i);
+		TEST_CHECK(markDirty(bm, h));
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	ASSERT_EQUALS_POOL("[0x0],[-1 0]", bm, "page stays dirty after unpin");
+	ASSERT_EQUALS_INT(0, getNumWriteIO(bm), "no write while the page is cached");
+
+	// evicting the dirty page writes it once
+	TEST_CHECK(pinPage(bm, h, 1));
+	TEST_CHECK(unpinPage(bm, h));
+	TEST_CHECK(pinPage(bm, h, 2));
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_EQUALS_POOL("[2 0],[1 0]", bm, "dirty page is evicted");
+	ASSERT_EQUALS_INT(1, getNumWriteIO(bm), "evicted page is written");
+
+	// flushing writes the dirty pages
+	TEST_CHECK(pinPage(bm, h, 1));
+	TEST_CHECK(markDirty(bm, h));
+	TEST_CHECK(unpinPage(bm, h));
+	TEST_CHECK(forceFlushPool(bm));
+	ASSERT_EQUALS_POOL("[2 0],[1 0]", bm, "flushed pages are clean");
+	ASSERT_EQUALS_INT(2, getNumWriteIO(bm), "flushed page is written");
+
+	// a write-through pool writes on the last unpin
+	TEST_CHECK(setWriteThrough(bm, TRUE));
+	TEST_CHECK(pinPage(bm, h, 2));
+	TEST_CHECK(markDirty(bm, h));
+	TEST_CHECK(pinPage(bm, h, 2));
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_EQUALS_INT(2, getNumWriteIO(bm), "page is still pinned");
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_EQUALS_POOL("[2 0],[1 0]", bm, "page is written through");
+	ASSERT_EQUALS_INT(3, getNumWriteIO(bm), "page is written on the last unpin");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	// the evicted page was written with its last content
+	bm = MAKE_POOL();
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 2, RS_LRU, NULL));
+	TEST_CHECK(pinPage(bm, h, 0));
+	ASSERT_EQUALS_STRING("Page-0-2", h->data, "last update of page 0 is on disk");
+	TEST_CHECK(unpinPage(bm, h));
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+
+	free(h);
+	TEST_DONE();
+}
+
+// ************************************************************ 
+void
+testFlusher (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	struct timespec pause = {0, 1000000};
+	int i, waited;
+	testName = "Testing background flusher";
+
+	TEST_CHECK(createPageFile("testbuffer.bin"));
+	createDummyPages(8);
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 4, RS_LRU, NULL));
+
+	// dirty every cached page
+	for(i = 0; i < 4; i++)
+	{
+		TEST_CHECK(pinPage(bm, h, i));
+		sprintf(h->data, "Flushed-%i", i);
+		TEST_CHECK(markDirty(bm, h));
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	ASSERT_EQUALS_INT(0, getNumWriteIO(bm), "no write before the flusher runs");
+
+	// the flusher cleans all replacement candidates in the background
+	TEST_CHECK(startFlusher(bm, 1.0, 1));
+	for(waited = 0; getNumWriteIO(bm) < 4 && waited < 2000; waited++)
+		nanosleep(&pause, NULL);
+	TEST_CHECK(stopFlusher(bm));
+	ASSERT_EQUALS_INT(4, getNumWriteIO(bm), "flusher writes the dirty pages");
+	ASSERT_EQUALS_POOL("[0 0],[1 0],[2 0],[3 0]", bm, "flushed pages are clean");
+
+	// evictions now find clean victims and do not write
+	for(i = 4; i < 8; i++)
+	{
+		TEST_CHECK(pinPage(bm, h, i));
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	ASSERT_EQUALS_INT(4, getNumEvictions(bm), "every cached page is evicted");
+	ASSERT_EQUALS_INT(4, getNumCleanEvictions(bm), "every victim is clean");
+	ASSERT_EQUALS_INT(4, getNumWriteIO(bm), "evictions do not write");
+
+	// stopping a stopped flusher does nothing
+	TEST_CHECK(stopFlusher(bm));
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	// the flushed content is on disk
+	bm = MAKE_POOL();
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 4, RS_LRU, NULL));
+	for(i = 0; i < 4; i++)
+	{
+		char expected[PAGE_SIZE];
+		sprintf(expected, "Flushed-%i", i);
+		TEST_CHECK(pinPage(bm, h, i));
+		ASSERT_EQUALS_STRING(expected, h->data, "flushed page is on disk");
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+
+	free(h);
+	TEST_DONE();
+}
+
+// ************************************************************ 
+// worker of testConcurrentPins: increment the counter stored at the start of
+// random pages, updating each page under its exclusive latch
+typedef struct PinWorker {
+	BM_BufferPool *bm;
+	unsigned int seed;
+	int numPages;
+	int numOps;
+	int failures;
+} PinWorker;
+
+static void *
+runPinWorker (void *arg)
+{
+	PinWorker *w = (PinWorker *) arg;
+	BM_PageHandle h;
+	int i;
+
+	for(i = 0; i < w->numOps; i++)
+	{
+		w->seed = w->seed * 1103515245 + 12345;
+		if (pinPage(w->bm, &h, (w->seed >> 8) % w->numPages) != RC_OK)
+		{
+			w->failures++;
+			continue;
+		}
+		latchPage(w->bm, &h, TRUE);
+		(*(int *) h.data)++;
+		markDirty(w->bm, &h);
+		unlatchPage(w->bm, &h);
+		if (unpinPage(w->bm, &h) != RC_OK)
+			w->failures++;
+	}
+	return NULL;
+}
+
+// several threads pin, update and unpin pages of a pool much smaller than the
+// file, no update may be lost on eviction and no pin may be leaked
+void
+testConcurrentPins (void)
+{
+	const ReplacementStrategy strategies[] = { RS_LRU, RS_CLOCK };
+	const int numThreads = 4, numPages = 64, numOps = 20000;
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	int s, t, i, total;
+	testName = "Testing concurrent pins";
+
+	for(s = 0; s < 2; s++)
+	{
+		BM_BufferPool *bm = MAKE_POOL();
+		PinWorker workers[4];
+		pthread_t threads[4];
+		int *fixCounts;
+
+		TEST_CHECK(createPageFile("testbuffer.bin"));
+		TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 8, strategies[s], NULL));
+
+		for(t = 0; t < numThreads; t++)
+		{
+			workers[t].bm = bm;
+			workers[t].seed = t + 1;
+			workers[t].numPages = numPages;
+			workers[t].numOps = numOps;
+			workers[t].failures = 0;
+			pthread_create(&threads[t], NULL, runPinWorker, &workers[t]);
+		}
+		for(t = 0; t < numThreads; t++)
+		{
+			pthread_join(threads[t], NULL);
+			ASSERT_EQUALS_INT(0, workers[t].failures, "every pin and unpin succeeds");
+		}
+
+		fixCounts = getFixCounts(bm);
+		for(i = 0; i < bm->numPages; i++)
+			ASSERT_EQUALS_INT(0, fixCounts[i], "no pin is leaked");
+		free(fixCounts);
+		TEST_CHECK(shutdownBufferPool(bm));
+
+		// every increment reached the disk
+		bm = MAKE_POOL();
+		TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 8, strategies[s], NULL));
+		total = 0;
+		for(i = 0; i < numPages; i++)
+		{
+			TEST_CHECK(pinPage(bm, h, i));
+			total += *(int *) h->data;
+			TEST_CHECK(unpinPage(bm, h));
+		}
+		ASSERT_EQUALS_INT(numThreads * numOps, total, "no update is lost");
+		TEST_CHECK(shutdownBufferPool(bm));
+		TEST_CHECK(destroyPageFile("testbuffer.bin"));
+	}
+
+	free(h);
+	TEST_DONE();
+}
+
+// ************************************************************ 
+// check whether a file exists
+static bool
+fileExists (char *fileName)
+{
+	FILE *fp = fopen(fileName, "r");
+	if (fp == NULL)
+		return FALSE;
+	fclose(fp);
+	return TRUE;
+}
+
+// a page file split into segments of 4 pages is read and written through the
+// pool like a single file, and keeps its segments when it is opened again
+void
+testSegmentedPageFile (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	SM_FileHandle fh;
+	int i;
+	testName = "Testing segmented page files";
+
+	TEST_CHECK(setSegmentSize(4));
+	TEST_CHECK(createPageFile("testbuffer.bin"));
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LRU, NULL));
+	for(i = 0; i < 10; i++)
+	{
+		TEST_CHECK(pinPage(bm, h, i));
+		sprintf(h->data, "Segmented-%i", i);
+		TEST_CHECK(markDirty(bm, h));
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	ASSERT_TRUE(fileExists("testbuffer.bin.1"), "second segment exists");
+	ASSERT_TRUE(fileExists("testbuffer.bin.2"), "third segment exists");
+	ASSERT_TRUE(!fileExists("testbuffer.bin.3"), "ten pages fit in three segments");
+
+	// the file keeps its segment size when segmenting is turned off
+	TEST_CHECK(setSegmentSize(0));
+	TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+	ASSERT_EQUALS_INT(10, fh.totalNumPages, "pages of all segments are counted");
+	TEST_CHECK(closePageFile(&fh));
+
+	bm = MAKE_POOL();
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LRU, NULL));
+	for(i = 0; i < 12; i++)
+	{
+		char expected[PAGE_SIZE];
+		TEST_CHECK(pinPage(bm, h, i));
+		if (i < 10)
+		{
+			sprintf(expected, "Segmented-%i", i);
+			ASSERT_EQUALS_STRING(expected, h->data, "page is read from its segment");
+		}
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	TEST_CHECK(shutdownBufferPool(bm));
+	ASSERT_TRUE(!fileExists("testbuffer.bin.3"), "the last segment is filled first");
+
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+	ASSERT_TRUE(!fileExists("testbuffer.bin.1") && !fileExists("testbuffer.bin.2"), "segments are destroyed");
+
+	free(h);
+	TEST_DONE();
+}
+
+// ************************************************************ 
+// write and read runs of pages with one call, across segment boundaries
+void
+testVectoredIO (void)
+{
+	SM_FileHandle fh;
+	SM_PageHandle pages[10];
+	char page[PAGE_SIZE], expected[PAGE_SIZE];
+	int i;
+	testName = "Testing vectored reads and writes";
+
+	TEST_CHECK(setSegmentSize(4));
+	TEST_CHECK(createPageFile("testbuffer.bin"));
+	TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+	TEST_CHECK(ensureCapacity(10, &fh));
+
+	// pages 1 to 8 are in all three segments
+	for(i = 0; i < 10; i++)
+	{
+		pages[i] = (SM_PageHandle) calloc(PAGE_SIZE, sizeof(char));
+		sprintf(pages[i], "Vectored-%i", i);
+	}
+	TEST_CHECK(writeBlocks(1, 8, &fh, pages + 1));
+	ASSERT_EQUALS_INT(8, getBlockPos(&fh), "position moves to the last page written");
+
+	for(i = 0; i < 10; i++)
+	{
+		TEST_CHECK(readBlock(i, &fh, page));
+		if (i >= 1 && i <= 8)
+			sprintf(expected, "Vectored-%i", i);
+		else
+			expected[0] = '\0';
+		ASSERT_EQUALS_STRING(expected, page, "page written by writeBlocks");
+	}
+
+	for(i = 0; i < 10; i++)
+		memset(pages[i], 'x', PAGE_SIZE);
+	TEST_CHECK(readBlocks(0, 10, &fh, pages));
+	ASSERT_EQUALS_INT(9, getBlockPos(&fh), "position moves to the last page read");
+	ASSERT_EQUALS_STRING("", pages[0], "untouched page reads as zero bytes");
+	ASSERT_EQUALS_STRING("Vectored-5", pages[5], "page read by readBlocks");
+	ASSERT_EQUALS_STRING("", pages[9], "untouched last page reads as zero bytes");
+
+	ASSERT_EQUALS_INT(RC_READ_NON_EXISTING_PAGE, readBlocks(8, 3, &fh, pages), "run past the end is not read");
+	ASSERT_EQUALS_INT(RC_READ_NON_EXISTING_PAGE, writeBlocks(9, 2, &fh, pages), "run past the end is not written");
+
+	for(i = 0; i < 10; i++)
+		free(pages[i]);
+	TEST_CHECK(closePageFile(&fh));
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+	TEST_CHECK(setSegmentSize(0));
+	TEST_DONE();
+}
+
+// ************************************************************ 
+// forceFlushPool writes the dirty pages in page order, each run of adjacent
+// pages with one call
+void
+testWriteCoalescing (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	BM_PageHandle *pinned = MAKE_PAGE_HANDLE();
+	const int dirty[] = { 5, 1, 2, 3, 7, 6 };
+	int i;
+	testName = "Testing coalesced writes";
+
+	TEST_CHECK(createPageFile("testbuffer.bin"));
+	createDummyPages(8);
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 8, RS_LRU, NULL));
+
+	for(i = 0; i < 6; i++)
+	{
+		TEST_CHECK(pinPage(bm, h, dirty[i]));
+		sprintf(h->data, "Coalesced-%i", dirty[i]);
+		TEST_CHECK(markDirty(bm, h));
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	// a clean page between the runs and a pinned dirty page are not written
+	TEST_CHECK(pinPage(bm, h, 4));
+	TEST_CHECK(unpinPage(bm, h));
+	TEST_CHECK(pinPage(bm, pinned, 0));
+	TEST_CHECK(markDirty(bm, pinned));
+
+	TEST_CHECK(forceFlushPool(bm));
+	ASSERT_EQUALS_INT(6, getNumWriteIO(bm), "every unpinned dirty page is written");
+	ASSERT_EQUALS_INT(4, getNumCoalescedWrites(bm), "runs 1-3 and 5-7 take one write each");
+
+	TEST_CHECK(unpinPage(bm, pinned));
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	bm = MAKE_POOL();
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 8, RS_LRU, NULL));
+	for(i = 1; i < 8; i++)
+	{
+		char expected[PAGE_SIZE];
+		sprintf(expected, (i == 4) ? "Page-%i" : "Coalesced-%i", i);
+		TEST_CHECK(pinPage(bm, h, i));
+		ASSERT_EQUALS_STRING(expected, h->data, "coalesced page is on disk");
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+
+	free(h);
+	free(pinned);
+	TEST_DONE();
+}
+
+// ************************************************************ 
+// with direct I/O, pages in aligned and unaligned buffers and pages of the
+// buffer pool go to the file and come back unchanged
+void
+testDirectIO (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	SM_FileHandle fh;
+	SM_PageHandle pages[4];
+	char *unaligned = (char *) malloc(PAGE_SIZE + 1);
+	char expected[PAGE_SIZE];
+	int i;
+	testName = "Testing direct I/O";
+
+	TEST_CHECK(setDirectIO(1));
+	TEST_CHECK(createPageFile("testbuffer.bin"));
+	TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+	TEST_CHECK(ensureCapacity(4, &fh));
+
+	// one byte past an allocation is never aligned
+	sprintf(unaligned + 1, "Unaligned-%i", 1);
+	TEST_CHECK(writeBlock(1, &fh, unaligned + 1));
+	memset(unaligned, 'x', PAGE_SIZE + 1);
+	TEST_CHECK(readBlock(1, &fh, unaligned + 1));
+	ASSERT_EQUALS_STRING("Unaligned-1", unaligned + 1, "unaligned page is read back");
+
+	// a run mixing both kinds of buffers
+	for(i = 0; i < 4; i++)
+	{
+		pages[i] = (SM_PageHandle) calloc(PAGE_SIZE, sizeof(char));
+		sprintf(pages[i], "Direct-%i", i);
+	}
+	pages[2] = unaligned + 1;
+	sprintf(pages[2], "Direct-%i", 2);
+	TEST_CHECK(writeBlocks(0, 4, &fh, pages));
+	for(i = 0; i < 4; i++)
+		memset(pages[i], 'x', PAGE_SIZE);
+	TEST_CHECK(readBlocks(0, 4, &fh, pages));
+	for(i = 0; i < 4; i++)
+	{
+		sprintf(expected, "Direct-%i", i);
+		ASSERT_EQUALS_STRING(expected, pages[i], "page of a mixed run is read back");
+	}
+	for(i = 0; i < 4; i++)
+		if (i != 2)
+			free(pages[i]);
+	TEST_CHECK(closePageFile(&fh));
+
+	// frames are aligned, so the pool reads and writes them in place
+	createDummyPages(8);
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LRU, NULL));
+	for(i = 0; i < 8; i++)
+	{
+		TEST_CHECK(pinPage(bm, h, i));
+		ASSERT_TRUE((uintptr_t) h->data % PAGE_SIZE == 0, "frame is aligned to the page size");
+		sprintf(expected, "%s-%i", "Page", i);
+		ASSERT_EQUALS_STRING(expected, h->data, "page written through the pool is read back");
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+	TEST_CHECK(setDirectIO(0));
+	free(unaligned);
+	free(h);
+	TEST_DONE();
+}
+
+// ************************************************************ 
+// the storage manager tests of assign1 on a mapped file, which grows over
+// segments while a page is accessed in place
+void
+testMappedPageFile (void)
+{
+	SM_FileHandle fh;
+	SM_PageHandle ph = (SM_PageHandle) calloc(PAGE_SIZE, sizeof(char));
+	SM_PageHandle first, last;
+	char expected[PAGE_SIZE];
+	int i;
+	testName = "Testing memory-mapped page files";
+
+	TEST_CHECK(setSegmentSize(4));
+	TEST_CHECK(createPageFile("testbuffer.bin"));
+	TEST_CHECK(openMappedPageFile("testbuffer.bin", &fh));
+	ASSERT_EQUALS_INT(1, fh.totalNumPages, "expect 1 page in new file");
+	ASSERT_EQUALS_INT(0, getBlockPos(&fh), "freshly opened file's page position should be 0");
+
+	// single page content
+	TEST_CHECK(readFirstBlock(&fh, ph));
+	for (i = 0; i < PAGE_SIZE; i++)
+		ASSERT_TRUE(ph[i] == 0, "expected zero byte in first page of freshly initialized page");
+	for (i = 0; i < PAGE_SIZE; i++)
+		ph[i] = (i % 10) + '0';
+	TEST_CHECK(writeBlock(0, &fh, ph));
+	memset(ph, 0, PAGE_SIZE);
+	TEST_CHECK(readFirstBlock(&fh, ph));
+	for (i = 0; i < PAGE_SIZE; i++)
+		ASSERT_TRUE(ph[i] == (i % 10) + '0', "character in page read from disk is the one we expected.");
+
+	// the mapped page is the page written
+	TEST_CHECK(getBlockPointer(0, &fh, &first));
+	ASSERT_TRUE(memcmp(first, ph, PAGE_SIZE) == 0, "mapped page holds the page written");
+
+	// multiple page content
+	TEST_CHECK(appendEmptyBlock(&fh));
+	TEST_CHECK(readNextBlock(&fh, ph));
+	for (i = 0; i < PAGE_SIZE; i++)
+		ASSERT_TRUE(ph[i] == 0, "expected zero byte in new page of freshly initialized page");
+
+	// expand capacity into the third segment, the mapping does not move
+	TEST_CHECK(ensureCapacity(10, &fh));
+	ASSERT_EQUALS_INT(10, fh.totalNumPages, "expanded to 10");
+	TEST_CHECK(getBlockPointer(9, &fh, &last));
+	ASSERT_TRUE(last == first + 9 * PAGE_SIZE, "pages are mapped in order over segments");
+	sprintf(last, "Mapped-%i", 9);
+	ASSERT_EQUALS_INT(RC_READ_NON_EXISTING_PAGE, getBlockPointer(10, &fh, &last), "page past the end is not mapped");
+	for (i = 2; i < 9; i++)
+	{
+		sprintf(ph, "Mapped-%i", i);
+		TEST_CHECK(writeBlock(i, &fh, ph));
+	}
+	TEST_CHECK(closePageFile(&fh));
+
+	// the pages written either way are in the file
+	TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+	ASSERT_EQUALS_INT(10, fh.totalNumPages, "file keeps its pages");
+	for (i = 2; i < 10; i++)
+	{
+		TEST_CHECK(readBlock(i, &fh, ph));
+		sprintf(expected, "Mapped-%i", i);
+		ASSERT_EQUALS_STRING(expected, ph, "page written through the mapping is read back");
+	}
+	ASSERT_EQUALS_INT(RC_PARAMS_ERROR, getBlockPointer(0, &fh, &first), "file that is not mapped has no pointers");
+	TEST_CHECK(closePageFile(&fh));
+
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+	TEST_CHECK(setSegmentSize(0));
+	free(ph);
+	TEST_DONE();
+}
+
+// ************************************************************ 
+// asynchronous writes and reads of more pages than the queue depth, over 
+// segments, with io_uring and with the worker threads
+void
+testAsyncIO (void)
+{
+	const int numPages = 12;
+	SM_FileHandle fh;
+	SM_PageHandle pages[12];
+	SM_AsyncToken tokens[12];
+	SM_AsyncEngine engine;
+	char expected[PAGE_SIZE];
+	int e, i;
+	RC rc;
+	testName = "Testing asynchronous I/O";
+
+	for(i = 0; i < numPages; i++)
+		pages[i] = (SM_PageHandle) calloc(PAGE_SIZE, sizeof(char));
+	TEST_CHECK(setSegmentSize(4));
+
+	for(e = SM_ASYNC_IO_URING; e <= SM_ASYNC_THREADS; e++)
+	{
+		TEST_CHECK(setAsyncEngine(e, 4));
+		TEST_CHECK(createPageFile("testbuffer.bin"));
+		TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+		TEST_CHECK(ensureCapacity(numPages, &fh));
+		TEST_CHECK(getAsyncEngine(&fh, &engine));
+		if (e == SM_ASYNC_THREADS)
+			ASSERT_EQUALS_INT(SM_ASYNC_THREADS, engine, "worker threads are used when selected");
+
+		// the writes are waited for in reverse order
+		for(i = 0; i < numPages; i++)
+		{
+			sprintf(pages[i], "Async-%i-%i", e, i);
+			TEST_CHECK(submitWriteBlock(i, &fh, pages[i], &tokens[i]));
+		}
+		for(i = numPages - 1; i >= 0; i--)
+			TEST_CHECK(waitBlock(tokens[i], &fh));
+		ASSERT_EQUALS_INT(RC_PARAMS_ERROR, waitBlock(tokens[0], &fh), "token is released once waited for");
+
+		// the first read is polled until it is done
+		for(i = 0; i < numPages; i++)
+		{
+			memset(pages[i], 'x', PAGE_SIZE);
+			TEST_CHECK(submitReadBlock(i, &fh, pages[i], &tokens[i]));
+		}
+		while ((rc = pollBlock(tokens[0], &fh)) == RC_ASYNC_PENDING)
+			;
+		TEST_CHECK(rc);
+		for(i = 1; i < numPages; i++)
+			TEST_CHECK(waitBlock(tokens[i], &fh));
+		for(i = 0; i < numPages; i++)
+		{
+			sprintf(expected, "Async-%i-%i", e, i);
+			ASSERT_EQUALS_STRING(expected, pages[i], "page written asynchronously is read back");
+		}
+		ASSERT_EQUALS_INT(RC_READ_NON_EXISTING_PAGE, submitReadBlock(numPages, &fh, pages[0], &tokens[0]),
+				"page past the end is not read");
+
+		// closing the file waits for the writes in flight
+		for(i = 0; i < numPages; i++)
+		{
+			sprintf(pages[i], "Closed-%i-%i", e, i);
+			TEST_CHECK(submitWriteBlock(i, &fh, pages[i], &tokens[i]));
+		}
+		TEST_CHECK(closePageFile(&fh));
+		TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+		for(i = 0; i < numPages; i++)
+		{
+			TEST_CHECK(readBlock(i, &fh, expected));
+			ASSERT_EQUALS_STRING(pages[i], expected, "write in flight at close is in the file");
+		}
+		TEST_CHECK(closePageFile(&fh));
+		TEST_CHECK(destroyPageFile("testbuffer.bin"));
+	}
+
+	TEST_CHECK(setAsyncEngine(SM_ASYNC_IO_URING, 32));
+	TEST_CHECK(setSegmentSize(0));
+	for(i = 0; i < numPages; i++)
+		free(pages[i]);
+	TEST_DONE();
+}
+
+// a thread that writes its own page and forces it, again and again
+typedef struct CommitWorker {
+	SM_FileHandle *fh;
+	int pageNum;
+	int numCommits;
+	RC rc;
+} CommitWorker;
+
+void *
+runCommitWorker (void *arg)
+{
+	CommitWorker *w = arg;
+	SM_PageHandle ph = (SM_PageHandle) calloc(PAGE_SIZE, sizeof(char));
+	int i;
+
+	w->rc = RC_OK;
+	for(i = 0; i < w->numCommits && w->rc == RC_OK; i++)
+	{
+		sprintf(ph, "Commit-%i-%i", w->pageNum, i);
+		w->rc = writeBlock(w->pageNum, w->fh, ph);
+		if (w->rc == RC_OK)
+			w->rc = syncPageFile(w->fh);
+	}
+	free(ph);
+	return NULL;
+}
+
+// ************************************************************ 
+// syncs issued for every write, for the force requests of a group commit, and
+// for the forces of the buffer pool
+void
+testGroupCommit (void)
+{
+	const int numThreads = 4, numCommits = 20;
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	SM_FileHandle fh;
+	SM_PageHandle pages[2];
+	CommitWorker workers[4];
+	pthread_t threads[4];
+	char expected[PAGE_SIZE];
+	int i;
+	testName = "Testing group commit";
+
+	TEST_CHECK(createPageFile("testbuffer.bin"));
+	TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+	TEST_CHECK(ensureCapacity(numThreads, &fh));
+	pages[0] = (SM_PageHandle) calloc(PAGE_SIZE, sizeof(char));
+	pages[1] = (SM_PageHandle) calloc(PAGE_SIZE, sizeof(char));
+
+	// without durability nothing is synced
+	TEST_CHECK(writeBlock(0, &fh, pages[0]));
+	TEST_CHECK(syncPageFile(&fh));
+	ASSERT_EQUALS_INT(0, getNumSyncs(&fh), "no sync without durability");
+	ASSERT_EQUALS_INT(1, getNumForceRequests(&fh), "force request is served");
+
+	// every write is synced, a force has nothing left to do
+	TEST_CHECK(setDurability(&fh, SM_DURABILITY_SYNC, 0));
+	TEST_CHECK(writeBlock(0, &fh, pages[0]));
+	TEST_CHECK(writeBlocks(1, 2, &fh, pages));
+	TEST_CHECK(syncPageFile(&fh));
+	ASSERT_EQUALS_INT(2, getNumSyncs(&fh), "one sync per write call");
+
+	// concurrent forces share syncs
+	TEST_CHECK(setDurability(&fh, SM_DURABILITY_GROUP_COMMIT, 2000));
+	for(i = 0; i < numThreads; i++)
+	{
+		workers[i].fh = &fh;
+		workers[i].pageNum = i;
+		workers[i].numCommits = numCommits;
+		pthread_create(&threads[i], NULL, runCommitWorker, &workers[i]);
+	}
+	for(i = 0; i < numThreads; i++)
+	{
+		pthread_join(threads[i], NULL);
+		TEST_CHECK(workers[i].rc);
+	}
+	ASSERT_EQUALS_INT(2 + numThreads * numCommits, getNumForceRequests(&fh), "every force request is served");
+	ASSERT_TRUE(getNumSyncs(&fh) - 2 < numThreads * numCommits, "force requests share syncs");
+	for(i = 0; i < numThreads; i++)
+	{
+		TEST_CHECK(readBlock(i, &fh, pages[0]));
+		sprintf(expected, "Commit-%i-%i", i, numCommits - 1);
+		ASSERT_EQUALS_STRING(expected, pages[0], "last commit of each thread is in the file");
+	}
+	TEST_CHECK(closePageFile(&fh));
+
+	// forcing a page of the pool syncs the file
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LRU, NULL));
+	TEST_CHECK(setPoolDurability(bm, SM_DURABILITY_GROUP_COMMIT, 0));
+	TEST_CHECK(pinPage(bm, h, 1));
+	sprintf(h->data, "%s", "Forced");
+	TEST_CHECK(markDirty(bm, h));
+	TEST_CHECK(forcePage(bm, h));
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_EQUALS_INT(1, getNumSyncs(((PageCache *) bm->mgmtData)->fHandle), "forcePage syncs the file");
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+	free(pages[0]);
+	free(pages[1]);
+	free(h);
+	TEST_DONE();
+}
+
+// ************************************************************ 
+// the page count is read from the header page, files without a header are
+// measured, and files of a later format are refused
+void
+testFileHeader (void)
+{
+	SM_FileHandle fh;
+	SM_PageHandle ph = (SM_PageHandle) calloc(PAGE_SIZE, sizeof(char));
+	int version = 99;
+	FILE *fp;
+	int i;
+	testName = "Testing page file headers";
+
+	TEST_CHECK(createPageFile("testbuffer.bin"));
+	fp = fopen("testbuffer.bin", "rb");
+	ASSERT_TRUE(fread(ph, 1, PAGE_SIZE, fp) == PAGE_SIZE, "header page is written");
+	ASSERT_TRUE(memcmp(ph, "PAGEFILE", 8) == 0, "header starts with the magic");
+	fseek(fp, 0, SEEK_END);
+	ASSERT_EQUALS_INT(2 * PAGE_SIZE, (int) ftell(fp), "header page and one page");
+	fclose(fp);
+
+	TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+	TEST_CHECK(ensureCapacity(5, &fh));
+	sprintf(ph, "%s", "Header-0");
+	TEST_CHECK(writeBlock(0, &fh, ph));
+	TEST_CHECK(closePageFile(&fh));
+
+	// bytes past the last page are not taken for pages
+	fp = fopen("testbuffer.bin", "ab");
+	fwrite(ph, 1, PAGE_SIZE, fp);
+	fclose(fp);
+	TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+	ASSERT_EQUALS_INT(5, fh.totalNumPages, "page count is read from the header");
+	TEST_CHECK(readBlock(0, &fh, ph));
+	ASSERT_EQUALS_STRING("Header-0", ph, "first page follows the header");
+	TEST_CHECK(closePageFile(&fh));
+
+	// a later format version is refused
+	fp = fopen("testbuffer.bin", "r+b");
+	fseek(fp, 8, SEEK_SET);
+	fwrite(&version, sizeof(int), 1, fp);
+	fclose(fp);
+	ASSERT_EQUALS_INT(RC_FILE_FORMAT_UNSUPPORTED, openPageFile("testbuffer.bin", &fh), "later version is refused");
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+
+	// a file without a header has as many pages as it is long
+	fp = fopen("testbuffer.bin", "wb");
+	for(i = 0; i < 3; i++)
+	{
+		memset(ph, 0, PAGE_SIZE);
+		sprintf(ph, "Legacy-%i", i);
+		fwrite(ph, 1, PAGE_SIZE, fp);
+	}
+	fclose(fp);
+	TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+	ASSERT_EQUALS_INT(3, fh.totalNumPages, "file without a header is measured");
+	TEST_CHECK(readBlock(0, &fh, ph));
+	ASSERT_EQUALS_STRING("Legacy-0", ph, "first page of a file without a header");
+	TEST_CHECK(appendEmptyBlock(&fh));
+	TEST_CHECK(closePageFile(&fh));
+	TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+	ASSERT_EQUALS_INT(4, fh.totalNumPages, "file without a header grows");
+	TEST_CHECK(closePageFile(&fh));
+
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+	free(ph);
+	TEST_DONE();
+}
+
+// ************************************************************ 
+// pages of a file with checksums are checked when they are read, a corrupted
+// page is reported whichever way it is read, and pages that were never
+// written are accepted
+void
+testPageChecksums (void)
+{
+	SM_FileHandle fh;
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	SM_PageHandle ph = (SM_PageHandle) calloc(PAGE_SIZE, sizeof(char));
+	SM_PageHandle pages[4];
+	SM_AsyncToken token;
+	uint32_t crc;
+	FILE *fp;
+	int i;
+	testName = "Testing page checksums";
+
+	ASSERT_TRUE(crc32c(0, "123456789", 9) == 0xE3069283, "CRC32C of the check string");
+	ASSERT_TRUE(crc32cSlicingBy8(0, "123456789", 9) == 0xE3069283, "slicing-by-8 CRC32C of the check string");
+	for(i = 0; i < PAGE_SIZE; i++)
+		ph[i] = (char) (i * 7);
+	ASSERT_TRUE(crc32c(crc32c(0, ph, 1000), ph + 1000, PAGE_SIZE - 1000) == crc32cSlicingBy8(0, ph, PAGE_SIZE),
+		"CRC32C continues and matches the tables");
+
+	TEST_CHECK(setPageChecksums(1));
+	TEST_CHECK(createPageFile("testbuffer.bin"));
+	TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+	TEST_CHECK(ensureCapacity(6, &fh));
+	for(i = 0; i < 4; i++)
+	{
+		pages[i] = (SM_PageHandle) calloc(PAGE_SIZE, sizeof(char));
+		sprintf(pages[i], "Checked-%i", i);
+	}
+	TEST_CHECK(writeBlocks(0, 4, &fh, pages));
+	memset(ph, 0, PAGE_SIZE);
+	sprintf(ph, "%s", "Trailer");
+	memset(ph + PAGE_SIZE - PAGE_CHECKSUM_SIZE, 'x', PAGE_CHECKSUM_SIZE);
+	TEST_CHECK(writeBlock(4, &fh, ph));
+	ASSERT_TRUE(ph[PAGE_SIZE - 1] == 'x', "writing leaves the buffer as it is");
+	TEST_CHECK(readBlock(4, &fh, ph));
+	ASSERT_EQUALS_STRING("Trailer", ph, "page is read back");
+	crc = crc32c(0, ph, PAGE_SIZE - PAGE_CHECKSUM_SIZE);
+	ASSERT_TRUE(memcmp(ph + PAGE_SIZE - PAGE_CHECKSUM_SIZE, &crc, PAGE_CHECKSUM_SIZE) == 0, "trailer holds the checksum");
+	TEST_CHECK(readBlock(5, &fh, ph));
+	TEST_CHECK(closePageFile(&fh));
+
+	// flip a byte of page 2 on disk, behind the header page
+	fp = fopen("testbuffer.bin", "r+b");
+	fseek(fp, 3 * PAGE_SIZE + 100, SEEK_SET);
+	fputc('!', fp);
+	fclose(fp);
+
+	TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+	TEST_CHECK(readBlock(1, &fh, ph));
+	ASSERT_EQUALS_STRING("Checked-1", ph, "intact page is read");
+	ASSERT_EQUALS_INT(RC_CHECKSUM_MISMATCH, readBlock(2, &fh, ph), "corrupted page is detected");
+	ASSERT_EQUALS_INT(RC_CHECKSUM_MISMATCH, readBlocks(0, 4, &fh, pages), "corrupted page is detected in a vector");
+	TEST_CHECK(submitReadBlock(2, &fh, ph, &token));
+	ASSERT_EQUALS_INT(RC_CHECKSUM_MISMATCH, waitBlock(token, &fh), "corrupted page is detected asynchronously");
+	TEST_CHECK(submitWriteBlock(3, &fh, pages[3], &token));
+	TEST_CHECK(waitBlock(token, &fh));
+	TEST_CHECK(submitReadBlock(3, &fh, ph, &token));
+	TEST_CHECK(waitBlock(token, &fh));
+	ASSERT_EQUALS_STRING("Checked-3", ph, "asynchronous write keeps the checksum");
+	TEST_CHECK(closePageFile(&fh));
+
+	TEST_CHECK(openMappedPageFile("testbuffer.bin", &fh));
+	ASSERT_EQUALS_INT(RC_CHECKSUM_MISMATCH, readBlock(2, &fh, ph), "corrupted mapped page is detected");
+	TEST_CHECK(writeBlock(2, &fh, pages[2]));
+	TEST_CHECK(readBlock(2, &fh, ph));
+	ASSERT_EQUALS_STRING("Checked-2", ph, "rewritten page has a new checksum");
+	TEST_CHECK(closePageFile(&fh));
+
+	// direct I/O writes the checksum through an aligned copy
+	TEST_CHECK(setDirectIO(1));
+	TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+	TEST_CHECK(writeBlock(1, &fh, pages[0]));
+	TEST_CHECK(readBlock(1, &fh, ph));
+	ASSERT_EQUALS_STRING("Checked-0", ph, "page is read back with direct I/O");
+	TEST_CHECK(closePageFile(&fh));
+	TEST_CHECK(setDirectIO(0));
+
+	// the buffer pool reports the error of the page it reads
+	fp = fopen("testbuffer.bin", "r+b");
+	fseek(fp, 2 * PAGE_SIZE + 100, SEEK_SET);
+	fputc('!', fp);
+	fclose(fp);
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LRU, NULL));
+	TEST_CHECK(pinPage(bm, h, 0));
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_EQUALS_INT(RC_CHECKSUM_MISMATCH, pinPage(bm, h, 1), "pool reports a corrupted page");
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	TEST_CHECK(setPageChecksums(0));
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+	for(i = 0; i < 4; i++)
+		free(pages[i]);
+	free(ph);
+	free(h);
+	TEST_DONE();
+}
+
+// ************************************************************ 
+// files are created with the page size selected at the time, keep it when
+// they are opened again, and buffer pools hold pages of that size
+void
+testPageSizes (void)
+{
+	int sizes[] = { PAGE_SIZE, 16384, MAX_PAGE_SIZE };
+	SM_FileHandle fh;
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	SM_PageHandle ph;
+	FILE *fp;
+	int s, i;
+	testName = "Testing page sizes";
+
+	ASSERT_EQUALS_INT(RC_PARAMS_ERROR, setPageSize(PAGE_SIZE / 2), "smaller pages are refused");
+	ASSERT_EQUALS_INT(RC_PARAMS_ERROR, setPageSize(3 * PAGE_SIZE), "page size must be a power of two");
+	ASSERT_EQUALS_INT(RC_PARAMS_ERROR, setPageSize(2 * MAX_PAGE_SIZE), "larger pages are refused");
+
+	for(s = 0; s < 3; s++)
+	{
+		int size = sizes[s];
+		ph = (SM_PageHandle) calloc(size, sizeof(char));
+
+		TEST_CHECK(setPageSize(size));
+		TEST_CHECK(createPageFile("testbuffer.bin"));
+		TEST_CHECK(setPageSize(PAGE_SIZE));
+		TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+		ASSERT_EQUALS_INT(size, fh.pageSize, "page size is read from the header");
+		TEST_CHECK(ensureCapacity(4, &fh));
+		for(i = 0; i < 4; i++)
+		{
+			sprintf(ph, "Sized-%i", i);
+			ph[size - 1] = (char) ('a' + i);
+			TEST_CHECK(writeBlock(i, &fh, ph));
+		}
+		TEST_CHECK(closePageFile(&fh));
+
+		fp = fopen("testbuffer.bin", "rb");
+		fseek(fp, 0, SEEK_END);
+		ASSERT_EQUALS_INT(5 * size, (int) ftell(fp), "header page and pages of the selected size");
+		fclose(fp);
+
+		// the whole page is read, in place and through the mapping
+		TEST_CHECK(openMappedPageFile("testbuffer.bin", &fh));
+		memset(ph, 0, size);
+		TEST_CHECK(readBlock(3, &fh, ph));
+		ASSERT_EQUALS_STRING("Sized-3", ph, "page is read back");
+		ASSERT_TRUE(ph[size - 1] == 'd', "last byte of the page is read back");
+		TEST_CHECK(closePageFile(&fh));
+
+		// frames are as large as the pages
+		TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 2, RS_LRU, NULL));
+		ASSERT_EQUALS_INT(size, bm->pageSize, "pool takes the page size of the file");
+		TEST_CHECK(pinPage(bm, h, 2));
+		ASSERT_TRUE(h->data[size - 1] == 'c', "frame holds the whole page");
+		h->data[size - 1] = 'z';
+		TEST_CHECK(markDirty(bm, h));
+		TEST_CHECK(unpinPage(bm, h));
+		TEST_CHECK(shutdownBufferPool(bm));
+		bm = MAKE_POOL();
+
+		TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+		TEST_CHECK(readBlock(2, &fh, ph));
+		ASSERT_TRUE(ph[size - 1] == 'z', "frame is written back whole");
+		TEST_CHECK(closePageFile(&fh));
+		TEST_CHECK(destroyPageFile("testbuffer.bin"));
+		free(ph);
+	}
+
+	free(bm);
+	free(h);
+	TEST_DONE();
+}
+
+// ************************************************************ 
+// pages of a compressed file take about the space they compress to, read
+// back as they were written however they are read, and move to another slot
+// when they no longer fit theirs
+void
+testPageCompression (void)
+{
+	SM_FileHandle fh;
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	SM_PageHandle ph = (SM_PageHandle) calloc(PAGE_SIZE, sizeof(char));
+	SM_PageHandle page = (SM_PageHandle) calloc(PAGE_SIZE, sizeof(char));
+	char *packed = (char *) malloc(PAGE_SIZE);
+	SM_AsyncToken token;
+	FILE *fp;
+	long size;
+	int i, n;
+	testName = "Testing page compression";
+
+	fillRecordPage(page, 1);
+	n = lzCompress(page, PAGE_SIZE, packed, PAGE_SIZE - 1);
+	ASSERT_TRUE(n > 0 && n < PAGE_SIZE / 2, "record page compresses");
+	ASSERT_EQUALS_INT(PAGE_SIZE, lzDecompress(packed, n, ph, PAGE_SIZE), "record page decompresses");
+	ASSERT_TRUE(memcmp(page, ph, PAGE_SIZE) == 0, "record page is restored");
+	ASSERT_EQUALS_INT(-1, lzDecompress(packed, n, ph, PAGE_SIZE / 2), "output that does not fit is refused");
+	srand(23);
+	for(i = 0; i < PAGE_SIZE; i++)
+		page[i] = (char) rand();
+	ASSERT_EQUALS_INT(0, lzCompress(page, PAGE_SIZE, packed, PAGE_SIZE - 1), "random page does not compress");
+
+	TEST_CHECK(setPageCompression(1));
+	TEST_CHECK(createPageFile("testbuffer.bin"));
+	TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+	TEST_CHECK(ensureCapacity(100, &fh));
+	for(i = 0; i < 100; i += 2)
+	{
+		fillRecordPage(page, i);
+		TEST_CHECK(writeBlock(i, &fh, page));
+	}
+	TEST_CHECK(closePageFile(&fh));
+	ASSERT_TRUE(getFileSize("testbuffer.bin") < PAGE_SIZE + 50 * PAGE_SIZE / 2, "compressed pages take less space");
+
+	// the pages are found again through the page map
+	TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+	ASSERT_EQUALS_INT(100, fh.totalNumPages, "page count is kept");
+	fillRecordPage(page, 10);
+	TEST_CHECK(readBlock(10, &fh, ph));
+	ASSERT_TRUE(memcmp(page, ph, PAGE_SIZE) == 0, "page is decompressed");
+	memset(page, 0, PAGE_SIZE);
+	TEST_CHECK(readBlock(11, &fh, ph));
+	ASSERT_TRUE(memcmp(page, ph, PAGE_SIZE) == 0, "page that was never written reads as zero bytes");
+
+	// a page that does not compress is stored as it is, at the end
+	size = getFileSize("testbuffer.bin");
+	for(i = 0; i < PAGE_SIZE; i++)
+		page[i] = (char) rand();
+	TEST_CHECK(writeBlock(20, &fh, page));
+	TEST_CHECK(readBlock(20, &fh, ph));
+	ASSERT_TRUE(memcmp(page, ph, PAGE_SIZE) == 0, "random page is read back");
+	ASSERT_TRUE(getFileSize("testbuffer.bin") > size, "page that grows moves to the end");
+	TEST_CHECK(closePageFile(&fh));
+
+	// the slot it left is free once the file is opened again
+	size = getFileSize("testbuffer.bin");
+	TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+	fillRecordPage(ph, 21);
+	TEST_CHECK(writeBlock(21, &fh, ph));
+	ASSERT_TRUE(getFileSize("testbuffer.bin") == size, "free slot is reused");
+	TEST_CHECK(readBlock(20, &fh, ph));
+	ASSERT_TRUE(memcmp(page, ph, PAGE_SIZE) == 0, "moved page is kept");
+	fillRecordPage(page, 21);
+	TEST_CHECK(submitReadBlock(21, &fh, ph, &token));
+	TEST_CHECK(waitBlock(token, &fh));
+	ASSERT_TRUE(memcmp(page, ph, PAGE_SIZE) == 0, "page is decompressed asynchronously");
+	TEST_CHECK(closePageFile(&fh));
+	ASSERT_EQUALS_INT(RC_FILE_FORMAT_UNSUPPORTED, openMappedPageFile("testbuffer.bin", &fh), "compressed file is not mapped");
+
+	// the buffer pool sees the pages as they are
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LRU, NULL));
+	TEST_CHECK(pinPage(bm, h, 10));
+	ASSERT_TRUE(strncmp(h->data, "[0000-0010]", 11) == 0, "pool reads a compressed page");
+	sprintf(h->data, "%s", "Pooled");
+	TEST_CHECK(markDirty(bm, h));
+	TEST_CHECK(unpinPage(bm, h));
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+	TEST_CHECK(readBlock(10, &fh, ph));
+	ASSERT_EQUALS_STRING("Pooled", ph, "pool writes a compressed page");
+	TEST_CHECK(closePageFile(&fh));
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+	fp = fopen("testbuffer.bin.map", "rb");
+	ASSERT_TRUE(fp == NULL, "page map is destroyed with the file");
+
+	// the checksum is of the page, a corrupted slot is detected
+	TEST_CHECK(setPageChecksums(1));
+	TEST_CHECK(createPageFile("testbuffer.bin"));
+	TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+	fillRecordPage(page, 0);
+	TEST_CHECK(writeBlock(0, &fh, page));
+	TEST_CHECK(readBlock(0, &fh, ph));
+	ASSERT_TRUE(memcmp(page, ph, PAGE_SIZE - PAGE_CHECKSUM_SIZE) == 0, "page with a checksum is read back");
+	TEST_CHECK(closePageFile(&fh));
+	fp = fopen("testbuffer.bin", "r+b");
+	fseek(fp, PAGE_SIZE + 20, SEEK_SET);
+	fputc('!', fp);
+	fclose(fp);
+	TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+	ASSERT_EQUALS_INT(RC_CHECKSUM_MISMATCH, readBlock(0, &fh, ph), "corrupted compressed page is detected");
+	TEST_CHECK(closePageFile(&fh));
+	TEST_CHECK(setPageChecksums(0));
+	TEST_CHECK(setPageCompression(0));
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+
+	free(packed);
+	free(page);
+	free(ph);
+	free(h);
+	TEST_DONE();
+}
+
+// fill a page with lines that look like records, up to about 85% of it
+void
+fillRecordPage (char *page, int seed)
+{
+	int used = 0, i = 0;
+	memset(page, 0, PAGE_SIZE);
+	while (used < PAGE_SIZE * 85 / 100)
+	{
+		used += sprintf(page + used, "[%04d-%04d](a:%d,b:%s,c:%d)\n", i, seed, i * 7 % 100,
+			(i % 3 == 0) ? "aaaa" : (i % 3 == 1) ? "bbbb" : "cccc", seed + i);
+		i++;
+	}
+}
+
+// the size of a file in bytes
+long
+getFileSize (char *fileName)
+{
+	FILE *fp = fopen(fileName, "rb");
+	long size;
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	fclose(fp);
+	return size;
+}
+
+// ************************************************************ 
+// freed pages are handed out again before the file grows, also after the
+// file is opened again, and the buffer pool neither writes a freed page over
+// the free page map nor serves its old copy
+void
+testFreePages (void)
+{
+	SM_FileHandle fh;
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	SM_PageHandle ph = (SM_PageHandle) calloc(PAGE_SIZE, sizeof(char));
+	PageNumber pageNum;
+	int c, i;
+	testName = "Testing free pages";
+
+	// the second time the map pages are compressed and have checksums
+	for(c = 0; c < 2; c++)
+	{
+		TEST_CHECK(setPageChecksums(c));
+		TEST_CHECK(setPageCompression(c));
+		TEST_CHECK(createPageFile("testbuffer.bin"));
+		TEST_CHECK(setPageCompression(0));
+		TEST_CHECK(setPageChecksums(0));
+		TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+		TEST_CHECK(ensureCapacity(10, &fh));
+		TEST_CHECK(allocatePage(&fh, &pageNum));
+		ASSERT_EQUALS_INT(10, pageNum, "file grows when no page is free");
+		ASSERT_EQUALS_INT(11, fh.totalNumPages, "page is appended");
+
+		TEST_CHECK(freePage(3, &fh));
+		ASSERT_EQUALS_INT(0, getNumFreePages(&fh), "first freed page holds the map");
+		ASSERT_EQUALS_INT(RC_PARAMS_ERROR, freePage(3, &fh), "map page cannot be freed");
+		TEST_CHECK(freePage(7, &fh));
+		TEST_CHECK(freePage(5, &fh));
+		ASSERT_EQUALS_INT(2, getNumFreePages(&fh), "freed pages are counted");
+		ASSERT_EQUALS_INT(RC_PARAMS_ERROR, freePage(5, &fh), "page cannot be freed twice");
+		ASSERT_EQUALS_INT(RC_READ_NON_EXISTING_PAGE, freePage(11, &fh), "page past the end cannot be freed");
+
+		// a range of pages gets its own map
+		TEST_CHECK(ensureCapacity(40000, &fh));
+		TEST_CHECK(freePage(35000, &fh));
+		TEST_CHECK(freePage(35001, &fh));
+		ASSERT_EQUALS_INT(3, getNumFreePages(&fh), "second range has its own map");
+		TEST_CHECK(closePageFile(&fh));
+
+		TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+		ASSERT_EQUALS_INT(3, getNumFreePages(&fh), "free pages are found again");
+		TEST_CHECK(allocatePage(&fh, &pageNum));
+		ASSERT_EQUALS_INT(5, pageNum, "lowest free page is taken first");
+		TEST_CHECK(allocatePage(&fh, &pageNum));
+		ASSERT_EQUALS_INT(7, pageNum, "next free page is taken");
+		TEST_CHECK(allocatePage(&fh, &pageNum));
+		ASSERT_EQUALS_INT(35001, pageNum, "free page of the second range is taken");
+		TEST_CHECK(allocatePage(&fh, &pageNum));
+		ASSERT_EQUALS_INT(40000, pageNum, "file grows once no page is free");
+		TEST_CHECK(closePageFile(&fh));
+
+		TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+		ASSERT_EQUALS_INT(0, getNumFreePages(&fh), "allocated pages are kept");
+		TEST_CHECK(closePageFile(&fh));
+		TEST_CHECK(destroyPageFile("testbuffer.bin"));
+	}
+
+	// the pool drops the dirty copy of a page it frees
+	TEST_CHECK(createPageFile("testbuffer.bin"));
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LRU, NULL));
+	for(i = 0; i < 4; i++)
+	{
+		TEST_CHECK(pinPage(bm, h, i));
+		sprintf(h->data, "Pool-%i", i);
+		TEST_CHECK(markDirty(bm, h));
+		if(i < 3)
+			TEST_CHECK(unpinPage(bm, h));
+	}
+	ASSERT_EQUALS_INT(RC_ERROR, freePoolPage(bm, 3), "pinned page cannot be freed");
+	TEST_CHECK(unpinPage(bm, h));
+	TEST_CHECK(freePoolPage(bm, 3));
+	TEST_CHECK(freePoolPage(bm, 2));
+	TEST_CHECK(allocatePoolPage(bm, &pageNum));
+	ASSERT_EQUALS_INT(2, pageNum, "pool hands the freed page out again");
+	TEST_CHECK(pinPage(bm, h, 2));
+	ASSERT_TRUE(strcmp(h->data, "Pool-2") != 0, "allocated page is read from the file");
+	TEST_CHECK(unpinPage(bm, h));
+	TEST_CHECK(pinPage(bm, h, 3));
+	ASSERT_TRUE(strcmp(h->data, "Pool-3") != 0, "map page is read from the file");
+	TEST_CHECK(unpinPage(bm, h));
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+	ASSERT_EQUALS_INT(4, fh.totalNumPages, "file did not grow");
+	ASSERT_EQUALS_INT(0, getNumFreePages(&fh), "map is intact");
+	TEST_CHECK(readBlock(0, &fh, ph));
+	ASSERT_EQUALS_STRING("Pool-0", ph, "other pages are written back");
+	TEST_CHECK(closePageFile(&fh));
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+
+	free(ph);
+	free(h);
+	TEST_DONE();
+}
+
+// ************************************************************ 
+// punched pages read as zero bytes and take no space, and truncation drops
+// the free pages at the end of a file, its segment files and its mapping, 
+// also the copies of the pages in a buffer pool
+void
+testPunchPages (void)
+{
+	SM_FileHandle fh;
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	SM_PageHandle ph = (SM_PageHandle) calloc(PAGE_SIZE, sizeof(char));
+	SM_PageHandle zero = (SM_PageHandle) calloc(PAGE_SIZE, sizeof(char));
+	struct stat st;
+	blkcnt_t blocks;
+	PageNumber pageNum;
+	FILE *fp;
+	int c, i;
+	testName = "Testing punched pages";
+
+	// the second time the pages have checksums
+	for(c = 0; c < 2; c++)
+	{
+		TEST_CHECK(setPageChecksums(c));
+		TEST_CHECK(createPageFile("testbuffer.bin"));
+		TEST_CHECK(setPageChecksums(0));
+		TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+		TEST_CHECK(ensureCapacity(64, &fh));
+		for(i = 0; i < 64; i++)
+		{
+			memset(ph, 'p', PAGE_SIZE);
+			sprintf(ph, "Punch-%i", i);
+			TEST_CHECK(writeBlock(i, &fh, ph));
+		}
+		TEST_CHECK(syncPageFile(&fh));
+		stat("testbuffer.bin", &st);
+		blocks = st.st_blocks;
+
+		TEST_CHECK(punchPages(8, 48, &fh));
+		ASSERT_EQUALS_INT(64, fh.totalNumPages, "page count is kept");
+		stat("testbuffer.bin", &st);
+		ASSERT_TRUE(st.st_blocks < blocks, "punched pages take no space");
+		ASSERT_EQUALS_INT(65 * PAGE_SIZE, (int) st.st_size, "file keeps its size");
+		TEST_CHECK(readBlock(10, &fh, ph));
+		ASSERT_TRUE(memcmp(ph, zero, PAGE_SIZE) == 0, "punched page reads as zero bytes");
+		TEST_CHECK(readBlock(56, &fh, ph));
+		ASSERT_EQUALS_STRING("Punch-56", ph, "page after the hole is kept");
+		ASSERT_EQUALS_INT(RC_READ_NON_EXISTING_PAGE, punchPages(60, 8, &fh), "range past the end is refused");
+		TEST_CHECK(closePageFile(&fh));
+		TEST_CHECK(destroyPageFile("testbuffer.bin"));
+	}
+
+	// the free pages at the end go, the map page of a range with a free 
+	// page left stops the truncation
+	TEST_CHECK(createPageFile("testbuffer.bin"));
+	TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+	TEST_CHECK(ensureCapacity(64, &fh));
+	TEST_CHECK(freePage(20, &fh));
+	TEST_CHECK(freePage(30, &fh));
+	for(i = 63; i >= 40; i--)
+		TEST_CHECK(freePage(i, &fh));
+	TEST_CHECK(punchPages(0, 64, &fh));
+	TEST_CHECK(truncateFreePages(&fh));
+	ASSERT_EQUALS_INT(40, fh.totalNumPages, "free pages at the end are dropped");
+	ASSERT_EQUALS_INT(1, getNumFreePages(&fh), "free page before the end is kept");
+	ASSERT_EQUALS_INT(41 * PAGE_SIZE, (int) getFileSize("testbuffer.bin"), "file is cut");
+	TEST_CHECK(closePageFile(&fh));
+	TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+	ASSERT_EQUALS_INT(40, fh.totalNumPages, "header has the new page count");
+	TEST_CHECK(allocatePage(&fh, &pageNum));
+	ASSERT_EQUALS_INT(30, pageNum, "free page is found again");
+	TEST_CHECK(allocatePage(&fh, &pageNum));
+	ASSERT_EQUALS_INT(40, pageNum, "file grows again at the new end");
+	TEST_CHECK(closePageFile(&fh));
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+
+	// a map page at the end goes with the free pages after it, and the
+	// segment files past the end are removed
+	TEST_CHECK(setSegmentSize(16));
+	TEST_CHECK(createPageFile("testbuffer.bin"));
+	TEST_CHECK(setSegmentSize(0));
+	TEST_CHECK(openMappedPageFile("testbuffer.bin", &fh));
+	TEST_CHECK(ensureCapacity(64, &fh));
+	for(i = 20; i < 64; i++)
+		TEST_CHECK(freePage(i, &fh));
+	TEST_CHECK(truncateFreePages(&fh));
+	ASSERT_EQUALS_INT(20, fh.totalNumPages, "map page at the end is dropped");
+	ASSERT_EQUALS_INT(0, getNumFreePages(&fh), "no page is free");
+	fp = fopen("testbuffer.bin.2", "rb");
+	ASSERT_TRUE(fp == NULL, "segment past the end is removed");
+	ASSERT_EQUALS_INT(4 * PAGE_SIZE, (int) getFileSize("testbuffer.bin.1"), "last segment is cut");
+	TEST_CHECK(ensureCapacity(40, &fh));
+	sprintf(ph, "%s", "Regrown");
+	TEST_CHECK(writeBlock(35, &fh, ph));
+	TEST_CHECK(readBlock(35, &fh, ph));
+	ASSERT_EQUALS_STRING("Regrown", ph, "mapped file grows again");
+	TEST_CHECK(closePageFile(&fh));
+	TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+	ASSERT_EQUALS_INT(-1, getNumFreePages(NULL), "no file, no count");
+	ASSERT_EQUALS_INT(0, getNumFreePages(&fh), "map is gone");
+	TEST_CHECK(closePageFile(&fh));
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+
+	// the slots of a compressed file are dropped
+	TEST_CHECK(setPageCompression(1));
+	TEST_CHECK(createPageFile("testbuffer.bin"));
+	TEST_CHECK(setPageCompression(0));
+	TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+	TEST_CHECK(ensureCapacity(64, &fh));
+	for(i = 0; i < 64; i++)
+	{
+		fillRecordPage(ph, i);
+		TEST_CHECK(writeBlock(i, &fh, ph));
+	}
+	TEST_CHECK(punchPages(0, 8, &fh));
+	TEST_CHECK(readBlock(3, &fh, ph));
+	ASSERT_TRUE(memcmp(ph, zero, PAGE_SIZE) == 0, "punched compressed page reads as zero bytes");
+	for(i = 63; i >= 32; i--)
+		TEST_CHECK(freePage(i, &fh));
+	TEST_CHECK(truncateFreePages(&fh));
+	ASSERT_EQUALS_INT(32, fh.totalNumPages, "compressed file is truncated");
+	TEST_CHECK(closePageFile(&fh));
+	ASSERT_TRUE(getFileSize("testbuffer.bin") < PAGE_SIZE + 32 * PAGE_SIZE / 2, "slots past the end are cut");
+	TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+	fillRecordPage(zero, 20);
+	TEST_CHECK(readBlock(20, &fh, ph));
+	ASSERT_TRUE(memcmp(ph, zero, PAGE_SIZE) == 0, "compressed page before the end is kept");
+	TEST_CHECK(closePageFile(&fh));
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+
+	// the pool drops its copies of the punched pages and of the pages past
+	// the new end, a dirty copy neither fills the hole nor grows the file
+	memset(zero, 0, PAGE_SIZE);
+	TEST_CHECK(createPageFile("testbuffer.bin"));
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 4, RS_LRU, NULL));
+	for(i = 0; i < 8; i++)
+	{
+		TEST_CHECK(pinPage(bm, h, i));
+		sprintf(h->data, "Pool-%i", i);
+		TEST_CHECK(markDirty(bm, h));
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	TEST_CHECK(pinPage(bm, h, 5));
+	ASSERT_EQUALS_INT(RC_ERROR, punchPoolPages(bm, 4, 2), "pinned page cannot be punched");
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_EQUALS_INT(RC_READ_NON_EXISTING_PAGE, punchPoolPages(bm, 6, 4), "range past the end is refused");
+	TEST_CHECK(punchPoolPages(bm, 2, 4));
+	TEST_CHECK(pinPage(bm, h, 5));
+	ASSERT_TRUE(memcmp(h->data, zero, PAGE_SIZE) == 0, "punched cached page reads as zero bytes");
+	TEST_CHECK(unpinPage(bm, h));
+	TEST_CHECK(pinPage(bm, h, 2));
+	ASSERT_TRUE(memcmp(h->data, zero, PAGE_SIZE) == 0, "punched written page reads as zero bytes");
+	TEST_CHECK(unpinPage(bm, h));
+	TEST_CHECK(pinPage(bm, h, 6));
+	ASSERT_EQUALS_STRING("Pool-6", h->data, "page after the hole is kept");
+	TEST_CHECK(unpinPage(bm, h));
+
+	for(i = 7; i >= 5; i--)
+		TEST_CHECK(freePoolPage(bm, i));
+	TEST_CHECK(pinPage(bm, h, 6));
+	TEST_CHECK(markDirty(bm, h));
+	TEST_CHECK(pinPage(bm, h, 4));
+	ASSERT_EQUALS_INT(RC_ERROR, truncatePoolFreePages(bm), "pool with pinned pages is not truncated");
+	TEST_CHECK(unpinPage(bm, h));
+	h->pageNum = 6;
+	TEST_CHECK(unpinPage(bm, h));
+	TEST_CHECK(truncatePoolFreePages(bm));
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+	ASSERT_EQUALS_INT(5, fh.totalNumPages, "file does not grow again");
+	TEST_CHECK(closePageFile(&fh));
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+
+	free(zero);
+	free(ph);
+	free(h);
+	TEST_DONE();
+}